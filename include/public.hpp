@@ -20,6 +20,31 @@ enum EnMsgType {
     CREATE_GROUP_MSG,   // 创建群组9
     ADD_GROUP_MSG,      // 加入群组10
     GROUP_CHAT_MSG,     // 群聊天11
+
+    GROUP_SYNC_MSG,     // 群消息同步12
+    GROUP_SYNC_ACK,     // 群消息同步响应13
+
+    BATCH_MSG,          // 合并发送的多条聊天消息14
+
+    BROADCAST_MSG,      // 系统公告15
+    BROADCAST_ACK,      // 系统公告响应16
+
+    HISTORY_MSG,        // 历史消息查询17
+    HISTORY_ACK,        // 历史消息查询响应18
+
+    SEARCH_MSG,         // 历史消息搜索19
+    SEARCH_ACK,         // 历史消息搜索响应20
+
+    DELIVERY_ACK,       // 聊天消息送达确认21
+
+    CONV_LIST_MSG,      // 会话列表查询22
+    CONV_LIST_ACK,      // 会话列表查询响应23
+};
+
+// 登录响应的协议版本，由登录消息的proto字段协商，不带该字段的旧客户端为版本1
+enum EnLoginProto {
+    LOGIN_PROTO_STRING = 1, // 好友、群组、群成员各自编码为json文本，放在字符串数组中
+    LOGIN_PROTO_NESTED = 2, // 好友、群组、群成员是嵌套的json对象，响应中带有"proto":2
 };
 
 #endif
\ No newline at end of file
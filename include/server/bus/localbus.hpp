@@ -0,0 +1,64 @@
+#ifndef LOCALBUS_H
+#define LOCALBUS_H
+
+#include "messagebus.hpp"
+#include "statejournal.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+
+// 进程内回环消息总线，用于测试和单节点部署
+// 发布的消息放入队列，由独立的投递线程上报给业务层，与redis的观察线程语义一致，
+// 避免发布方持有业务锁时同步回调造成死锁
+// 配置了state_journal_dir时群序号保存在带预写日志的StateJournal中，进程崩溃重启后序号不会回退
+class LocalBus : public MessageBus
+{
+public:
+    LocalBus();
+    ~LocalBus();
+
+    bool connect() override;
+    bool publish(int channel, string message) override;
+    bool publishBatch(const vector<pair<int, string>> &messages) override;
+    bool subscribe(int channel) override;
+    bool unsubscribe(int channel) override;
+    bool subscribeNode(int nodeid) override;
+    bool publishNode(int nodeid, string message) override;
+    bool setRoute(int userid, int nodeid) override;
+    bool removeRoute(int userid) override;
+    bool queryRoutes(const vector<int> &userids, vector<int> &nodeids) override;
+    long long nextSequence(int groupid, long long floor) override;
+    long long currentSequence(int groupid) override;
+    void init_notify_handler(function<void(int, string)> fn) override;
+    void init_node_handler(function<void(int, string)> fn) override;
+
+private:
+    struct Envelope
+    {
+        bool node;      // 是否为节点通道消息
+        int channel;
+        string message;
+    };
+
+    // 投递线程，取出队列中的消息上报给业务层
+    void dispatch();
+
+    mutex _mutex;
+    condition_variable _cond;
+    deque<Envelope> _queue;
+    unordered_set<int> _channels;   // 已订阅的用户通道
+    unordered_set<int> _nodes;      // 已订阅的节点通道
+    unordered_map<int, int> _routes; // 用户路由表
+    unordered_map<int, long long> _sequences; // 群序号，没有配置预写日志时使用
+    unique_ptr<StateJournal> _journal;        // 群序号的预写日志
+    bool _quit;
+    thread _thread;
+
+    function<void(int, string)> _notify_message_handler;
+    function<void(int, string)> _notify_node_handler;
+};
+
+#endif
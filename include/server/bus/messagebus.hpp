@@ -0,0 +1,78 @@
+#ifndef MESSAGEBUS_H
+#define MESSAGEBUS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+using namespace std;
+
+/*
+集群服务器之间的消息总线接口
+- 用户通道：以userid作为通道号，用户登录的服务器订阅该通道，其他服务器向该通道发布消息
+- 节点通道：以节点号nodeid作为通道号，每台服务器订阅自己的节点通道，用于按节点投递的消息；
+  另外都订阅ALL_NODES通道，用于发给所有节点的消息
+- 路由表：记录在线用户登录在哪个节点上，群消息据此按节点合并发布
+- 群序号：集群内按群单调递增分配的序号
+具体实现：
+- redis : 基于redis发布-订阅，跨主机部署
+- local : 进程内回环，用于测试和单节点部署，不依赖redis
+- shm   : 基于共享内存环形缓冲区，用于同一台主机上的多个ChatServer进程
+*/
+class MessageBus
+{
+public:
+    // 集群广播使用的节点通道号，所有服务器都订阅，发布一次即可送达每个节点
+    static const int ALL_NODES = -1;
+
+    virtual ~MessageBus() {}
+
+    // 连接消息总线
+    virtual bool connect() = 0;
+
+    // 向指定的用户通道发布消息，发布失败（连接出错、消息超过总线的长度上限）返回false，由调用方转存
+    virtual bool publish(int channel, string message) = 0;
+
+    // 批量发布消息，<通道号，数据>，默认逐条发布，具体实现可以合并为一次网络交互
+    virtual bool publishBatch(const vector<pair<int, string>> &messages);
+
+    // 订阅用户通道
+    virtual bool subscribe(int channel) = 0;
+
+    // 取消订阅用户通道
+    virtual bool unsubscribe(int channel) = 0;
+
+    // 订阅节点通道
+    virtual bool subscribeNode(int nodeid) = 0;
+
+    // 向指定节点的通道发布消息，发布失败返回false
+    virtual bool publishNode(int nodeid, string message) = 0;
+
+    // 记录userid用户登录在nodeid节点上
+    virtual bool setRoute(int userid, int nodeid) = 0;
+
+    // 删除userid用户的路由
+    virtual bool removeRoute(int userid) = 0;
+
+    // 批量查询用户所在的节点，nodeids与userids一一对应，不在线的用户为-1
+    // 查询失败返回false，调用方应退化为逐个用户发布
+    virtual bool queryRoutes(const vector<int> &userids, vector<int> &nodeids) = 0;
+
+    // 分配groupid群组的下一个序号，结果至少为floor+1，失败返回-1
+    // floor用于计数器丢失（如redis重启）后从持久化的最大序号继续
+    virtual long long nextSequence(int groupid, long long floor) = 0;
+
+    // 查询groupid群组最后分配的序号，没有分配过返回0，失败返回-1
+    virtual long long currentSequence(int groupid) = 0;
+
+    // 初始化向业务层上报用户通道消息的回调对象，<通道号，数据>
+    virtual void init_notify_handler(function<void(int, string)> fn) = 0;
+
+    // 初始化向业务层上报节点通道消息的回调对象，<节点号，数据>
+    virtual void init_node_handler(function<void(int, string)> fn) = 0;
+
+    // 根据类型名创建消息总线：redis / local / shm，未知类型返回nullptr
+    static MessageBus *create(const string &type);
+};
+
+#endif
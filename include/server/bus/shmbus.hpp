@@ -0,0 +1,81 @@
+#ifndef SHMBUS_H
+#define SHMBUS_H
+
+#include "messagebus.hpp"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <unordered_set>
+#include <cstdint>
+
+/*
+基于POSIX共享内存环形缓冲区的消息总线，用于同一台主机上的多个ChatServer进程
+- 所有进程映射同一块共享内存（名字由配置项shm_name指定），其中是定长槽位组成的环形缓冲区
+- 发布方在进程间互斥锁保护下写入下一个槽位，写完后广播进程间条件变量
+- 每个进程有一个观察线程，按序号读取新写入的槽位，只上报本进程订阅的通道
+- 路由表是共享内存中以userid为下标的数组（userid是自增主键，比较稠密），超出容量的用户查询不到路由
+- 群序号保存在共享内存中以groupid为键的开放寻址表中，表满时分配失败
+- 读取方落后超过一圈时，被覆盖的消息会丢失并记录日志，和redis发布-订阅一样不保证送达
+*/
+class ShmBus : public MessageBus
+{
+public:
+    ShmBus();
+    ~ShmBus();
+
+    bool connect() override;
+    bool publish(int channel, string message) override;
+    bool publishBatch(const vector<pair<int, string>> &messages) override;
+    bool subscribe(int channel) override;
+    bool unsubscribe(int channel) override;
+    bool subscribeNode(int nodeid) override;
+    bool publishNode(int nodeid, string message) override;
+    bool setRoute(int userid, int nodeid) override;
+    bool removeRoute(int userid) override;
+    bool queryRoutes(const vector<int> &userids, vector<int> &nodeids) override;
+    long long nextSequence(int groupid, long long floor) override;
+    long long currentSequence(int groupid) override;
+    void init_notify_handler(function<void(int, string)> fn) override;
+    void init_node_handler(function<void(int, string)> fn) override;
+
+private:
+    struct Header;
+    struct Slot;
+
+    // 创建或打开共享内存段并完成映射
+    bool attach();
+
+    // 在已加锁的情况下写入一条消息
+    bool append(bool node, int channel, const string &message);
+
+    // 加/解进程间互斥锁，持锁进程崩溃后由下一个加锁者恢复锁状态
+    void lockShared();
+    void unlockShared();
+
+    // 观察线程，读取环形缓冲区中新写入的消息
+    void observer();
+
+    string _name;
+    int _fd;
+    void *_addr;
+    size_t _size;
+    Header *_header;
+    Slot *_slots;
+    atomic<int32_t> *_routes;   // 下标为userid，值为nodeid+1，0表示没有路由
+    struct SeqEntry;
+    SeqEntry *_sequences;       // 群序号表
+
+    uint64_t _readSeq;  // 本进程已读取到的序号
+
+    mutex _mutex;
+    unordered_set<int> _channels;
+    unordered_set<int> _nodes;
+
+    atomic<bool> _quit;
+    thread _thread;
+
+    function<void(int, string)> _notify_message_handler;
+    function<void(int, string)> _notify_node_handler;
+};
+
+#endif
@@ -25,6 +25,9 @@ private:
     // 读写回调函数
     void onMessage(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp time);
 
+    // 处理一条完整的消息
+    void onFrame(const TcpConnectionPtr &conn, const string &buf, Timestamp time);
+
     TcpServer _server;      // 组合的muduo库，实现服务器功能的类对象
     EventLoop *_loop;       // 指向事件循环对象的指针
 };
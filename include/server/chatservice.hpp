@@ -4,12 +4,27 @@
 #include <unordered_map>
 #include <functional>
 #include <mutex>
-#include "redis.hpp"
+#include <memory>
+#include <unordered_set>
+#include "messagebus.hpp"
+#include "loopdispatcher.hpp"
+#include "sessiontable.hpp"
+#include "fanoutengine.hpp"
+#include "dbworker.hpp"
 #include "json.hpp"
+#include "jsontape.hpp"
+#include "messages.hpp"
 #include "usermodel.hpp"
 #include "offlinemessagemodel.hpp"
 #include "friendmodel.hpp"
 #include "groupmodel.hpp"
+#include "grouptimelinemodel.hpp"
+#include "historymodel.hpp"
+#include "conversationmodel.hpp"
+#include "groupsequencer.hpp"
+#include "ratelimiter.hpp"
+#include "historysearch.hpp"
+#include "expiryscheduler.hpp"
 #include <muduo/net/TcpConnection.h>
 using namespace std;
 using namespace muduo;
@@ -17,8 +32,8 @@ using namespace muduo::net;
 using namespace placeholders;
 using json =  nlohmann::json;
 
-// 表示处理消息的事件回调方法类型
-using MsgHandler =  std::function<void(const TcpConnectionPtr &conn, json &js, Timestamp time)>; // 用一个已经存在的类型定义新的类型名称
+// 表示处理消息的事件回调方法类型，msg是消息的快速解析结果，由注册时包装的解码函数转换为消息结构
+using MsgHandler =  std::function<void(const TcpConnectionPtr &conn, const JsonTape::Value &msg, Timestamp time)>; // 用一个已经存在的类型定义新的类型名称
 
 // 服务类（区分与server，server是服务器），这里是业务代码
 // 业务类，采用单例模式
@@ -27,39 +42,75 @@ public:
     // 获取单例对象的接口函数，其返回值是一个对象的指针，如果返回对象的话，每次调用都会创建一个新的对象，就不是单例了，所以要返回指针
     static ChatService* instance(); // 单例模式的设计，暴露这样一个方法
     // 处理登录业务
-    void login(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void login(const TcpConnectionPtr &conn, const proto::LoginReq &req, Timestamp time);
     // 处理注销业务
-    void loginOut(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void loginOut(const TcpConnectionPtr &conn, const proto::LoginOutReq &req, Timestamp time);
     // 处理注册业务
-    void reg(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void reg(const TcpConnectionPtr &conn, const proto::RegReq &req, Timestamp time);
     // 一对一聊天业务
-    void oneChat(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void oneChat(const TcpConnectionPtr &conn, const proto::OneChatMsg &req, Timestamp time);
     // 添加好友业务
-    void addFriend(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void addFriend(const TcpConnectionPtr &conn, const proto::AddFriendReq &req, Timestamp time);
     // 创建群组业务
-    void createGroup(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void createGroup(const TcpConnectionPtr &conn, const proto::CreateGroupReq &req, Timestamp time);
     // 加入群组业务
-    void addGroup(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void addGroup(const TcpConnectionPtr &conn, const proto::AddGroupReq &req, Timestamp time);
     // 群组聊天业务
-    void groupChat(const TcpConnectionPtr &conn, json &js, Timestamp time);
+    void groupChat(const TcpConnectionPtr &conn, const proto::GroupChatMsg &req, Timestamp time);
+    // 群消息同步业务
+    void groupSync(const TcpConnectionPtr &conn, const proto::GroupSyncReq &req, Timestamp time);
+    // 系统公告业务
+    void broadcast(const TcpConnectionPtr &conn, const proto::BroadcastMsg &req, Timestamp time);
+    // 历史消息查询业务
+    void history(const TcpConnectionPtr &conn, const proto::HistoryReq &req, Timestamp time);
+    // 历史消息搜索业务
+    void search(const TcpConnectionPtr &conn, const proto::SearchReq &req, Timestamp time);
+    // 聊天消息送达确认业务
+    void deliveryAck(const TcpConnectionPtr &conn, const proto::DeliveryAckReq &req, Timestamp time);
+    // 会话列表查询业务
+    void conversations(const TcpConnectionPtr &conn, const proto::ConvListReq &req, Timestamp time);
     // 服务器异常，业务重置方法
     void reset();
     // 获取消息对应的处理器
     MsgHandler getHandler(int msgid);
     // 处理客户端异常退出
     void clientCloseException(const TcpConnectionPtr &conn);
-    // 从redis消息队列中获取订阅的消息
+    // 从消息总线中获取订阅的消息
     void handleRedisSubscribeMessage(int, string);
+    // 从消息总线的节点通道中获取按节点合并的群消息
+    void handleNodeMessage(int, string);
 private:
     ChatService();  // 由于采用了单例模式，所以要把构造函数私有化（***）
 
+    // 注册消息结构Req的处理器，消息解码失败（必需字段缺失、类型不符）时记录错误并丢弃
+    template <typename Req>
+    void registerHandler(void (ChatService::*handler)(const TcpConnectionPtr &, const Req &, Timestamp));
+
+    // 在连接所属的I/O线程中发送一条投递的消息，连接已断开时转存离线消息
+    void deliver(Delivery &delivery);
+
+    // 异步存储离线消息，积攒的消息由数据库线程合并为一次批量插入
+    void storeOfflineAsync(int userid, string msg);
+
+    // 连接不再使用时，把确认窗口中未确认的消息一次转存为userid用户的离线消息
+    void spillUnacked(const TcpConnectionPtr &conn, int userid);
+
+    // 异步存储历史消息，积攒的消息由数据库线程合并为一次批量插入
+    void storeHistoryAsync(HistoryMessage msg);
+
+    // 取出userid用户还有离线群消息没有读完的群组，用户下线时这些群组的游标不推进
+    vector<int> takeGroupBacklog(int userid);
+
+    // 本节点的节点号，由配置项node_id指定，默认为监听端口
+    int _nodeId;
+
     unordered_map<int, MsgHandler> _msgHandlerMap;  // 保存不同的消息id对应的回调函数 
 
-    // 存储在线用户的通信连接
-    unordered_map<int, TcpConnectionPtr> _userConnMap;  // 要注意线程安全问题，因为在系统运行时会发生变化
+    // 存储在线用户的通信连接，按userid分片加锁，保证线程安全
+    SessionTable _sessions;
 
-    // 定义互斥锁，保证_userConnMap的线程安全
-    mutex _connMutex;
+    // 群消息扇出，按连接所属的I/O线程并行发送
+    FanoutEngine _fanout;
 
     // 数据操作类对象
     UserModel _userModel;
@@ -73,8 +124,47 @@ private:
     // 群组操作对象
     GroupModel _groupModel;
 
-    // redis操作对象
-    Redis _redis;
+    // 群时间线操作对象
+    GroupTimelineModel _timelineModel;
+
+    // 群消息序号分配和最近消息缓存
+    GroupSequencer _sequencer;
+
+    // 历史消息操作对象
+    HistoryModel _historyModel;
+
+    // 会话列表和未读数操作对象
+    ConversationModel _conversationModel;
+
+    // 历史消息的全文搜索索引
+    HistorySearch _search;
+
+    // 消息总线对象，由配置项bus选择redis/local/shm实现
+    unique_ptr<MessageBus> _bus;
+
+    // 可以发送系统公告的用户，由配置项broadcast_admins指定
+    unordered_set<int> _broadcastAdmins;
+
+    // 本节点发送系统公告的限流
+    RateLimiter _broadcastLimiter;
+
+    // 等待数据库线程批量写入的离线消息
+    mutex _offlineMutex;
+    vector<pair<int, string>> _pendingOffline;
+
+    // 等待数据库线程批量写入的历史消息
+    mutex _historyMutex;
+    vector<HistoryMessage> _pendingHistory;
+
+    // 登录时离线群消息超过上限、还需要客户端用群消息同步读取的群组，userid -> groupid
+    mutex _backlogMutex;
+    unordered_map<int, unordered_set<int>> _groupBacklog;
+
+    // 离线消息和历史消息的过期清理
+    ExpiryScheduler _expiry;
+
+    // 数据库异步任务线程，放在最后定义，析构时最先停止，保证任务中用到的成员仍然有效
+    DbWorker _dbWorker;
 
 };
 
@@ -0,0 +1,32 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+using namespace std;
+
+// 服务器运行参数，优先取set()写入的值，其次取环境变量 CHAT_<KEY大写>，最后用默认值
+// 例如 getString("bus", "redis") 会读取环境变量 CHAT_BUS
+class Config
+{
+public:
+    static Config &instance();
+
+    // 设置配置项（覆盖环境变量）
+    void set(const string &key, const string &value);
+
+    // 读取字符串配置项
+    string getString(const string &key, const string &def);
+
+    // 读取整数配置项
+    int getInt(const string &key, int def);
+
+private:
+    Config() = default;
+
+    mutex _mutex;
+    unordered_map<string, string> _values;
+};
+
+#endif
@@ -28,6 +28,9 @@ public:
     // 获取连接
     MYSQL* getConnection();
 
+    // 转义字符串，用于拼接到sql语句的引号中，需在connect之后调用
+    string escape(const string &str);
+
 private:
     MYSQL *_conn;
 };
@@ -0,0 +1,32 @@
+#ifndef DBWORKER_H
+#define DBWORKER_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+using namespace std;
+
+// 数据库异步任务线程，把耗时的数据库写操作移出I/O线程和消息总线的观察线程
+// 析构时执行完队列中剩余的任务再退出，保证离线消息不会因为服务器退出而丢失
+class DbWorker
+{
+public:
+    DbWorker();
+    ~DbWorker();
+
+    // 投递一个数据库任务
+    void post(function<void()> task);
+
+private:
+    void run();
+
+    mutex _mutex;
+    condition_variable _cond;
+    deque<function<void()>> _tasks;
+    bool _quit;
+    thread _thread;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef EXPIRYSCHEDULER_H
+#define EXPIRYSCHEDULER_H
+
+#include "partitionmodel.hpp"
+#include "offlinepayloadmodel.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+/*
+离线消息和历史消息的过期清理，在单独的后台线程中定时执行，不占用I/O线程和数据库线程
+- 离线消息保留offline_ttl_days天，过期的按整个分区（log存储为整个段）删除；
+  删除的离线消息中对共享内容的引用随之减少，不再被引用的内容被删除
+- 历史消息保留history_retention_days天，0表示永久保留；按月分区
+- 每次执行都提前建立之后的分区，并在日志中输出各分区保留的行数和字节数
+- 执行间隔为expire_interval秒，启动后立即执行一次
+*/
+class ExpiryScheduler
+{
+public:
+    ExpiryScheduler();
+    ~ExpiryScheduler();
+
+private:
+    // 后台线程
+    void run();
+
+    // 执行一次过期清理
+    void expire();
+
+    PartitionModel _partitionModel;
+    OfflinePayloadModel _payloadModel;
+
+    int _intervalSeconds;
+    int64_t _offlineTtlMillis;      // 离线消息的保留时间，0表示不过期
+    int64_t _historyTtlMillis;      // 历史消息的保留时间，0表示不过期
+
+    mutex _mutex;
+    condition_variable _cond;
+    bool _quit;
+    thread _thread;
+};
+
+#endif
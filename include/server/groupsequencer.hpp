@@ -0,0 +1,64 @@
+#ifndef GROUPSEQUENCER_H
+#define GROUPSEQUENCER_H
+
+#include "messagebus.hpp"
+#include "grouptimelinemodel.hpp"
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <ctime>
+using namespace std;
+
+/*
+群消息序号分配器和最近消息缓存
+- 序号由消息总线在集群内按群单调递增分配，每个群第一次分配时用群时间线中已持久化的最大序号作为下限
+- 每个活跃的群在内存中保留最近的若干条消息（环形缓冲区），成员短时间断线重连后
+  按since序号同步时直接从内存返回，不访问数据库
+- 其他节点的消息可能乱序到达，缓存中按序号定位，缺失的序号视为空洞；
+  本节点没有该群在线成员期间的消息不会到达，同步时用总线上的当前序号确认缓存的尾部是完整的；
+  请求的范围内有空洞、已被覆盖或尾部不完整时由调用方回退到群时间线
+*/
+class GroupSequencer
+{
+public:
+    GroupSequencer(unique_ptr<MessageBus> &bus, GroupTimelineModel &timeline);
+
+    // 分配groupid群组的下一个序号，失败返回-1
+    long long next(int groupid);
+
+    // 缓存一条已分配序号的群消息
+    void record(int groupid, long long seq, const shared_ptr<const string> &msg);
+
+    // 从缓存中取groupid群组序号大于since的消息，最多limit条
+    // 缓存能完整覆盖这个范围时返回true，lastSeq为返回的最后一条消息的序号
+    // 消息较多时只返回前limit条，调用方以lastSeq为since继续同步
+    bool since(int groupid, long long since, int limit, vector<shared_ptr<const string>> &msgs, long long &lastSeq);
+
+    // 序号分配曾经回退到数据库，下次分配时重新读取下限
+    void reseed(int groupid);
+
+private:
+    struct Ring
+    {
+        long long firstSeq = 0;                     // msgs[0]对应的序号
+        deque<shared_ptr<const string>> msgs;       // 空指针表示该序号的消息没有到达本节点
+        time_t lastActive = 0;
+    };
+
+    // 淘汰长时间不活跃的群的缓存，调用方持有_mutex
+    void evictIdle(time_t now);
+
+    unique_ptr<MessageBus> &_bus;
+    GroupTimelineModel &_timeline;
+
+    size_t _ringSize;       // 每个群缓存的消息条数
+    size_t _maxGroups;      // 最多缓存的群数
+    int _idleSeconds;       // 超过这个时间没有新消息的群可以被淘汰
+
+    mutex _mutex;
+    unordered_map<int, bool> _seeded;   // 本进程是否已经为该群读取过序号下限
+    unordered_map<int, Ring> _rings;
+};
+
+#endif
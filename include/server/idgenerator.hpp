@@ -0,0 +1,42 @@
+#ifndef IDGENERATOR_H
+#define IDGENERATOR_H
+
+#include <mutex>
+#include <cstdint>
+using namespace std;
+
+/*
+集群内唯一、按时间递增的64位消息id（snowflake）
+- 41位：自2020-01-01起的毫秒数
+- 10位：节点号，取配置项node_id的低10位
+- 12位：同一毫秒内的序号，用完后等到下一毫秒
+id的高位是时间，历史消息表按id分区即按时间分区，按id排序即按时间排序
+*/
+class IdGenerator
+{
+public:
+    static IdGenerator *instance();
+
+    // 生成下一个id
+    int64_t next();
+
+    // 毫秒时间戳（Unix纪元）对应的最小id，用于按时间计算分区边界和查询范围
+    static int64_t fromMillis(int64_t millis);
+
+    // id中的毫秒时间戳（Unix纪元）
+    static int64_t toMillis(int64_t id);
+
+private:
+    IdGenerator();
+
+    static const int64_t EPOCH = 1577836800000LL;   // 2020-01-01 00:00:00 UTC
+    static const int NODE_BITS = 10;
+    static const int SEQUENCE_BITS = 12;
+
+    mutex _mutex;
+    int64_t _node;
+    int64_t _lastMillis;
+    int64_t _sequence;
+};
+
+#endif
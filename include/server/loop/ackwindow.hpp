@@ -0,0 +1,43 @@
+#ifndef ACKWINDOW_H
+#define ACKWINDOW_H
+
+#include <muduo/net/TcpConnection.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace muduo;
+using namespace muduo::net;
+using namespace std;
+
+/*
+聊天消息的送达确认窗口
+- conn->send返回只表示消息进入了输出缓冲区，连接断开时缓冲区中的消息会丢失；
+  客户端登录时声明会回复送达确认后开启，写出的聊天消息按消息id(mid)记录在该连接的窗口中，
+  客户端收到后回复 {"msgid":DELIVERY_ACK,"mids":[...]}，确认的消息从窗口中移除
+- 窗口是每个连接一个固定容量的环形缓冲区，按写出顺序排列，确认通常按顺序到达，
+  从最老的一条开始查找很快就能命中；窗口满时最老的未确认消息不再跟踪
+- 连接断开时窗口中未确认的消息按原顺序取出，由调用方一次转存为离线消息，
+  客户端可能已经收到其中的部分消息，上线后按mid去重
+- 所有状态属于连接所在的I/O线程，接口必须在连接所属的I/O线程调用
+*/
+class AckWindow
+{
+public:
+    // 服务器是否配置了确认窗口
+    static bool available();
+
+    // 开启连接conn的送达确认
+    static void enable(const TcpConnectionPtr &conn);
+
+    // 记录写出到连接conn的一条消息，未开启确认的连接或没有mid的消息直接忽略
+    static void track(const TcpConnection *conn, const shared_ptr<const string> &payload);
+
+    // 确认连接conn收到了消息mid
+    static void ack(const TcpConnectionPtr &conn, int64_t mid);
+
+    // 关闭连接conn的送达确认，返回未确认的消息，按写出顺序排列
+    static vector<shared_ptr<const string>> close(const TcpConnectionPtr &conn);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef COALESCER_H
+#define COALESCER_H
+
+#include <muduo/net/TcpConnection.h>
+#include <memory>
+#include <string>
+#include <functional>
+using namespace muduo;
+using namespace muduo::net;
+using namespace std;
+
+/*
+按连接合并发送聊天消息
+- 客户端登录时声明可以解析批量帧后开启，未开启的连接逐条发送
+- 开启后发往该连接的聊天消息先暂存，合并窗口到期、暂存条数或字节数达到上限时
+  打包成一个批量帧 {"msgid":BATCH_MSG,"msgs":[消息,...]} 一次写出，减少系统调用和报文数
+- 所有状态属于连接所在的I/O线程，接口必须在连接所属的I/O线程调用
+*/
+class Coalescer
+{
+public:
+    // 暂存的消息因连接断开无法写出时的回调
+    using DropCallback = function<void(int userid, const string &payload)>;
+
+    // 设置无法写出的消息的处理回调，需在服务启动时设置
+    static void setDropCallback(const DropCallback &cb);
+
+    // 服务器是否配置了合并窗口
+    static bool available();
+
+    // 开启连接conn的合并发送
+    static void enable(const TcpConnectionPtr &conn);
+
+    // 关闭连接conn的合并发送，已暂存的消息立即发出
+    static void disable(const TcpConnectionPtr &conn);
+
+    // 发送一条聊天消息给userid用户的连接conn
+    static void send(const TcpConnectionPtr &conn, int userid, const shared_ptr<const string> &payload);
+};
+
+#endif
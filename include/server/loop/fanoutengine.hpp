@@ -0,0 +1,31 @@
+#ifndef FANOUTENGINE_H
+#define FANOUTENGINE_H
+
+#include "sessiontable.hpp"
+
+/*
+群消息扇出
+- 调用线程只负责按连接所属的loop划分接收者，每个loop投递一批
+- 真正的发送由各个I/O线程在自己的loop中并行完成，调用线程（业务处理线程）立即返回
+- 包括发给调用线程自己loop上的连接，也在本次处理结束后再发送，不占用当前处理过程
+*/
+class FanoutEngine
+{
+public:
+    explicit FanoutEngine(SessionTable &sessions) : _sessions(sessions) {}
+
+    // 把payload发给userids中在本节点在线的用户，返回不在本节点在线的用户
+    vector<int> fanout(const vector<int> &userids, const shared_ptr<const string> &payload);
+
+    // 把payload发给groupid群组中在本节点在线的成员（不包括from），接收者由位图交集得到，
+    // 返回投递的成员（按userid从小到大排列），查找连接时已经下线的成员追加到missed中
+    vector<int> fanoutGroup(int groupid, int from, const shared_ptr<const string> &payload, vector<int> &missed);
+
+    // 把payload发给本节点所有在线用户，返回用户数
+    size_t broadcast(const shared_ptr<const string> &payload);
+
+private:
+    SessionTable &_sessions;
+};
+
+#endif
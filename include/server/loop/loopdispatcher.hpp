@@ -0,0 +1,75 @@
+#ifndef LOOPDISPATCHER_H
+#define LOOPDISPATCHER_H
+
+#include "mpscqueue.hpp"
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpConnection.h>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+using namespace std;
+using namespace muduo;
+using namespace muduo::net;
+
+// 投递给某个用户连接的一条消息
+struct Delivery
+{
+    int userid;
+    weak_ptr<TcpConnection> conn;       // 目标连接，投递时连接可能已经断开
+    shared_ptr<const string> payload;   // 群发时多个投递共享同一份数据
+};
+
+/*
+把其他线程产生的消息交给连接所属的I/O线程发送
+- 每个EventLoop一个无锁MPSC队列，任意线程都可以投递
+- 队列由空变为非空时才queueInLoop一次，I/O线程一次取完整批消息，一批只唤醒一次
+- 消息在所属的I/O线程中回调DeliverCallback，回调中直接send，不再跨线程
+*/
+class LoopDispatcher
+{
+public:
+    using DeliverCallback = function<void(Delivery &)>;
+
+    static LoopDispatcher *instance();
+
+    // 注册事件循环，只能在TcpServer::start之前或线程初始化回调中调用，之后只读
+    void registerLoop(EventLoop *loop);
+
+    // 设置在I/O线程中处理一条投递的回调
+    void setDeliverCallback(DeliverCallback cb);
+
+    // 投递一条消息到loop的队列
+    void post(EventLoop *loop, Delivery delivery);
+
+    // 投递一批消息到loop的队列，最多唤醒一次
+    void postBatch(EventLoop *loop, vector<Delivery> &batch);
+
+private:
+    LoopDispatcher() = default;
+
+    struct LoopQueue
+    {
+        explicit LoopQueue(EventLoop *l) : loop(l), scheduled(false) {}
+
+        EventLoop *loop;
+        MpscQueue<Delivery> queue;
+        atomic<bool> scheduled;     // 是否已经有一个drain任务在loop中排队
+    };
+
+    LoopQueue *find(EventLoop *loop);
+
+    // 需要时唤醒loop执行drain
+    void schedule(LoopQueue *lq);
+
+    // 在I/O线程中取出队列中的消息逐条投递
+    void drain(LoopQueue *lq);
+
+    mutex _registerMutex;
+    unordered_map<EventLoop *, unique_ptr<LoopQueue>> _queues;
+    DeliverCallback _deliver;
+};
+
+#endif
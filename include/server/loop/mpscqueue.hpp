@@ -0,0 +1,72 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+using namespace std;
+
+/*
+无锁多生产者单消费者队列（Vyukov算法）
+- push可以被任意线程并发调用，只有一次原子交换，不会阻塞
+- pop只能由唯一的消费者线程调用
+- 生产者交换头指针之后、链接next之前，消费者会暂时看到队列为空，
+  调用方需要在push之后再检查是否要唤醒消费者，见LoopDispatcher
+*/
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : _head(new Node()), _tail(_head.load(memory_order_relaxed))
+    {
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value))
+        {
+        }
+        delete _tail;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // 生产者入队
+    void push(T value)
+    {
+        Node *node = new Node(std::move(value));
+        Node *prev = _head.exchange(node, memory_order_acq_rel);
+        prev->next.store(node, memory_order_release);
+    }
+
+    // 消费者出队，队列为空时返回false
+    bool pop(T &value)
+    {
+        Node *tail = _tail;
+        Node *next = tail->next.load(memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        value = std::move(next->value);
+        _tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr) {}
+        explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+
+        atomic<Node *> next;
+        T value;
+    };
+
+    atomic<Node *> _head;   // 生产者从这里入队
+    Node *_tail;            // 消费者从这里出队，指向已消费的哨兵节点
+};
+
+#endif
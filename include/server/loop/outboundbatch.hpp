@@ -0,0 +1,34 @@
+#ifndef OUTBOUNDBATCH_H
+#define OUTBOUNDBATCH_H
+
+#include "loopdispatcher.hpp"
+
+/*
+业务处理过程中的跨线程发送批次
+- 在Scope作用域内（ChatServer::onMessage处理一条请求期间），发往其他I/O线程连接的消息
+  按目标loop暂存，作用域结束时每个目标loop只投递一次、最多唤醒一次
+- 目标连接属于当前线程时直接发送
+- 不在Scope作用域内时立即投递
+*/
+class OutboundBatch
+{
+public:
+    // 批次作用域，作用域结束时投递暂存的消息，可以嵌套，最外层结束时投递
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    // 发送消息给userid用户的连接conn
+    static void send(const TcpConnectionPtr &conn, int userid, const shared_ptr<const string> &payload);
+
+    // 把当前线程暂存的消息按目标loop各投递一次
+    static void flush();
+};
+
+#endif
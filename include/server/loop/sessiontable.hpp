@@ -0,0 +1,100 @@
+#ifndef SESSIONTABLE_H
+#define SESSIONTABLE_H
+
+#include "loopdispatcher.hpp"
+#include "userbitmap.hpp"
+#include <unordered_map>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// 按目标EventLoop分组的一批投递
+using LoopBatches = vector<pair<EventLoop *, vector<Delivery>>>;
+
+/*
+在线用户的连接表，按userid分片加锁，取代原来的 _userConnMap + 全局_connMutex
+- 不同用户的登录、下线、查找只会竞争各自分片的锁
+- partition一次性查找一批用户，每个分片只加一次锁，按连接所属的loop分组
+- 另外维护本节点在线用户的位图和每个群组在本节点登录过的成员位图，
+  两者求交集即可得到群组在本节点在线的成员，不需要逐个成员查表
+*/
+class SessionTable
+{
+public:
+    // 记录userid用户的连接，连接所属的loop取自conn
+    void add(int userid, const TcpConnectionPtr &conn);
+
+    // 记录userid用户的连接，并指定连接所属的loop
+    void add(int userid, const TcpConnectionPtr &conn, EventLoop *loop);
+
+    // 删除userid用户的连接
+    void remove(int userid);
+
+    // 删除连接conn，返回它对应的userid，没有找到返回-1
+    int remove(const TcpConnectionPtr &conn);
+
+    // 查找userid用户的连接，不在线返回空指针
+    TcpConnectionPtr find(int userid);
+
+    // 查找连接conn对应的userid，没有找到返回-1
+    int find(const TcpConnectionPtr &conn);
+
+    // 记录userid用户所在的群组
+    void setGroups(int userid, const vector<int> &groupids);
+
+    // userid用户加入了groupid群组
+    void joinGroup(int userid, int groupid);
+
+    // userid用户是否在线且是groupid群组的成员
+    bool inGroup(int userid, int groupid);
+
+    // userid用户所在的群组，不在线返回空
+    vector<int> groups(int userid);
+
+    // groupid群组中在本节点在线的成员，不包括exclude，按userid从小到大排列
+    vector<int> onlineMembers(int groupid, int exclude);
+
+    // 当前所有在线用户的userid
+    vector<int> userids();
+
+    // 把发给本节点所有在线用户的payload按连接所属的loop分组追加到batches中，返回用户数
+    // 逐个分片加锁，不会同时持有多个分片的锁
+    size_t partitionAll(const shared_ptr<const string> &payload, LoopBatches &batches);
+
+    // 把发给userids的payload按连接所属的loop分组追加到batches中，不在线的用户追加到missed中
+    void partition(const vector<int> &userids, const shared_ptr<const string> &payload,
+                   LoopBatches &batches, vector<int> &missed);
+
+private:
+    static const int SHARD_COUNT = 16;
+
+    struct Session
+    {
+        TcpConnectionPtr conn;
+        EventLoop *loop;
+        vector<int> groups;     // 用户所在的群组
+    };
+
+    struct Shard
+    {
+        mutex mtx;
+        unordered_map<int, Session> users;          // userid -> 连接
+        unordered_map<TcpConnection *, int> conns;  // 连接 -> userid，按连接地址分片
+    };
+
+    static int shardOf(int userid) { return (unsigned)userid % SHARD_COUNT; }
+    static int shardOf(TcpConnection *conn) { return (reinterpret_cast<uintptr_t>(conn) >> 4) % SHARD_COUNT; }
+
+    // 更新在线用户位图
+    void setOnline(int userid, bool online);
+
+    Shard _shards[SHARD_COUNT];
+
+    // 在线用户位图和群组成员位图，成员位图只在用户登录、加入群组时增加
+    mutex _bitmapMutex;
+    UserBitmap _online;
+    unordered_map<int, UserBitmap> _members;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef USERBITMAP_H
+#define USERBITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+/*
+用户id集合的压缩位图（roaring位图的简化实现）
+- userid是数据库自增主键，分布稠密，按高16位分成容器，每个容器保存低16位
+- 容器元素不超过4096个时使用有序数组，超过后改为65536位的位图，两种形式都不超过8KB
+- 交集按容器逐个计算，位图与位图的交集使用SIMD指令按块做与运算
+- 不是线程安全的，由使用者加锁
+*/
+class UserBitmap
+{
+public:
+    // 加入userid
+    void add(uint32_t userid);
+
+    // 删除userid
+    void remove(uint32_t userid);
+
+    // 是否包含userid
+    bool contains(uint32_t userid) const;
+
+    // 元素个数
+    size_t cardinality() const;
+
+    bool empty() const { return _containers.empty(); }
+
+    // 计算a和b的交集
+    static UserBitmap intersect(const UserBitmap &a, const UserBitmap &b);
+
+    // 按从小到大的顺序把所有元素追加到out中
+    void toVector(vector<int> &out) const;
+
+private:
+    static const size_t ARRAY_MAX = 4096;   // 数组容器的最大元素个数
+    static const size_t WORDS = 1024;       // 位图容器的64位字数
+
+    struct Container
+    {
+        uint16_t key = 0;           // userid的高16位
+        uint32_t count = 0;         // 元素个数
+        vector<uint16_t> array;     // 稀疏时使用的有序数组
+        vector<uint64_t> bits;      // 稠密时使用的位图
+
+        bool isBitmap() const { return !bits.empty(); }
+        void toBitmap();
+        void toArray();
+    };
+
+    static void intersect(const Container &a, const Container &b, Container &out);
+
+    // 查找key对应的容器，不存在返回它应该插入的位置
+    size_t lowerBound(uint16_t key) const;
+
+    vector<Container> _containers;  // 按key有序
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CONVERSATIONMODEL_H
+#define CONVERSATIONMODEL_H
+
+#include "historymodel.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// 会话列表中的一个会话
+struct Conversation
+{
+    int64_t convid;     // 会话号，与history表相同
+    int unread;         // 未读消息数
+    int64_t lastmid;    // 最近一条消息的id，没有消息时为0
+};
+
+/*
+用户会话列表和未读数的操作接口方法
+- 一对一会话：conversation表中每个用户每个会话一行，随历史消息批量写入时增量更新，
+  接收方未读数加一，双方的最近消息id推进，一批消息按(用户, 会话)合并为一条多行insert
+- 群会话：不为每个成员各写一行，未读数 = 群的最新序号(groupseq) - 成员的已读序号，
+  已读序号没有记录时取成员的群时间线游标；最近消息id取history表中该群最大的消息id，
+  一条群消息的维护代价与群成员数无关
+- 打开会话（读取第一页历史消息）时清零未读数
+*/
+class ConversationModel
+{
+public:
+    // 按一批已路由的消息更新一对一会话的未读数和最近消息id
+    void apply(const vector<HistoryMessage> &msgs);
+
+    // 把userid用户的convid会话标记为已读
+    void markRead(int userid, int64_t convid);
+
+    // 查询userid用户的会话列表，按最近消息从新到旧排序，最多返回limit个
+    vector<Conversation> query(int userid, int limit);
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef DICTIONARYMODEL_H
+#define DICTIONARYMODEL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+using namespace std;
+
+// 消息压缩字典表的操作接口方法，每个版本的字典一行，写入后不再修改
+class DictionaryModel
+{
+public:
+    // 写入version版本的字典，该版本已经存在（其他节点先写入）时返回false
+    bool insert(int version, const string &dict);
+
+    // 查询所有版本的字典，<version, dict>
+    vector<pair<int, string>> query();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef GROUPTIMELINEMODEL_H
+#define GROUPTIMELINEMODEL_H
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// 群时间线中的一条消息
+struct GroupMessage
+{
+    int groupid;
+    long long seq;
+    string msg;
+};
+
+/*
+群消息时间线的操作接口方法
+- 每条群消息只在grouptimeline表中存一份，序号由groupseq表按群单调递增分配
+- groupcursor表记录每个成员已读到的序号，离线成员上线时读取游标之后的消息；
+  没有游标记录的成员（如早于groupcursor表加入的成员）按游标为0处理
+- 一条群消息的存储代价是O(1)，与群成员数无关
+- 总线分配的序号可能交给数据库线程异步追加，先分配的序号可能晚于之后的序号写入；
+  读取时只返回游标之后序号连续的消息，游标不会越过还没有写入的序号。
+  空洞之后的消息写入已超过一段时间时，空洞视为不会再写入（追加失败或节点退出），不再等待
+*/
+class GroupTimelineModel
+{
+public:
+    // 追加一条群消息，由数据库分配序号，返回分配的序号，失败返回-1
+    long long append(int groupid, const string &msg);
+
+    // 追加一条已经分配好序号的群消息，同时把groupseq推进到该序号
+    bool append(int groupid, long long seq, const string &msg);
+
+    // 查询groupid群组已分配的最大序号
+    long long maxSeq(int groupid);
+
+    // 查询groupid群组中序号大于since且连续的消息，按序号排序，最多返回limit条
+    // 遇到还可能被写入的空洞时停止，gapped为true
+    vector<GroupMessage> query(int groupid, long long since, int limit, bool &gapped);
+
+    // 查询userid用户所在群组中游标之后序号连续的消息，按群组和序号排序，最多读取limit条
+    // unfinished返回没有读完的群组和读到的最后序号：遇到空洞的群组，以及达到上限时最后一个群组和之后游标落后的群组
+    vector<GroupMessage> queryUnread(int userid, int limit, map<int, long long> &unfinished);
+
+    // 查询userid用户所在群组中游标落后于最新序号的群组，groupid -> 游标
+    map<int, long long> queryBehind(int userid);
+
+    // 设置userid用户在groupid群组中的游标
+    void setCursor(int userid, int groupid, long long seq);
+
+    // 把userid用户在所有群组中的游标推进到群组的最新序号，用户下线时调用
+    // exclude中的群组还有未读完的离线消息，游标保持不变
+    void advanceCursors(int userid, const vector<int> &exclude = {});
+
+    // 新成员的游标设为群组当前的最新序号，不接收入群之前的消息
+    void initCursor(int userid, int groupid);
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef HISTORYMODEL_H
+#define HISTORYMODEL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// 历史消息表中的一条消息
+struct HistoryMessage
+{
+    int64_t id;     // 消息id，由IdGenerator生成，按时间递增
+    int64_t convid; // 会话号
+    int fromid;     // 发送者
+    string msg;
+};
+
+/*
+聊天历史消息的操作接口方法
+- 每条消息在history表中存一份，按会话号和消息id建主键，同一会话的消息按id有序
+- 消息id的高位是时间，history表按id范围分区，即按月分区
+- 会话号：一对一聊天为两个userid拼成的正数（小的在高32位），群聊为 -groupid
+- 消息内容经PayloadCodec压缩后存储，读取时解压
+*/
+class HistoryModel
+{
+public:
+    // 一对一聊天的会话号
+    static int64_t oneChatConv(int userid, int peerid);
+
+    // 群聊的会话号
+    static int64_t groupConv(int groupid);
+
+    // 批量存储历史消息，合并为一条多行insert语句
+    void insert(const vector<HistoryMessage> &msgs);
+
+    // 查询convid会话中id小于before的消息，按id从大到小排序，最多返回limit条
+    // before为0表示从最新的消息开始
+    vector<HistoryMessage> query(int64_t convid, int64_t before, int limit);
+
+    // 按id从小到大扫描所有会话中id大于after的消息，最多返回limit条，供搜索索引增量读取
+    vector<HistoryMessage> scan(int64_t after, int limit);
+
+    // 按(会话号, 消息id)批量查询消息，返回的顺序与keys一致，已经不存在的消息被跳过
+    vector<HistoryMessage> query(const vector<pair<int64_t, int64_t>> &keys);
+};
+
+#endif
@@ -1,23 +1,49 @@
 #ifndef OFFLINEMESSAGEMODEL_H
 #define OFFLINEMESSAGEMODEL_H
 
+#include "offlinestore.hpp"
+#include "payloadcodec.hpp"
+#include "offlinepayloadmodel.hpp"
 #include <string>
 #include <vector>
+#include <utility>
 using namespace std;
 
-// 提供离线消息表的操作接口方法
+/*
+提供离线消息表的操作接口方法，实际的存储由配置项offline_store选择（mysql / log / redis）
+- 消息经PayloadCodec压缩后存储，读取时解压
+- 一批离线消息中同一条消息要存给多个接收者时（群消息、总线投递失败的转存），
+  内容只在offlinepayload表中存一份，各接收者的收件箱中存 0x05 + 内容哈希 的引用，
+  存储量随不同消息的条数而不是接收者数增长；读取并删除离线消息、过期清理删除离线消息时减少引用
+- 配置项offline_dedup_min_bytes：不小于该长度的消息才去重，0表示关闭；
+  redis存储会静默丢弃消息，不去重
+*/
 class OfflineMsgModel {
 public:
-    // 存储用户的离线消息
-    void insert(int userid, string msg);
+    OfflineMsgModel();
+
+    // 存储用户的离线消息，写入失败返回false
+    bool insert(int userid, string msg);
+
+    // 批量存储离线消息，<userid, msg>，由存储实现合并写入，写入失败返回false
+    bool insert(const vector<pair<int, string>> &msgs);
 
     // 删除用户的离线消息
     void remove(int userid);
 
     // 查询用户的离线消息
     vector<string> query(int userid);
+
+    // 读取并删除用户的离线消息，登录时调用
+    vector<string> take(int userid);
 private:
+    // 把引用替换成消息内容并解压，refs返回引用的计数
+    vector<string> resolve(vector<string> stored, unordered_map<string, int> &refs);
 
+    OfflineStore *_store;
+    PayloadCodec *_codec;
+    OfflinePayloadModel _payloadModel;
+    size_t _dedupMinBytes;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,45 @@
+#ifndef OFFLINEPAYLOADMODEL_H
+#define OFFLINEPAYLOADMODEL_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+using namespace std;
+
+// 要被多个接收者引用的一条消息内容
+struct SharedPayload
+{
+    string hash;
+    const string *payload;
+    int refs;           // 本次增加的引用数
+};
+
+/*
+按内容寻址的离线消息内容表的操作接口方法
+- 同一条消息要存给多个接收者时，消息内容在offlinepayload表中只存一份，以内容的128位哈希为主键，
+  各接收者的离线消息中只存哈希引用
+- 哈希不是密码学哈希，消息内容由客户端决定，可以构造出碰撞；增加引用时比较表中已有的内容，
+  内容不同的不增加引用，由调用方按原样存储
+- 每行记录被引用的次数，接收者读取离线消息和过期清理删除离线消息时减少引用，减到0的行被删除，
+  还有引用的内容不会被删除
+*/
+class OfflinePayloadModel
+{
+public:
+    // 消息内容的哈希，32个十六进制字符
+    static string hash(const string &payload);
+
+    // 增加引用，内容不存在时写入，返回成功增加引用的哈希；
+    // 表中同一哈希下已有不同内容（碰撞）的不增加引用，写入失败时返回空
+    unordered_set<string> acquire(const vector<SharedPayload> &payloads);
+
+    // 按哈希查询消息内容
+    unordered_map<string, string> query(const vector<string> &hashes);
+
+    // 减少引用，<hash, 引用数>，并删除不再被引用的内容
+    void release(const unordered_map<string, int> &refs);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PARTITIONMODEL_H
+#define PARTITIONMODEL_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+using namespace std;
+
+// 按范围分区的表中的一个分区
+struct PartitionInfo
+{
+    string name;
+    int64_t bound;  // 分区中的值都小于bound，MAXVALUE分区为INT64_MAX
+    int64_t rows;   // 行数，来自统计信息，是估计值
+    int64_t bytes;  // 数据和索引占用的字节数
+};
+
+/*
+按时间范围分区的表的分区维护
+过期数据整个分区删除（drop partition只删除分区文件，不扫描也不锁表），
+新的分区提前从MAXVALUE分区中拆分出来，保持MAXVALUE分区为空，拆分不需要搬移数据
+*/
+class PartitionModel
+{
+public:
+    enum Period
+    {
+        DAILY,
+        MONTHLY,
+    };
+
+    // 查询table的分区，按分区顺序排列，表没有分区时返回空
+    vector<PartitionInfo> query(const string &table);
+
+    // 删除table的分区
+    bool drop(const string &table, const vector<string> &names);
+
+    // 从table的MAXVALUE分区pmax中拆分出新的分区，<分区名, 上界>，按上界从小到大排列
+    bool split(const string &table, const vector<pair<string, int64_t>> &partitions);
+
+    // 维护table的分区：分区名为 p + 日期（DAILY为YYYYMMDD，MONTHLY为YYYYMM，UTC），
+    // 上界为下一个周期开始时刻的毫秒时间戳经toBound换算的值
+    // - 删除上界不大于toBound(cutoffMillis)的分区，cutoffMillis为0表示不删除
+    // - 保证当前周期和之后ahead个周期的分区存在
+    // 返回删除的分区数
+    int rotate(const string &table, Period period, const function<int64_t(int64_t)> &toBound,
+               int64_t nowMillis, int64_t cutoffMillis, int ahead);
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef JSONTAPE_H
+#define JSONTAPE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+/*
+入站消息的快速json解析，解析结果是一条扁平的节点数组（tape），不为每个值分配堆内存
+- 第一阶段：每次取64个字节，用SSE2一次比较16个字节，得到引号、反斜杠、结构字符、空白的位掩码，
+  用位运算找出被转义的引号、用前缀异或算出字符串内部的范围，提取所有结构字符、引号和标量的起始位置
+- 第二阶段：按结构位置的顺序校验语法并生成节点，容器节点记录子树的结尾，跳过一个值是O(1)的
+- 节点只记录值在原文中的范围，字符串在读取时才解码转义，原文必须在使用tape期间保持有效
+- 遇到第一个'\0'视为输入结束（客户端发送的消息以'\0'结尾）
+- 输入不是合法的json、嵌套过深时parse返回false，由调用方退回nlohmann::json解析
+*/
+class JsonTape
+{
+public:
+    enum Type : uint8_t
+    {
+        TYPE_NONE,      // 不存在的值
+        TYPE_OBJECT,
+        TYPE_ARRAY,
+        TYPE_STRING,
+        TYPE_INT,
+        TYPE_DOUBLE,
+        TYPE_TRUE,
+        TYPE_FALSE,
+        TYPE_NULL,
+    };
+
+    // tape中的一个值，只是节点的下标，复制的代价很小
+    class Value
+    {
+    public:
+        Value() : _tape(nullptr), _index(0), _end(0) {}
+        Value(const JsonTape *tape, uint32_t index, uint32_t end = 0) : _tape(tape), _index(index), _end(end) {}
+
+        Type type() const { return _tape == nullptr ? TYPE_NONE : _tape->_nodes[_index].type; }
+        bool valid() const { return _tape != nullptr; }
+        bool isObject() const { return type() == TYPE_OBJECT; }
+        bool isArray() const { return type() == TYPE_ARRAY; }
+        bool isString() const { return type() == TYPE_STRING; }
+        bool isInt() const { return type() == TYPE_INT; }
+        bool isNumber() const { return type() == TYPE_INT || type() == TYPE_DOUBLE; }
+        bool isBool() const { return type() == TYPE_TRUE || type() == TYPE_FALSE; }
+
+        // 对象的成员，不存在时返回无效的值
+        Value operator[](string_view key) const;
+
+        // 数组的第一个元素，空数组返回无效的值
+        Value first() const;
+
+        // 由first()得到的元素在同一个数组中的下一个元素，没有时返回无效的值
+        Value next() const;
+
+        // 数组的元素个数、对象的成员个数
+        size_t size() const;
+
+        // 按顺序访问对象的每个成员 fn(成员名, 值)，成员名含转义时传入解码后的名字
+        template <typename F>
+        void forEach(F &&fn) const;
+
+        // 按类型读取，类型不符时返回false
+        bool get(int64_t &value) const;
+        bool get(int &value) const;
+        bool get(double &value) const;
+        bool get(bool &value) const;
+        bool get(string &value) const;
+
+        // 按类型读取，类型不符时返回默认值
+        int64_t asInt(int64_t def = 0) const;
+        string asString(const string &def = string()) const;
+        bool asBool(bool def = false) const;
+
+        // 值在原文中的json文本，字符串包括两边的引号
+        string_view raw() const;
+
+    private:
+        const JsonTape *_tape;
+        uint32_t _index;
+        uint32_t _end;      // 所在数组的结尾，用于next()
+    };
+
+    // 解析[data, data + len)，成功后可以通过root()读取
+    bool parse(const char *data, size_t len);
+    bool parse(const string &text) { return parse(text.data(), text.size()); }
+    // tape引用原文，不能解析临时的字符串
+    bool parse(string &&text) = delete;
+
+    // 根节点，解析失败时返回无效的值
+    Value root() const { return _nodes.empty() ? Value() : Value(this, 0); }
+
+    // 把json字符串的内容（不含引号）解码到out，转义不合法时返回false
+    static bool unescape(const char *p, size_t len, string &out);
+
+private:
+    struct Node
+    {
+        uint32_t begin;     // 值在原文中的起始位置
+        uint32_t end;       // 值在原文中的结束位置（不含）
+        uint32_t next;      // 子树之后的下一个节点，即下一个兄弟节点
+        Type type;
+        bool escaped;       // 字符串中含有转义
+        union
+        {
+            int64_t i;
+            double d;
+        } num;
+    };
+
+    // 第一阶段：提取结构位置
+    bool index(const char *data, size_t len);
+
+    // 第二阶段：从第k个结构位置开始解析一个值
+    bool parseValue(size_t &k, int depth);
+    bool parseString(size_t &k);
+    bool parseScalar(size_t &k);
+
+    const char *_text = nullptr;
+    size_t _len = 0;
+    vector<uint32_t> _structurals;
+    vector<Node> _nodes;
+};
+
+template <typename F>
+void JsonTape::Value::forEach(F &&fn) const
+{
+    if (type() != TYPE_OBJECT)
+    {
+        return;
+    }
+    const vector<Node> &nodes = _tape->_nodes;
+    uint32_t end = nodes[_index].next;
+    string decoded;
+    for (uint32_t i = _index + 1; i < end; i = nodes[i + 1].next)
+    {
+        const Node &name = nodes[i];
+        string_view key(_tape->_text + name.begin + 1, name.end - name.begin - 2);
+        if (name.escaped)
+        {
+            // 转义在解析时已经校验过
+            unescape(key.data(), key.size(), decoded);
+            key = decoded;
+        }
+        fn(key, Value(_tape, i + 1));
+    }
+}
+
+#endif
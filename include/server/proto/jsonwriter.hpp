@@ -0,0 +1,241 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstdint>
+using namespace std;
+
+/*
+成员名片段 "name": ，在编译期生成，写入时整段追加，不需要逐字符转义
+成员名只能是不需要转义的字符，如 static constexpr JsonKey KEY_ERRNO("errno");
+*/
+template <size_t N>
+struct JsonKey
+{
+    char text[N + 2];
+
+    constexpr JsonKey(const char (&name)[N]) : text()
+    {
+        text[0] = '"';
+        for (size_t i = 0; i + 1 < N; ++i)
+        {
+            text[i + 1] = name[i];
+        }
+        text[N] = '"';
+        text[N + 1] = ':';
+    }
+};
+
+// 需要转义的字符对应转义序列中反斜杠后的字符，控制字符写成\u00XX，不需要转义的为0
+struct JsonEscapeTable
+{
+    char c[256];
+
+    constexpr JsonEscapeTable() : c()
+    {
+        for (int i = 0; i < 0x20; ++i)
+        {
+            c[i] = 'u';
+        }
+        c['"'] = '"';
+        c['\\'] = '\\';
+        c['\n'] = 'n';
+        c['\r'] = 'r';
+        c['\t'] = 't';
+        c['\b'] = 'b';
+        c['\f'] = 'f';
+    }
+
+    constexpr char operator[](unsigned char i) const { return c[i]; }
+};
+
+/*
+流式生成json文本，直接追加到输出字符串中，不构建json对象
+- 数字用to_chars写入栈上的缓冲区再追加，字符串只在含有需要转义的字符时才逐段处理
+- 逗号由写入器记录，调用方按 beginObject/key/value/endObject 的顺序调用即可
+- buffer()返回本线程复用的输出字符串，容量在多次响应之间保留，生成一条响应不需要分配内存；
+  取得后应在下一次调用buffer()之前发送出去
+*/
+class JsonWriter
+{
+public:
+    explicit JsonWriter(string &out) : _out(out), _comma(false) {}
+
+    // 本线程复用的输出字符串，返回前清空
+    static string &buffer()
+    {
+        static thread_local string out;
+        out.clear();
+        return out;
+    }
+
+    JsonWriter &beginObject()
+    {
+        separate();
+        _out += '{';
+        _comma = false;
+        return *this;
+    }
+
+    JsonWriter &endObject()
+    {
+        _out += '}';
+        _comma = true;
+        return *this;
+    }
+
+    JsonWriter &beginArray()
+    {
+        separate();
+        _out += '[';
+        _comma = false;
+        return *this;
+    }
+
+    JsonWriter &endArray()
+    {
+        _out += ']';
+        _comma = true;
+        return *this;
+    }
+
+    // 成员名，之后必须写入一个值
+    template <size_t N>
+    JsonWriter &key(const JsonKey<N> &key)
+    {
+        separate();
+        _out.append(key.text, N + 2);
+        _comma = false;
+        return *this;
+    }
+
+    // 运行时才知道的成员名，按字符串转义
+    JsonWriter &key(string_view name)
+    {
+        separate();
+        appendString(_out, name);
+        _out += ':';
+        _comma = false;
+        return *this;
+    }
+
+    JsonWriter &value(int v) { return integer(v); }
+    JsonWriter &value(long v) { return integer(v); }
+    JsonWriter &value(long long v) { return integer(v); }
+    JsonWriter &value(unsigned v) { return integer(v); }
+    JsonWriter &value(unsigned long v) { return integer(v); }
+
+    JsonWriter &value(bool v)
+    {
+        separate();
+        _out += v ? "true" : "false";
+        _comma = true;
+        return *this;
+    }
+
+    JsonWriter &value(string_view v)
+    {
+        separate();
+        appendString(_out, v);
+        _comma = true;
+        return *this;
+    }
+
+    JsonWriter &value(const string &v) { return value(string_view(v)); }
+    JsonWriter &value(const char *v) { return value(string_view(v)); }
+
+    // 数组，元素按各自的类型写入
+    template <typename E>
+    JsonWriter &value(const vector<E> &v)
+    {
+        beginArray();
+        for (const E &e : v)
+        {
+            value(e);
+        }
+        return endArray();
+    }
+
+    // 已经是json文本的值（如原样保存的聊天消息），原样写入
+    JsonWriter &raw(string_view json)
+    {
+        separate();
+        _out.append(json.data(), json.size());
+        _comma = true;
+        return *this;
+    }
+
+    // 成员名和值
+    template <size_t N, typename V>
+    JsonWriter &field(const JsonKey<N> &k, const V &v)
+    {
+        key(k);
+        return value(v);
+    }
+
+    // 追加一个转义后的json字符串（含两边的引号）
+    static void appendString(string &out, string_view s)
+    {
+        static const char HEX[] = "0123456789abcdef";
+        out.reserve(out.size() + s.size() + 2);
+        out += '"';
+        const char *p = s.data();
+        const char *end = p + s.size();
+        const char *run = p;    // 尚未写出的不需要转义的一段
+        for (; p < end; ++p)
+        {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (!ESCAPE[c])
+            {
+                continue;
+            }
+            out.append(run, p - run);
+            run = p + 1;
+            char pair[2] = {'\\', ESCAPE[c]};
+            if (ESCAPE[c] != 'u')
+            {
+                out.append(pair, 2);
+            }
+            else
+            {
+                char unicode[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                out.append(unicode, 6);
+            }
+        }
+        out.append(run, end - run);
+        out += '"';
+    }
+
+private:
+    // 同一层中第二个及之后的值前面加逗号
+    void separate()
+    {
+        if (_comma)
+        {
+            _out += ',';
+        }
+    }
+
+    template <typename I>
+    JsonWriter &integer(I v)
+    {
+        separate();
+        char buf[24];
+        char *end = to_chars(buf, buf + sizeof(buf), v).ptr;
+        _out.append(buf, end - buf);
+        _comma = true;
+        return *this;
+    }
+
+    // 字符串转义表
+    static constexpr JsonEscapeTable ESCAPE{};
+
+
+    string &_out;
+    bool _comma;
+};
+
+#endif
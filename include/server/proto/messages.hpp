@@ -0,0 +1,366 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include "public.hpp"
+#include "jsontape.hpp"
+#include "jsonwriter.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+using namespace std;
+
+/*
+客户端请求的消息结构，每种EnMsgType一个结构体，服务器和客户端共用
+- 每个结构体用fields()在编译期列出字段：json中的成员名、结构体的成员指针、是否必须出现
+- decode：一遍遍历快速解析结果中对象的成员，按成员名匹配字段并直接写入结构体成员，
+  不在字段列表中的成员（如msgid）被跳过；必需字段缺失或类型不符时返回false
+- encode：按字段顺序生成 {"msgid":MSGID,...}
+- 聊天消息和系统公告的内容由服务器原样转发，结构体只描述服务器需要读取的路由字段，
+  解码时把整条消息保存在body中
+*/
+namespace proto
+{
+
+template <typename T, typename M>
+struct Field
+{
+    string_view name;
+    M T::*member;
+    bool required;
+};
+
+// 必须出现的字段
+template <typename T, typename M>
+constexpr Field<T, M> required(string_view name, M T::*member)
+{
+    return Field<T, M>{name, member, true};
+}
+
+// 可以省略的字段，省略时保留成员的默认值
+template <typename T, typename M>
+constexpr Field<T, M> optional(string_view name, M T::*member)
+{
+    return Field<T, M>{name, member, false};
+}
+
+// 整条消息由服务器原样转发的结构体继承它，解码时保存原始消息
+struct Forwarded
+{
+    JsonTape::Value body;
+};
+
+// 登录  id password [coalesce] [ack] [proto]
+struct LoginReq
+{
+    static constexpr int MSGID = LOGIN_MSG;
+    int id = 0;
+    string password;
+    bool coalesce = false;      // 客户端可以解析合并发送的批量帧
+    bool ack = false;           // 客户端会回复送达确认
+    int proto = LOGIN_PROTO_STRING;     // 客户端可以解析的登录响应版本，见EnLoginProto
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &LoginReq::id), required("password", &LoginReq::password),
+                          optional("coalesce", &LoginReq::coalesce), optional("ack", &LoginReq::ack),
+                          optional("proto", &LoginReq::proto));
+    }
+};
+
+// 注销  id
+struct LoginOutReq
+{
+    static constexpr int MSGID = LOGINOUT_MSG;
+    int id = 0;
+
+    static constexpr auto fields() { return make_tuple(required("id", &LoginOutReq::id)); }
+};
+
+// 注册  name password
+struct RegReq
+{
+    static constexpr int MSGID = REG_MSG;
+    string name;
+    string password;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("name", &RegReq::name), required("password", &RegReq::password));
+    }
+};
+
+// 一对一聊天  id to，其余内容原样转发
+struct OneChatMsg : Forwarded
+{
+    static constexpr int MSGID = ONE_CHAT_MSG;
+    int id = 0;
+    int to = 0;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &OneChatMsg::id), required("to", &OneChatMsg::to));
+    }
+};
+
+// 添加好友  id friendid
+struct AddFriendReq
+{
+    static constexpr int MSGID = ADD_FRIEND_MSG;
+    int id = 0;
+    int friendid = 0;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &AddFriendReq::id), required("friendid", &AddFriendReq::friendid));
+    }
+};
+
+// 创建群组  id groupname groupdesc
+struct CreateGroupReq
+{
+    static constexpr int MSGID = CREATE_GROUP_MSG;
+    int id = 0;
+    string groupname;
+    string groupdesc;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &CreateGroupReq::id), required("groupname", &CreateGroupReq::groupname),
+                          required("groupdesc", &CreateGroupReq::groupdesc));
+    }
+};
+
+// 加入群组  id groupid
+struct AddGroupReq
+{
+    static constexpr int MSGID = ADD_GROUP_MSG;
+    int id = 0;
+    int groupid = 0;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &AddGroupReq::id), required("groupid", &AddGroupReq::groupid));
+    }
+};
+
+// 群聊天  id groupid，其余内容原样转发
+struct GroupChatMsg : Forwarded
+{
+    static constexpr int MSGID = GROUP_CHAT_MSG;
+    int id = 0;
+    int groupid = 0;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &GroupChatMsg::id), required("groupid", &GroupChatMsg::groupid));
+    }
+};
+
+// 群消息同步  id groupid since
+struct GroupSyncReq
+{
+    static constexpr int MSGID = GROUP_SYNC_MSG;
+    int id = 0;
+    int groupid = 0;
+    long long since = 0;
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &GroupSyncReq::id), required("groupid", &GroupSyncReq::groupid),
+                          required("since", &GroupSyncReq::since));
+    }
+};
+
+// 系统公告  id，其余内容原样转发
+struct BroadcastMsg : Forwarded
+{
+    static constexpr int MSGID = BROADCAST_MSG;
+    int id = 0;
+
+    static constexpr auto fields() { return make_tuple(required("id", &BroadcastMsg::id)); }
+};
+
+// 历史消息查询  id peer|groupid [before] [limit]，groupid不为0时查询群组
+struct HistoryReq
+{
+    static constexpr int MSGID = HISTORY_MSG;
+    int id = 0;
+    int peer = 0;
+    int groupid = 0;
+    int64_t before = 0;
+    int limit = 0;              // 0表示使用默认的每页条数
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &HistoryReq::id), optional("peer", &HistoryReq::peer),
+                          optional("groupid", &HistoryReq::groupid), optional("before", &HistoryReq::before),
+                          optional("limit", &HistoryReq::limit));
+    }
+};
+
+// 历史消息搜索  id [query] [limit]
+struct SearchReq
+{
+    static constexpr int MSGID = SEARCH_MSG;
+    int id = 0;
+    string query;
+    int limit = 0;              // 0表示使用默认的条数
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &SearchReq::id), optional("query", &SearchReq::query),
+                          optional("limit", &SearchReq::limit));
+    }
+};
+
+// 聊天消息送达确认  mids
+struct DeliveryAckReq
+{
+    static constexpr int MSGID = DELIVERY_ACK;
+    vector<int64_t> mids;
+
+    static constexpr auto fields() { return make_tuple(required("mids", &DeliveryAckReq::mids)); }
+};
+
+// 会话列表查询  id [limit]
+struct ConvListReq
+{
+    static constexpr int MSGID = CONV_LIST_MSG;
+    int id = 0;
+    int limit = 0;              // 0表示使用默认的会话数
+
+    static constexpr auto fields()
+    {
+        return make_tuple(required("id", &ConvListReq::id), optional("limit", &ConvListReq::limit));
+    }
+};
+
+namespace detail
+{
+// 按成员的类型读取一个值，类型不符时返回false
+inline bool decodeValue(const JsonTape::Value &value, int &out) { return value.get(out); }
+inline bool decodeValue(const JsonTape::Value &value, bool &out) { return value.get(out); }
+inline bool decodeValue(const JsonTape::Value &value, string &out) { return value.get(out); }
+
+inline bool decodeValue(const JsonTape::Value &value, long &out)
+{
+    int64_t v;
+    if (!value.get(v))
+    {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+inline bool decodeValue(const JsonTape::Value &value, long long &out)
+{
+    int64_t v;
+    if (!value.get(v))
+    {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+template <typename E>
+bool decodeValue(const JsonTape::Value &value, vector<E> &out)
+{
+    if (!value.isArray())
+    {
+        return false;
+    }
+    out.clear();
+    out.reserve(value.size());
+    for (JsonTape::Value item = value.first(); item.valid(); item = item.next())
+    {
+        out.emplace_back();
+        if (!decodeValue(item, out.back()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 必需字段的位掩码
+template <typename Tuple, size_t... I>
+constexpr uint64_t requiredMask(const Tuple &fields, index_sequence<I...>)
+{
+    return ((get<I>(fields).required ? (1ULL << I) : 0ULL) | ... | 0ULL);
+}
+
+// 在字段列表中查找成员名并写入对应的结构体成员，seen记录出现过的字段
+template <typename T, typename Tuple, size_t... I>
+bool decodeMember(const Tuple &fields, string_view name, const JsonTape::Value &value, T &out, uint64_t &seen,
+                  index_sequence<I...>)
+{
+    bool ok = true;
+    // 逐个比较，匹配到一个字段后短路
+    (void)((get<I>(fields).name == name
+                ? (seen |= 1ULL << I, ok = decodeValue(value, out.*(get<I>(fields).member)), true)
+                : false) ||
+           ...);
+    return ok;
+}
+
+template <typename T, typename Tuple, size_t... I>
+void encodeFields(JsonWriter &writer, const Tuple &fields, const T &msg, index_sequence<I...>)
+{
+    (writer.key(get<I>(fields).name).value(msg.*(get<I>(fields).member)), ...);
+}
+} // namespace detail
+
+// 从快速解析结果中解码消息，必需字段缺失或字段类型不符时返回false
+template <typename T>
+bool decode(const JsonTape::Value &obj, T &out)
+{
+    constexpr auto fields = T::fields();
+    constexpr size_t count = tuple_size<decltype(fields)>::value;
+    static_assert(count <= 64, "too many fields");
+    constexpr uint64_t mask = detail::requiredMask(fields, make_index_sequence<count>());
+
+    if (!obj.isObject())
+    {
+        return false;
+    }
+    uint64_t seen = 0;
+    bool ok = true;
+    obj.forEach([&](string_view name, const JsonTape::Value &value) {
+        if (ok)
+        {
+            ok = detail::decodeMember(fields, name, value, out, seen, make_index_sequence<count>());
+        }
+    });
+    if (!ok || (seen & mask) != mask)
+    {
+        return false;
+    }
+    if constexpr (is_base_of<Forwarded, T>::value)
+    {
+        out.body = obj;
+    }
+    return true;
+}
+
+// 把消息编码为json文本，msgid在最前
+template <typename T>
+string encode(const T &msg)
+{
+    static constexpr JsonKey KEY_MSGID("msgid");
+    constexpr auto fields = T::fields();
+    string out;
+    JsonWriter writer(out);
+    writer.beginObject().field(KEY_MSGID, T::MSGID);
+    detail::encodeFields(writer, fields, msg, make_index_sequence<tuple_size<decltype(fields)>::value>());
+    writer.endObject();
+    return out;
+}
+
+} // namespace proto
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <mutex>
+#include <chrono>
+using namespace std;
+
+// 令牌桶限流：每秒补充rate个令牌，最多积攒burst个，每次操作消耗一个令牌
+class RateLimiter
+{
+public:
+    RateLimiter(double rate, double burst);
+
+    // 取一个令牌，没有令牌时返回false
+    bool tryAcquire();
+
+private:
+    mutex _mutex;
+    double _rate;
+    double _burst;
+    double _tokens;
+    chrono::steady_clock::time_point _last;
+};
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef REDIS_H
 #define REDIS_H
 
+#include "messagebus.hpp"
 #include <hiredis/hiredis.h>
 #include <thread>
+#include <mutex>
 #include <functional>
 using namespace std;
 
@@ -10,39 +12,70 @@ using namespace std;
 redis作为集群服务器通信的基于发布-订阅消息队列时，会遇到两个难搞的bug问题，参考我的博客详细描述：
 https://blog.csdn.net/QIANGWEIYUAN/article/details/97895611
 */
-class Redis
+class Redis : public MessageBus
 {
 public:
     Redis();
     ~Redis();
 
     // 连接redis服务器 
-    bool connect();
+    bool connect() override;
 
     // 向redis指定的通道channel发布消息
-    bool publish(int channel, string message);
+    bool publish(int channel, string message) override;
+
+    // 批量发布消息，使用管道一次写出所有PUBLISH命令再统一读取响应
+    bool publishBatch(const vector<pair<int, string>> &messages) override;
 
     // 向redis指定的通道subscribe订阅消息
-    bool subscribe(int channel);
+    bool subscribe(int channel) override;
 
     // 向redis指定的通道unsubscribe取消订阅消息
-    bool unsubscribe(int channel);
+    bool unsubscribe(int channel) override;
+
+    // 订阅节点通道 node:<nodeid>
+    bool subscribeNode(int nodeid) override;
+
+    // 向节点通道 node:<nodeid> 发布消息
+    bool publishNode(int nodeid, string message) override;
+
+    // 路由表保存在redis哈希表 chat:route 中，field为userid，value为nodeid
+    bool setRoute(int userid, int nodeid) override;
+    bool removeRoute(int userid) override;
+    bool queryRoutes(const vector<int> &userids, vector<int> &nodeids) override;
+
+    // 群序号保存在 chat:gseq:<groupid> 中，用lua脚本原子地完成自增和下限检查
+    long long nextSequence(int groupid, long long floor) override;
+    long long currentSequence(int groupid) override;
 
     // 在独立线程中接收订阅通道中的消息
     void observer_channel_message();
 
     // 初始化向业务层上报通道消息的回调对象
-    void init_notify_handler(function<void(int, string)> fn);
+    void init_notify_handler(function<void(int, string)> fn) override;
+
+    // 初始化向业务层上报节点通道消息的回调对象
+    void init_node_handler(function<void(int, string)> fn) override;
 
 private:
+    // 通过订阅上下文发送SUBSCRIBE/UNSUBSCRIBE命令，不读取响应
+    bool writeSubscribeCommand(const char *format, const char *channel);
+
     // hiredis同步上下文对象，负责publish消息
     redisContext *_publish_context;
 
     // hiredis同步上下文对象，负责subscribe消息
     redisContext *_subscribe_context;
 
+    // 多个I/O线程会同时发布、订阅，hiredis上下文不是线程安全的
+    mutex _publish_mutex;
+    mutex _subscribe_mutex;
+
     // 回调操作，收到订阅的消息，给service层上报，<int, string> 即 <通道号， 数据>
     function<void(int, string)> _notify_message_handler;
+
+    // 回调操作，收到节点通道的消息，给service层上报，<节点号， 数据>
+    function<void(int, string)> _notify_node_handler;
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef HISTORYSEARCH_H
+#define HISTORYSEARCH_H
+
+#include "invertedindex.hpp"
+#include "historymodel.hpp"
+#include <set>
+#include <thread>
+#include <condition_variable>
+using namespace std;
+
+/*
+历史消息的全文搜索
+- 后台线程按消息id增量读取history表中的新消息加入倒排索引，history表由集群中所有节点共同写入，
+  每个节点的索引都覆盖整个集群的消息
+- 启动时从最近search_rebuild_hours小时的消息开始建立索引；之后每search_expire_minutes分钟
+  删除一次早于这个期限的消息，索引只保留最近search_rebuild_hours小时的消息，不会无限增长
+- 各节点的消息写入有先后，id较小的消息可能晚于id较大的消息写入，
+  每次读取时回退search_lag_ms毫秒的窗口重新扫描，窗口内已经索引过的消息id记录在集合中去重
+- 查询时由调用方给出用户可以访问的会话，只返回这些会话中的消息
+*/
+class HistorySearch
+{
+public:
+    HistorySearch();
+    ~HistorySearch();
+
+    // 查询userid用户可以访问的消息，groups为用户所在的群组，按相关度从高到低最多返回limit条
+    vector<InvertedIndex::Hit> search(int userid, const vector<int> &groups, const string &query, size_t limit);
+
+private:
+    // 后台线程
+    void run();
+
+    // 读取一次新消息，返回加入索引的消息数
+    size_t poll();
+
+    // 当前时间往前search_rebuild_hours小时对应的消息id
+    int64_t cutoffId();
+
+    InvertedIndex _index;
+    HistoryModel _historyModel;
+
+    int _pollMs;            // 读取新消息的间隔
+    int64_t _retainMillis;  // 索引保留的时间范围
+    int64_t _expireMillis;  // 删除过期消息的间隔
+    int64_t _lagIds;        // 回退扫描的窗口，换算成id的差值
+    int64_t _watermark;     // 已经读取到的最大消息id
+    set<int64_t> _recent;   // 回退窗口内已经索引过的消息id
+
+    mutex _mutex;
+    condition_variable _cond;
+    bool _quit;
+    thread _thread;
+};
+
+#endif
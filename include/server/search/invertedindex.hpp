@@ -0,0 +1,72 @@
+#ifndef INVERTEDINDEX_H
+#define INVERTEDINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+using namespace std;
+
+/*
+聊天消息的内存倒排索引
+- 分词：ASCII字母数字按单词切分并转小写；中日韩文字没有空格分隔，连续的文字切成二元组，
+  同时索引单字，单字查询也能命中
+- 倒排表：每个词一个字节数组，依次存放 (文档号差值, 词频) 两个varint，文档号按加入顺序递增，
+  只在末尾追加，增量更新不需要重写
+- 过期：删除消息时重写所有倒排表，去掉过期的文档并重新编号，由调用方定期按批进行
+- 查询：所有查询词都出现的消息才命中，按BM25打分排序；由调用方提供的过滤函数做访问控制，
+  在解码最短的倒排表时就过滤掉无权访问的消息，求交集和打分只针对剩下的候选
+*/
+class InvertedIndex
+{
+public:
+    // 一条命中的消息
+    struct Hit
+    {
+        int64_t mid;    // 消息id
+        int64_t convid; // 会话号
+        double score;
+    };
+
+    // 加入一条消息
+    void add(int64_t mid, int64_t convid, const string &text);
+
+    // 删除消息id小于minMid的消息，返回删除的消息数
+    size_t expire(int64_t minMid);
+
+    // 查询包含query中所有词的消息，allow返回false的会话被过滤，按得分从高到低最多返回limit条
+    vector<Hit> search(const string &query, const function<bool(int64_t convid)> &allow, size_t limit);
+
+    // 已索引的消息数
+    size_t docCount();
+
+    // 倒排表占用的字节数
+    size_t postingBytes();
+
+    // 把text切分成词
+    static vector<string> tokenize(const string &text);
+
+private:
+    struct Doc
+    {
+        int64_t mid;
+        int64_t convid;
+        uint32_t length;    // 词数
+    };
+
+    struct Posting
+    {
+        string bytes;       // (文档号差值, 词频) 的varint序列
+        uint32_t lastDoc;   // 最后一个文档号，用于计算差值
+        uint32_t df;        // 包含该词的文档数
+    };
+
+    mutex _mutex;
+    vector<Doc> _docs;
+    unordered_map<string, Posting> _postings;
+    uint64_t _totalLength = 0;
+};
+
+#endif
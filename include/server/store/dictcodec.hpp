@@ -0,0 +1,50 @@
+#ifndef DICTCODEC_H
+#define DICTCODEC_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+/*
+基于训练字典的消息压缩编码
+聊天消息是json.dump()的输出，每条都重复 {"msgid":、,"name":"、","time":"2026- 这样的片段，
+用样本训练出一个片段字典，编码时把片段替换成1~2字节的编号
+- json.dump()把小于0x20的控制字符转义输出，消息中不会出现这些字节，用它们作为编号：
+  0x01~0x1E表示字典的前30项，0x1F后跟一个0x20~0x7E的字节表示之后的95项，其余字节原样保留
+- 编号都是ASCII字节，不会和消息中的多字节字符组合，存入mysql文本列也不会被字符集转换破坏
+- 含有控制字符的输入无法编码，由调用方原样存储
+*/
+class DictCodec
+{
+public:
+    static constexpr size_t SHORT_CODES = 30;   // 单字节编号的项数
+    static constexpr size_t LONG_CODES = 95;    // 双字节编号的项数
+    static constexpr size_t MAX_ENTRIES = SHORT_CODES + LONG_CODES;
+
+    explicit DictCodec(vector<string> entries);
+
+    // 从样本中训练字典，按节省的字节数从多到少排列
+    static vector<string> train(const vector<string> &samples, size_t maxEntries = MAX_ENTRIES);
+
+    // 编码input追加到out，input中有控制字符时返回false
+    bool encode(const string &input, string &out) const;
+
+    // 解码[data, data + len)追加到out，遇到字典中没有的编号返回false
+    bool decode(const char *data, size_t len, string &out) const;
+
+    // 字典的序列化形式，各项以'\n'分隔
+    string serialize() const;
+    static vector<string> deserialize(const string &text);
+
+    const vector<string> &entries() const { return _entries; }
+
+private:
+    vector<string> _entries;
+    // 以前两个字节为下标的查找表：_order[_start[k], _start[k + 1])是以前缀k开头的字典项，
+    // 按长度从长到短排列，编码时取第一个匹配的即为最长的匹配
+    vector<uint16_t> _start;
+    vector<uint8_t> _order;
+};
+
+#endif
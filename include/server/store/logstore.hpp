@@ -0,0 +1,175 @@
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include "offlinestore.hpp"
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <cstdint>
+
+/*
+服务器内嵌的离线消息存储引擎，数据以追加写的日志段文件保存
+- 日志目录下按编号存放段文件 segment-<编号>.log，当前段写满后换新段
+- 记录格式：长度(4) + crc32(4) + 类型(1) + 填充(3) + userid(4) + 序号(8) + 消息内容
+  PUT记录保存一条离线消息，DEL记录表示删除该用户序号更小的所有离线消息
+- 内存中维护每个用户的收件箱索引（消息所在的段、位置、长度），读取时通过mmap直接拷贝消息内容
+- 组提交：写入方把记录放入缓冲区后等待落盘，刷盘线程每次把缓冲区中所有的记录一次写入并fdatasync，
+  一次fsync确认一批写入方；写入或落盘失败时整批不进入索引，已写入的部分截断，
+  缓冲区中的后续记录改写到新的段中，等待这一批的写入方得到失败的结果
+- 压缩：最老的段中有效消息的比例低于阈值时，把有效消息重新追加到当前段后删除该段
+- 恢复：启动时按序扫描所有段重建索引，最后一个段尾部不完整或校验失败的记录被截断；
+  压缩搬移后、删除旧段前崩溃时同一条消息有两份，按序号去重
+- 过期：最后一次写入早于保留期限的段整个删除（unlink），从最老的段开始，遇到未过期的段就停止，
+  删除记录只作用于更老的段，按顺序删除不会让已删除的消息在恢复时重新出现；
+  压缩搬移的消息写入新的段，保留时间从搬移时重新计算
+- 搬移期间消息被删除时，搬移后的记录在删除记录之后的段中，删除记录所在的段被删除后会在恢复时重新出现，
+  因此为它补写一条删除记录
+*/
+class LogStore : public OfflineStore
+{
+public:
+    // dir为日志目录，segmentBytes为单个段文件的最大字节数
+    LogStore(const string &dir, size_t segmentBytes);
+    ~LogStore();
+
+    // 打开日志目录，扫描已有的段文件恢复索引，并启动刷盘和压缩线程
+    bool open();
+
+    // 存储用户的离线消息，返回时已经落盘，写入失败返回false
+    bool insert(int userid, string msg) override;
+
+    // 批量存储离线消息，一次组提交
+    bool insert(const vector<pair<int, string>> &msgs) override;
+
+    // 删除用户的离线消息，返回时删除记录已经落盘，写入失败返回false
+    bool remove(int userid) override;
+
+    // 查询用户的离线消息
+    vector<string> query(int userid) override;
+
+    // 读取并删除用户的离线消息，删除记录只覆盖读出的消息，之后写入的消息不受影响
+    vector<string> take(int userid) override;
+
+    // 删除最后一次写入早于cutoffMillis的段，返回删除的段数
+    int expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs) override;
+
+    // 各段保留的离线消息，行数为段中有效的消息数
+    vector<PartitionInfo> partitions() override;
+
+    // 压缩一次最老的段，返回是否删除了段文件，供后台线程和测试调用
+    bool compact();
+
+private:
+    enum RecordType
+    {
+        RECORD_PUT = 1,
+        RECORD_DEL = 2,
+    };
+
+    // 一条离线消息在日志中的位置
+    struct Location
+    {
+        uint32_t segment;   // 段编号
+        uint32_t offset;    // 消息内容在段文件中的偏移
+        uint32_t length;    // 消息内容的长度
+        uint64_t seq;       // 写入序号，决定收件箱中的顺序
+    };
+
+    // 一个段文件
+    struct Segment
+    {
+        int fd = -1;
+        size_t size = 0;        // 已经写入文件的字节数
+        char *map = nullptr;    // 只读映射
+        size_t mapped = 0;      // 映射的字节数
+        size_t records = 0;     // 段中PUT记录的总数
+        size_t live = 0;        // 段中仍在索引中的PUT记录数
+        size_t tombstones = 0;  // 段中的DEL记录数
+    };
+
+    // 等待刷盘的一条记录
+    struct Pending
+    {
+        uint32_t segment;
+        uint32_t offset;        // 记录在段文件中的偏移
+        RecordType type;
+        int userid;
+        uint64_t seq;
+        bool moved;             // 压缩时搬移的记录，只更新索引中的位置
+        uint64_t lsn;           // 等待落盘用的编号
+        string data;            // 编码后的整条记录
+    };
+
+    // 追加一条记录到缓冲区，返回等待落盘用的编号，调用时需持有_writeMutex
+    uint64_t appendLocked(RecordType type, int userid, uint64_t seq, const string &msg, bool moved);
+
+    // 等待编号last之前的记录全部落盘，返回[first, last]中的记录是否都写入成功
+    bool waitDurable(uint64_t first, uint64_t last);
+
+    // 刷盘线程
+    void flushLoop();
+
+    // 把一批记录写入段文件并落盘，然后更新索引，写入失败时截断已写入的部分并返回false
+    bool flushBatch(vector<Pending> &batch);
+
+    // 写入失败后当前段不再使用，缓冲区中的记录改写到新的段中，调用时需持有_writeMutex
+    void sealActiveLocked();
+
+    // 压缩线程
+    void compactLoop();
+
+    // 扫描一个段文件恢复记录，last表示是否是最后一个段
+    bool recoverSegment(uint32_t id, bool last, unordered_map<int, uint64_t> &deleted,
+                        vector<pair<int, Location>> &puts, uint64_t &maxSeq);
+
+    // 打开（必要时创建）段文件，调用时需持有_indexMutex
+    Segment *openSegmentLocked(uint32_t id);
+
+    // 保证段的映射覆盖[0, end)，调用时需持有_indexMutex
+    bool mapSegmentLocked(Segment &seg, size_t end);
+
+    // 关闭并删除段文件，调用时需持有_indexMutex
+    void dropSegmentLocked(uint32_t id);
+
+    string segmentPath(uint32_t id) const;
+
+    string _dir;
+    size_t _segmentBytes;
+    bool _sync;             // 是否fdatasync，关闭后只保证写入操作系统缓存
+    int _compactPercent;    // 最老的段中有效消息低于该百分比时压缩
+
+    // 写入端状态：缓冲区、当前段、下一个序号和落盘进度
+    mutex _writeMutex;
+    condition_variable _flushCond;      // 通知刷盘线程有新的记录
+    condition_variable _durableCond;    // 通知写入方记录已经落盘
+    vector<Pending> _pending;
+    uint32_t _activeSegment;
+    size_t _activeSize;
+    uint64_t _nextSeq;
+    uint64_t _appendLsn;
+    uint64_t _durableLsn;
+    deque<pair<uint64_t, uint64_t>> _failed;   // 最近写入失败的批次的编号范围
+    bool _quit;
+
+    // 索引和段文件
+    mutex _indexMutex;
+    unordered_map<int, vector<Location>> _inbox;
+    map<uint32_t, Segment> _segments;
+    uint32_t _sealedBelow;  // 编号小于它的段不会再写入新记录，可以压缩
+
+    // 压缩、过期和读取删除不同时进行，压缩搬移消息期间被搬移的段不会被删除
+    mutex _maintainMutex;
+
+    // 压缩线程
+    mutex _compactMutex;
+    condition_variable _compactCond;
+    bool _compactQuit;
+
+    thread _flushThread;
+    thread _compactThread;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef MYSQLOFFLINESTORE_H
+#define MYSQLOFFLINESTORE_H
+
+#include "offlinestore.hpp"
+
+// 离线消息存放在mysql的offlinemessage表中，time列为写入时的毫秒时间戳，表按time每天一个分区
+class MySQLOfflineStore : public OfflineStore
+{
+public:
+    // 存储用户的离线消息
+    bool insert(int userid, string msg) override;
+
+    // 批量存储离线消息，合并为一条多行insert语句
+    bool insert(const vector<pair<int, string>> &msgs) override;
+
+    // 删除用户的离线消息
+    bool remove(int userid) override;
+
+    // 查询用户的离线消息
+    vector<string> query(int userid) override;
+
+    // 在一个事务中读取并删除用户的离线消息
+    vector<string> take(int userid) override;
+
+    // 删除过期的日期分区，提前建立之后几天的分区
+    int expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs) override;
+
+    // offlinemessage表的各分区
+    vector<PartitionInfo> partitions() override;
+
+private:
+    // 在一个事务中读出并删除partitions（逗号分隔的分区名）中对共享内容的引用，计入refs
+    bool takeRefs(const string &partitions, unordered_map<string, int> &refs);
+
+    PartitionModel _partitionModel;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef OFFLINESTORE_H
+#define OFFLINESTORE_H
+
+#include "partitionmodel.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <cstdint>
+using namespace std;
+
+/*
+离线消息存储接口，OfflineMsgModel通过它读写离线消息
+具体实现：
+- mysql : 存放在mysql的offlinemessage表中，按写入日期分区
+- log   : 服务器内嵌的追加写日志存储，不依赖mysql
+- redis : 每个用户一个redis列表，长度上限和保存期限由redis维护
+过期的离线消息按整个分区（日志段）删除，不逐条删除，由ExpiryScheduler在后台线程中调用expire
+*/
+
+// 离线消息中引用共享内容（offlinepayload表）的标记，后跟32个字符的内容哈希
+const char OFFLINE_PAYLOAD_REF = '\x05';
+const size_t OFFLINE_REF_SIZE = 33;
+class OfflineStore
+{
+public:
+    virtual ~OfflineStore() {}
+
+    // 存储用户的离线消息，写入失败返回false
+    virtual bool insert(int userid, string msg) = 0;
+
+    // 批量存储离线消息，<userid, msg>，写入失败返回false
+    virtual bool insert(const vector<pair<int, string>> &msgs) = 0;
+
+    // 删除用户的离线消息，删除失败返回false
+    virtual bool remove(int userid) = 0;
+
+    // 查询用户的离线消息
+    virtual vector<string> query(int userid) = 0;
+
+    // 读取并删除用户的离线消息，读取和删除必须原子地完成，不能删除读取之后写入的消息
+    virtual vector<string> take(int userid) = 0;
+
+    // 删除cutoffMillis之前写入的离线消息，只删除整个都已过期的分区，并为之后的写入准备分区
+    // refs返回删除的消息中对共享内容的引用，<hash, 引用数>，由调用方减少引用
+    // 返回删除的分区数
+    virtual int expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs) = 0;
+
+    // 是否可以存放共享内容的引用：存储丢弃的每条离线消息都要经take或expire交回，引用数才能减到0
+    virtual bool sharesPayloads() const { return true; }
+
+    // 各分区保留的离线消息
+    virtual vector<PartitionInfo> partitions() = 0;
+
+    // 进程内唯一的离线消息存储，由配置项offline_store选择实现，默认mysql
+    static OfflineStore *instance();
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PAYLOADCODEC_H
+#define PAYLOADCODEC_H
+
+#include "dictcodec.hpp"
+#include "dictionarymodel.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+using namespace std;
+
+/*
+离线消息和历史消息的透明压缩，OfflineMsgModel和HistoryModel在存取时调用
+- 字典按版本保存在payloaddict表中，集群共用，编码后的消息记录所用字典的版本：
+  0x02 + 十进制版本号 + 0x03 + DictCodec编码的内容
+- 未编码的消息（压缩启用前写入的、含控制字符的、编码后没有变小的）以'{'开头，原样返回
+- 还没有字典时先原样存储，收集codec_train_samples条消息作为样本训练出第一个版本；
+  codec_retrain=1时启动后用新的样本训练下一个版本，旧版本的字典保留，用于读取旧消息
+- 读取到本节点没有加载的版本（其他节点新训练的）时重新读取字典表
+- 配置项payload_codec=none关闭压缩，仍然可以读取已经压缩的消息
+*/
+class PayloadCodec
+{
+public:
+    static PayloadCodec *instance();
+
+    // 编码一条要存储的消息
+    string encode(const string &payload);
+
+    // 解码一条存储的消息
+    string decode(const string &stored);
+
+private:
+    PayloadCodec();
+
+    // 读取字典表，加载本节点没有的版本，返回最新的版本号
+    int loadLocked();
+
+    // 用样本训练下一个版本的字典并写入字典表
+    void train(vector<string> samples);
+
+    DictionaryModel _dictModel;
+
+    bool _enabled;
+    size_t _trainSamples;   // 训练使用的样本数
+
+    mutex _mutex;
+    map<int, shared_ptr<const DictCodec>> _dicts;   // 所有已加载的版本
+    int _activeVersion;                             // 编码使用的版本，0表示还没有可用的字典
+    bool _collecting;                               // 是否在收集训练样本
+    vector<string> _samples;
+};
+
+#endif
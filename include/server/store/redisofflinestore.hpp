@@ -0,0 +1,63 @@
+#ifndef REDISOFFLINESTORE_H
+#define REDISOFFLINESTORE_H
+
+#include "offlinestore.hpp"
+#include <hiredis/hiredis.h>
+#include <mutex>
+
+/*
+离线消息存放在redis中，每个用户一个列表 chat:offline:<userid>，按写入顺序排列
+- 离线消息量大、保存时间短，不必进入innodb；消息内容按二进制写入，压缩后的编号字节不受影响
+- 批量写入：按用户合并为一条RPUSH，再LTRIM到长度上限、EXPIRE刷新保存期限，
+  所有命令通过管道一次写出，一批只有一次网络往返
+- 读取并删除：MULTI + LRANGE + DEL + EXEC，读取和删除之间写入的消息不会被误删
+- 过期：列表的长度上限（offline_redis_max）和键的保存期限（offline_ttl_days）由redis维护，
+  没有需要删除的分区；被丢弃的消息无法交回其中的引用，离线消息总是按原样存储，不共享内容
+*/
+class RedisOfflineStore : public OfflineStore
+{
+public:
+    RedisOfflineStore();
+    ~RedisOfflineStore();
+
+    // 连接redis服务器
+    bool connect();
+
+    // 存储用户的离线消息
+    bool insert(int userid, string msg) override;
+
+    // 批量存储离线消息，管道写入
+    bool insert(const vector<pair<int, string>> &msgs) override;
+
+    // 删除用户的离线消息
+    bool remove(int userid) override;
+
+    // 查询用户的离线消息
+    vector<string> query(int userid) override;
+
+    // 原子地读取并删除用户的离线消息
+    vector<string> take(int userid) override;
+
+    // 过期由redis的键过期完成，返回0
+    int expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs) override;
+
+    // 长度上限和键过期丢弃的消息不经过服务器，不能存放共享内容的引用
+    bool sharesPayloads() const override { return false; }
+
+    // redis中没有分区，返回空
+    vector<PartitionInfo> partitions() override;
+
+private:
+    // 保证连接可用，连接出错后在下次调用时重连，调用时需持有_mutex
+    bool readyLocked();
+
+    // 读取管道中的count个响应，返回是否都没有出错，调用时需持有_mutex
+    bool drainLocked(size_t count);
+
+    redisContext *_context;
+    mutex _mutex;           // hiredis上下文不是线程安全的
+    long long _maxPerUser;  // 每个用户最多保存的离线消息数
+    long long _ttlSeconds;  // 最后一次写入之后的保存期限，0表示不过期
+};
+
+#endif
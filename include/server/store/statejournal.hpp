@@ -0,0 +1,133 @@
+#ifndef STATEJOURNAL_H
+#define STATEJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <cstdint>
+#include <sys/types.h>
+using namespace std;
+
+/*
+带预写日志的内存状态，进程崩溃后从快照和日志恢复
+- 状态是 key(uint64) -> value(int64) 的哈希表，高8位区分状态的种类（见key()），
+  适合群序号、计数器这类小而频繁更新的状态
+- 每次更新追加一条定长记录：crc32(4) + 类型(1) + 填充(3) + key(8) + value(8)，
+  记录的是更新后的值，重放是幂等的
+- 组提交：更新只追加到内存缓冲区，刷盘线程一次写出缓冲区中所有的记录并fdatasync，
+  需要持久化保证的调用方用waitDurable等待自己的记录落盘，写入失败时waitDurable返回false；
+  写入失败后截断不完整的记录，无法截断时放弃这个日志文件，由快照保存状态并切换到新一代日志
+- 快照：日志写入超过state_snapshot_mb后，在快照线程中把整个状态写入 snapshot-<代>.snap，
+  之后的记录写入新一代日志 journal-<代>.log，快照落盘后删除更早的快照和日志
+- 恢复：载入最新的完整快照，按代重放不早于它的日志，最后一个日志尾部不完整或校验失败的记录被截断
+*/
+class StateJournal
+{
+public:
+    // 状态的种类，放在key的高8位
+    enum Kind
+    {
+        KIND_GROUP_SEQ = 1,     // 群消息序号
+    };
+
+    static uint64_t key(Kind kind, uint64_t id) { return (static_cast<uint64_t>(kind) << 56) | (id & 0x00FFFFFFFFFFFFFFULL); }
+
+    // dir为日志目录，snapshotBytes为触发快照的日志字节数
+    StateJournal(const string &dir, size_t snapshotBytes);
+    ~StateJournal();
+
+    // 打开日志目录，载入快照并重放日志，启动刷盘和快照线程
+    bool open();
+
+    // 查询key的值，不存在时返回false
+    bool get(uint64_t key, int64_t &value);
+
+    // 状态的条目数
+    size_t size();
+
+    // 设置key的值，返回记录的编号
+    uint64_t set(uint64_t key, int64_t value);
+
+    // 原子地用fn(旧值)更新key的值，不存在时旧值为0，返回新值，lsn返回记录的编号
+    int64_t update(uint64_t key, const function<int64_t(int64_t)> &fn, uint64_t &lsn);
+
+    // 删除key，返回记录的编号
+    uint64_t erase(uint64_t key);
+
+    // 等待编号lsn之前的记录全部落盘，编号lsn的记录写入失败时返回false
+    bool waitDurable(uint64_t lsn);
+
+    // 立即写一次快照并删除旧的日志，返回是否成功，供快照线程和测试调用
+    bool snapshot();
+
+private:
+    enum RecordType
+    {
+        RECORD_SET = 1,
+        RECORD_DEL = 2,
+    };
+
+    // 等待写出的一段记录，同一代的记录连续存放
+    struct Chunk
+    {
+        uint32_t gen;
+        string bytes;
+    };
+
+    // 追加一条记录到缓冲区，调用时需持有_mutex
+    uint64_t appendLocked(RecordType type, uint64_t key, int64_t value);
+
+    // 载入快照，失败返回false
+    bool loadSnapshot(uint32_t gen);
+
+    // 重放一代日志，last表示是否是最后一代
+    bool replayJournal(uint32_t gen, bool last);
+
+    // 刷盘线程
+    void flushLoop();
+
+    // 放弃正在写入的日志文件，只在刷盘线程中调用
+    void abandonFile();
+
+    // 快照线程
+    void snapshotLoop();
+
+    string journalPath(uint32_t gen) const;
+    string snapshotPath(uint32_t gen) const;
+
+    string _dir;
+    size_t _snapshotBytes;
+    bool _sync;             // 是否fdatasync
+
+    // 状态和写入缓冲区
+    mutex _mutex;
+    condition_variable _flushCond;      // 通知刷盘线程有新的记录
+    condition_variable _durableCond;    // 通知写入方记录已经落盘
+    unordered_map<uint64_t, int64_t> _state;
+    vector<Chunk> _pending;
+    uint32_t _gen;          // 新记录写入的日志代号
+    uint64_t _appendLsn;
+    uint64_t _durableLsn;   // 刷盘线程处理完的记录编号，其中写入失败的范围在_failed中
+    deque<pair<uint64_t, uint64_t>> _failed;   // 最近写入失败的批次的编号范围
+    size_t _journalBytes;   // 上次快照之后写出的日志字节数
+    bool _quit;
+
+    // 快照线程
+    mutex _snapshotMutex;   // 快照不同时进行
+    condition_variable _snapshotCond;
+    bool _snapshotWanted;
+
+    int _fd;                // 刷盘线程正在写入的日志文件
+    uint32_t _fdGen;
+    off_t _fdBytes;         // 日志文件中完整写入的字节数，写入失败时截断到这里
+
+    thread _flushThread;
+    thread _snapshotThread;
+};
+
+#endif
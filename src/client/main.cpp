@@ -6,6 +6,8 @@
 #include <chrono>
 #include <ctime>
 #include <unordered_map>
+#include <unordered_set>
+#include <deque>
 #include <functional>
 using namespace std;
 using json = nlohmann::json;
@@ -17,10 +19,12 @@ using json = nlohmann::json;
 #include <arpa/inet.h>
 #include <semaphore.h>
 #include <atomic>
+#include <mutex>
 
 #include "group.hpp"
 #include "user.hpp"
 #include "public.hpp"
+#include "messages.hpp"
 
 // 记录当前系统登录的用户信息
 User g_currentUser;
@@ -29,6 +33,16 @@ vector<User> g_currentUserFriendList;
 // 记录当前登录用户的群组列表信息
 vector<Group> g_currentUserGroupList;
 
+// 记录当前登录用户在每个群组中收到的最大消息序号，用于群消息同步
+unordered_map<int, long long> g_groupSeq;
+// 登录时没有收完离线消息的群组，记录下一次群消息同步的起始序号，收完后删除；与g_groupSeq共用一把锁
+unordered_map<int, long long> g_groupBacklog;
+mutex g_groupSeqMutex;
+
+// 记录每个会话下一页历史消息的游标，key为 "one:<userid>" 或 "group:<groupid>"
+unordered_map<string, long long> g_historyCursor;
+mutex g_historyMutex;
+
 // 控制主菜单页面程序
 bool isMainMenuRunning = false;
 
@@ -36,13 +50,53 @@ bool isMainMenuRunning = false;
 sem_t rwsem;
 // 记录登录状态
 atomic_bool g_isLoginSuccess{false}; // 原子布尔类型，在不需要加锁的情况下，确保对变量的读写操作是原子性的。
+// 服务器是否要求回复聊天消息的送达确认
+atomic_bool g_deliveryAck{false};
+
+// 最近收到的聊天消息id，只在接收线程中访问
+// 连接断开时服务器把未确认的消息转存为离线消息，其中可能有已经收到的，按mid去重后再显示
+class RecentMids
+{
+public:
+    explicit RecentMids(size_t capacity) : _capacity(capacity) {}
+
+    // 第一次收到mid时返回true，只记录最近的capacity条
+    bool insert(long long mid)
+    {
+        if (!_seen.insert(mid).second)
+        {
+            return false;
+        }
+        _order.push_back(mid);
+        if (_order.size() > _capacity)
+        {
+            _seen.erase(_order.front());
+            _order.pop_front();
+        }
+        return true;
+    }
+
+private:
+    size_t _capacity;
+    unordered_set<long long> _seen;
+    deque<long long> _order;
+};
+RecentMids g_recentMids(4096);
 
 // 接收线程
 void readTaskHandler(int clientfd);
+// 回复收到的聊天消息的送达确认
+void sendDeliveryAck(int clientfd, const vector<long long> &mids);
+// 聊天消息是否第一次收到，没有mid的消息总是显示
+bool firstReceived(const json &js);
 // 获取系统时间（聊天信息需要添加时间信息）
 string getCurrentTime();
 // 主聊天页面程序
 void mainMenu(int);
+// 显示一条群消息并记录它的序号
+void showGroupMessage(json &js);
+// 显示一条系统公告
+void showBroadcast(json &js);
 // 显示当前登录成功用户的基本信息
 void showCurrentUserData();
 
@@ -122,12 +176,14 @@ int main(int argc, char **argv)
             cout << "userpassword:";
             cin.getline(pwd, 50);
 
-            // 构造json
-            json js;
-            js["msgid"] = LOGIN_MSG;
-            js["id"] = id;
-            js["password"] = pwd;
-            string request = js.dump();
+            // 构造登录请求
+            proto::LoginReq req;
+            req.id = id;
+            req.password = pwd;
+            req.coalesce = true;     // 客户端可以解析服务器合并发送的批量帧
+            req.ack = true;          // 客户端会回复聊天消息的送达确认
+            req.proto = LOGIN_PROTO_NESTED; // 好友、群组直接以嵌套的json对象返回
+            string request = proto::encode(req);
 
             g_isLoginSuccess = false;   // 登录状态
 
@@ -157,12 +213,11 @@ int main(int argc, char **argv)
             cout << "userpassword:";
             cin.getline(pwd, 50);
 
-            // 构造json
-            json js;
-            js["msgid"] = REG_MSG;
-            js["name"] = name;
-            js["password"] = pwd;
-            string request = js.dump();
+            // 构造注册请求
+            proto::RegReq req;
+            req.name = name;
+            req.password = pwd;
+            string request = proto::encode(req);
 
             int len = send(clientfd, request.c_str(), strlen(request.c_str()) + 1, 0);
             if (len == -1)
@@ -201,6 +256,12 @@ void doRegResponse(json &responsejs)
 }
 
 // 处理登录的响应逻辑
+// 登录响应中的好友、群组、群成员：新协议中是json对象，旧服务器返回的是需要再次解析的json文本
+static json loginItem(const json &item)
+{
+    return item.is_string() ? json::parse(item.get<string>()) : item;
+}
+
 void doLoginResponse(json &responsejs)
 {
     if (0 != responsejs["errno"].get<int>()) // 登录失败
@@ -213,6 +274,7 @@ void doLoginResponse(json &responsejs)
         // 记录当前用户的id和name
         g_currentUser.setId(responsejs["id"].get<int>());   // 这个变量是跟客户端程序绑定的，所以一个程序只能登录一个用户
         g_currentUser.setName(responsejs["name"]);          // 但是如果多开客户端，就可以登录多个用户了  
+        g_deliveryAck = responsejs.value("ack", false);
 
         // 记录当前用户的好友列表信息
         if (responsejs.contains("friends"))
@@ -220,11 +282,10 @@ void doLoginResponse(json &responsejs)
             // 初始化
             g_currentUserFriendList.clear();
 
-            vector<string> vec = responsejs["friends"];     // 服务端会直接返回好友列表
-            for (string &str : vec)
+            for (const json &item : responsejs["friends"])     // 服务端会直接返回好友列表
             {
                 // 把每一个好友对应的json对象解析成User对象，插入到好友列表中
-                json js = json::parse(str);
+                json js = loginItem(item);
                 User user;
                 user.setId(js["id"].get<int>());
                 user.setName(js["name"]);
@@ -241,20 +302,18 @@ void doLoginResponse(json &responsejs)
             // 初始化
             g_currentUserGroupList.clear();
 
-            vector<string> vec1 = responsejs["groups"];
-            for (string &groupstr : vec1)
+            for (const json &groupitem : responsejs["groups"])
             {
-                json grpjs = json::parse(groupstr);
+                json grpjs = loginItem(groupitem);
                 Group group;
                 group.setId(grpjs["id"].get<int>());
                 group.setName(grpjs["groupname"]);
                 group.setDesc(grpjs["groupdesc"]);
 
-                vector<string> vec2 = grpjs["users"];
-                for (string &userstr : vec2)
+                for (const json &useritem : grpjs["users"])
                 {
                     GroupUser user;
-                    json js = json::parse(userstr);
+                    json js = loginItem(useritem);
                     user.setId(js["id"].get<int>());
                     user.setName(js["name"]);
                     user.setState(js["state"]);
@@ -276,6 +335,10 @@ void doLoginResponse(json &responsejs)
             for (string &str : vec)
             {
                 json js = json::parse(str);
+                if (!firstReceived(js))
+                {
+                    continue;
+                }
                 // time + [id] + name + " said: " + xxx
                 if (ONE_CHAT_MSG == js["msgid"].get<int>())
                 {
@@ -284,23 +347,128 @@ void doLoginResponse(json &responsejs)
                 }
                 else
                 {
-                    cout << "群消息[" << js["groupid"] << "]:" << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
-                         << " said: " << js["msg"].get<string>() << endl;
+                    showGroupMessage(js);
                 }
             }
         }
 
+        // 离线群消息超过服务器单次返回的上限，剩余的消息用groupsync分页读取
+        if (responsejs.contains("offlinemore"))
+        {
+            lock_guard<mutex> lock(g_groupSeqMutex);
+            g_groupBacklog.clear();
+            for (json &morejs : responsejs["offlinemore"])
+            {
+                int groupid = morejs["groupid"].get<int>();
+                g_groupBacklog[groupid] = morejs["seq"].get<long long>();
+                cout << "群[" << groupid << "]还有更多离线消息，请执行groupsync:" << groupid << endl;
+            }
+        }
+
         g_isLoginSuccess = true;
     }
 }
 
+// 聊天消息是否第一次收到
+bool firstReceived(const json &js)
+{
+    return !js.contains("mid") || g_recentMids.insert(js["mid"].get<long long>());
+}
+
+// 回复收到的聊天消息的送达确认，服务器据此把消息移出未确认窗口
+void sendDeliveryAck(int clientfd, const vector<long long> &mids)
+{
+    if (!g_deliveryAck || mids.empty())
+    {
+        return;
+    }
+    proto::DeliveryAckReq req;
+    req.mids.assign(mids.begin(), mids.end());
+    string buffer = proto::encode(req);
+
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send delivery ack error -> " << buffer << endl;
+    }
+}
+
+/*
+从接收到的字节流中切分出服务器发来的消息
+服务器的每条消息是一个完整的json对象，消息之间没有分隔符（也可能有'\0'），
+按括号深度找到对象的结尾，字符串中的括号和转义的引号不计入
+*/
+class FrameReader
+{
+public:
+    void append(const char *data, size_t len) { _buf.append(data, len); }
+
+    // 取出下一条完整的消息，数据不足一条时返回false，已经扫描的位置会被记住
+    bool next(string &frame)
+    {
+        for (; _pos < _buf.size(); ++_pos)
+        {
+            char c = _buf[_pos];
+            if (_depth == 0 && c != '{' && c != '[')
+            {
+                // 消息之间的'\0'和空白
+                _start = _pos + 1;
+                continue;
+            }
+            if (_inString)
+            {
+                if (_escape)
+                {
+                    _escape = false;
+                }
+                else if (c == '\\')
+                {
+                    _escape = true;
+                }
+                else if (c == '"')
+                {
+                    _inString = false;
+                }
+                continue;
+            }
+            if (c == '"')
+            {
+                _inString = true;
+            }
+            else if (c == '{' || c == '[')
+            {
+                ++_depth;
+            }
+            else if ((c == '}' || c == ']') && --_depth == 0)
+            {
+                frame.assign(_buf, _start, _pos + 1 - _start);
+                _buf.erase(0, _pos + 1);
+                _pos = 0;
+                _start = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    string _buf;
+    size_t _pos = 0;        // 下一个要扫描的字节
+    size_t _start = 0;      // 当前消息的起始位置
+    int _depth = 0;
+    bool _inString = false;
+    bool _escape = false;
+};
+
 // 子线程 - 接收线程
 void readTaskHandler(int clientfd)
 {
+    FrameReader reader;
+    string frame;
     for (;;)   // 子线程无线循环
     {
-        char buffer[2048] = {0};
-        int len = recv(clientfd, buffer, 2048, 0); // 阻塞了，等待消息到达
+        char buffer[4096];
+        int len = recv(clientfd, buffer, sizeof(buffer), 0); // 阻塞了，等待消息到达
         if (-1 == len || 0 == len)
         {
             // 0表示连接关闭，-1表示出现错误
@@ -308,39 +476,245 @@ void readTaskHandler(int clientfd)
             exit(-1);
         }
 
-        // 接收ChatServer转发的数据，反序列化生成json数据对象
-        json js = json::parse(buffer);   // 反序列化
-        int msgtype = js["msgid"].get<int>();   // 获取消息类型
-        if (ONE_CHAT_MSG == msgtype)
+        // 一次recv可能收到多条消息，也可能只收到一条消息的一部分，取出其中完整的消息逐条处理
+        reader.append(buffer, len);
+        while (reader.next(frame))
         {
-            cout << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
-                 << " said: " << js["msg"].get<string>() << endl;
-            continue;
-        }
+            // 接收ChatServer转发的数据，反序列化生成json数据对象
+            json js = json::parse(frame, nullptr, false);   // 反序列化
+            if (js.is_discarded())
+            {
+                cerr << "invalid message from server: " << frame << endl;
+                continue;
+            }
+            int msgtype = js["msgid"].get<int>();   // 获取消息类型
+            // 重复收到的聊天消息不再显示，但仍然回复确认
+            if (ONE_CHAT_MSG == msgtype)
+            {
+                if (firstReceived(js))
+                {
+                    cout << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
+                         << " said: " << js["msg"].get<string>() << endl;
+                }
+                if (js.contains("mid"))
+                {
+                    sendDeliveryAck(clientfd, {js["mid"].get<long long>()});
+                }
+                continue;
+            }
 
-        if (GROUP_CHAT_MSG == msgtype)
-        {
-            cout << "群消息[" << js["groupid"] << "]:" << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
-                 << " said: " << js["msg"].get<string>() << endl;
-            continue;
-        }
+            if (GROUP_CHAT_MSG == msgtype)
+            {
+                if (firstReceived(js))
+                {
+                    showGroupMessage(js);
+                }
+                if (js.contains("mid"))
+                {
+                    sendDeliveryAck(clientfd, {js["mid"].get<long long>()});
+                }
+                continue;
+            }
 
-        if (LOGIN_MSG_ACK == msgtype)
-        {
-            doLoginResponse(js); // 处理登录响应的业务逻辑
-            sem_post(&rwsem);    // 通知主线程，登录结果处理完成
-            continue;
-        }
+            if (BATCH_MSG == msgtype)
+            {
+                // 服务器合并发送的多条聊天消息，逐条显示，显示完一次确认整批
+                vector<long long> mids;
+                for (json &msgjs : js["msgs"])
+                {
+                    if (msgjs.contains("mid"))
+                    {
+                        mids.push_back(msgjs["mid"].get<long long>());
+                    }
+                    if (!firstReceived(msgjs))
+                    {
+                        continue;
+                    }
+                    if (ONE_CHAT_MSG == msgjs["msgid"].get<int>())
+                    {
+                        cout << msgjs["time"].get<string>() << " [" << msgjs["id"] << "]" << msgjs["name"].get<string>()
+                             << " said: " << msgjs["msg"].get<string>() << endl;
+                    }
+                    else if (BROADCAST_MSG == msgjs["msgid"].get<int>())
+                    {
+                        showBroadcast(msgjs);
+                    }
+                    else
+                    {
+                        showGroupMessage(msgjs);
+                    }
+                }
+                sendDeliveryAck(clientfd, mids);
+                continue;
+            }
 
-        if (REG_MSG_ACK == msgtype)
-        {
-            doRegResponse(js);
-            sem_post(&rwsem); // 通知主线程，注册结果处理完成
-            continue;
+            if (BROADCAST_MSG == msgtype)
+            {
+                showBroadcast(js);
+                continue;
+            }
+
+            if (BROADCAST_ACK == msgtype)
+            {
+                if (0 != js["errno"].get<int>())
+                {
+                    cerr << js["errmsg"] << endl;
+                }
+                else
+                {
+                    cout << "系统公告已发送给本服务器上的" << js["count"] << "个在线用户" << endl;
+                }
+                continue;
+            }
+
+            if (HISTORY_ACK == msgtype)
+            {
+                if (0 != js["errno"].get<int>())
+                {
+                    cerr << js["errmsg"] << endl;
+                    continue;
+                }
+                // 服务器按从新到旧返回，按时间顺序显示
+                vector<string> vec = js["msgs"];
+                for (auto it = vec.rbegin(); it != vec.rend(); ++it)
+                {
+                    json msgjs = json::parse(*it);
+                    cout << "历史消息:" << msgjs["time"].get<string>() << " [" << msgjs["id"] << "]" << msgjs["name"].get<string>()
+                         << " said: " << msgjs["msg"].get<string>() << endl;
+                }
+                string key = js.contains("groupid") ? "group:" + to_string(js["groupid"].get<int>())
+                                                    : "one:" + to_string(js["peer"].get<int>());
+                long long next = js["next"].get<long long>();
+                {
+                    lock_guard<mutex> lock(g_historyMutex);
+                    g_historyCursor[key] = next == 0 ? -1 : next;
+                }
+                cout << (next == 0 ? "没有更早的历史消息了" : "再次执行相同的history命令查看更早的消息") << endl;
+                continue;
+            }
+
+            if (CONV_LIST_ACK == msgtype)
+            {
+                if (0 != js["errno"].get<int>())
+                {
+                    cerr << js["errmsg"] << endl;
+                    continue;
+                }
+                // 按最近消息从新到旧显示会话，查看消息内容用history命令
+                cout << "共" << js["unread"] << "条未读消息" << endl;
+                for (json &convjs : js["convs"])
+                {
+                    if (convjs.contains("groupid"))
+                    {
+                        cout << "群[" << convjs["groupid"] << "]";
+                    }
+                    else
+                    {
+                        cout << "好友[" << convjs["peer"] << "]";
+                    }
+                    cout << " 未读:" << convjs["unread"] << endl;
+                }
+                continue;
+            }
+
+            if (SEARCH_ACK == msgtype)
+            {
+                if (0 != js["errno"].get<int>())
+                {
+                    cerr << js["errmsg"] << endl;
+                    continue;
+                }
+                // 按相关度从高到低显示
+                vector<string> vec = js["msgs"];
+                for (string &msg : vec)
+                {
+                    json msgjs = json::parse(msg);
+                    cout << "搜索结果:" << msgjs["time"].get<string>() << " ";
+                    if (msgjs.contains("groupid"))
+                    {
+                        cout << "群[" << msgjs["groupid"] << "]";
+                    }
+                    cout << "[" << msgjs["id"] << "]" << msgjs["name"].get<string>()
+                         << " said: " << msgjs["msg"].get<string>() << endl;
+                }
+                cout << "共找到" << vec.size() << "条包含\"" << js["query"].get<string>() << "\"的消息" << endl;
+                continue;
+            }
+
+            if (GROUP_SYNC_ACK == msgtype)
+            {
+                if (0 != js["errno"].get<int>())
+                {
+                    cerr << js["errmsg"] << endl;
+                    continue;
+                }
+                vector<string> vec = js["msgs"];
+                for (string &str : vec)
+                {
+                    json msgjs = json::parse(str);
+                    showGroupMessage(msgjs);
+                }
+                bool more = js["more"].get<bool>();
+                {
+                    // 离线消息没有收完的群组从本次读到的序号继续同步
+                    lock_guard<mutex> lock(g_groupSeqMutex);
+                    auto it = g_groupBacklog.find(js["groupid"].get<int>());
+                    if (it != g_groupBacklog.end())
+                    {
+                        if (more)
+                        {
+                            it->second = js["seq"].get<long long>();
+                        }
+                        else
+                        {
+                            g_groupBacklog.erase(it);
+                        }
+                    }
+                }
+                if (more)
+                {
+                    cout << "群[" << js["groupid"] << "]还有更多消息，请再次执行groupsync" << endl;
+                }
+                continue;
+            }
+
+            if (LOGIN_MSG_ACK == msgtype)
+            {
+                doLoginResponse(js); // 处理登录响应的业务逻辑
+                sem_post(&rwsem);    // 通知主线程，登录结果处理完成
+                continue;
+            }
+
+            if (REG_MSG_ACK == msgtype)
+            {
+                doRegResponse(js);
+                sem_post(&rwsem); // 通知主线程，注册结果处理完成
+                continue;
+            }
         }
     }
 }
 
+// 显示一条群消息并记录它的序号
+void showGroupMessage(json &js)
+{
+    cout << "群消息[" << js["groupid"] << "]:" << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
+         << " said: " << js["msg"].get<string>() << endl;
+    if (js.contains("seq"))
+    {
+        lock_guard<mutex> lock(g_groupSeqMutex);
+        long long &seq = g_groupSeq[js["groupid"].get<int>()];
+        seq = max(seq, js["seq"].get<long long>());
+    }
+}
+
+// 显示一条系统公告
+void showBroadcast(json &js)
+{
+    cout << "系统公告:" << js["time"].get<string>() << " [" << js["id"] << "]" << js["name"].get<string>()
+         << " said: " << js["msg"].get<string>() << endl;
+}
+
 // 显示当前登录成功用户的基本信息
 void showCurrentUserData()
 {
@@ -382,6 +756,16 @@ void creategroup(int, string);
 void addgroup(int, string);
 // "groupchat" command handler
 void groupchat(int, string);
+// "groupsync" command handler
+void groupsync(int, string);
+// "broadcast" command handler
+void broadcast(int, string);
+// "history" command handler
+void history(int, string);
+// "search" command handler
+void searchmsg(int, string);
+// "inbox" command handler
+void inbox(int, string);
 // "loginout" command handler
 void loginout(int, string);
 
@@ -393,6 +777,11 @@ unordered_map<string, string> commandMap = {
     {"creategroup", "创建群组，格式creategroup:groupname:groupdesc"},
     {"addgroup", "加入群组，格式addgroup:groupid"},
     {"groupchat", "群聊，格式groupchat:groupid:message"},
+    {"groupsync", "同步错过的群消息，格式groupsync:groupid"},
+    {"broadcast", "发送系统公告（需管理员权限），格式broadcast:message"},
+    {"history", "查看历史消息，每次向前翻一页，格式history:one:friendid 或 history:group:groupid"},
+    {"search", "搜索历史消息，多个关键词用空格分隔，格式search:keywords"},
+    {"inbox", "查看最近的会话和未读消息数，格式inbox"},
     {"loginout", "注销，格式loginout"}};
 
 // 注册系统支持的客户端命令处理
@@ -403,6 +792,11 @@ unordered_map<string, function<void(int, string)>> commandHandlerMap = {    // 
     {"creategroup", creategroup},
     {"addgroup", addgroup},
     {"groupchat", groupchat},
+    {"groupsync", groupsync},
+    {"broadcast", broadcast},
+    {"history", history},
+    {"search", searchmsg},
+    {"inbox", inbox},
     {"loginout", loginout}};
 
 // 主聊天页面程序
@@ -455,11 +849,10 @@ void help(int, string)
 void addfriend(int clientfd, string str)
 {
     int friendid = atoi(str.c_str());
-    json js;
-    js["msgid"] = ADD_FRIEND_MSG;
-    js["id"] = g_currentUser.getId();
-    js["friendid"] = friendid;
-    string buffer = js.dump();
+    proto::AddFriendReq req;
+    req.id = g_currentUser.getId();
+    req.friendid = friendid;
+    string buffer = proto::encode(req);
 
     int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
     if (-1 == len)
@@ -508,12 +901,11 @@ void creategroup(int clientfd, string str)
     string groupname = str.substr(0, idx);
     string groupdesc = str.substr(idx + 1, str.size() - idx);
 
-    json js;
-    js["msgid"] = CREATE_GROUP_MSG;
-    js["id"] = g_currentUser.getId();
-    js["groupname"] = groupname;
-    js["groupdesc"] = groupdesc;
-    string buffer = js.dump();
+    proto::CreateGroupReq req;
+    req.id = g_currentUser.getId();
+    req.groupname = groupname;
+    req.groupdesc = groupdesc;
+    string buffer = proto::encode(req);
 
     int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
     if (-1 == len)
@@ -525,11 +917,10 @@ void creategroup(int clientfd, string str)
 void addgroup(int clientfd, string str)
 {
     int groupid = atoi(str.c_str());
-    json js;
-    js["msgid"] = ADD_GROUP_MSG;
-    js["id"] = g_currentUser.getId();
-    js["groupid"] = groupid;
-    string buffer = js.dump();
+    proto::AddGroupReq req;
+    req.id = g_currentUser.getId();
+    req.groupid = groupid;
+    string buffer = proto::encode(req);
 
     int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
     if (-1 == len)
@@ -565,14 +956,139 @@ void groupchat(int clientfd, string str)
         cerr << "send groupchat msg error -> " << buffer << endl;
     }
 }
-// "loginout" command handler
-void loginout(int clientfd, string)
+// "groupsync" command handler   groupid
+void groupsync(int clientfd, string str)
+{
+    int groupid = atoi(str.c_str());
+    long long since = 0;
+    {
+        // 离线消息没有收完的群组从离线消息的位置继续，不能从实时收到的最大序号开始，否则会跳过中间的消息
+        lock_guard<mutex> lock(g_groupSeqMutex);
+        auto backlog = g_groupBacklog.find(groupid);
+        auto it = g_groupSeq.find(groupid);
+        if (backlog != g_groupBacklog.end())
+        {
+            since = backlog->second;
+        }
+        else if (it != g_groupSeq.end())
+        {
+            since = it->second;
+        }
+    }
+
+    proto::GroupSyncReq req;
+    req.id = g_currentUser.getId();
+    req.groupid = groupid;
+    req.since = since;
+    string buffer = proto::encode(req);
+
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send groupsync msg error -> " << buffer << endl;
+    }
+}
+// "broadcast" command handler   message
+void broadcast(int clientfd, string str)
 {
     json js;
-    js["msgid"] = LOGINOUT_MSG;
+    js["msgid"] = BROADCAST_MSG;
     js["id"] = g_currentUser.getId();
+    js["name"] = g_currentUser.getName();
+    js["msg"] = str;
+    js["time"] = getCurrentTime();
     string buffer = js.dump();
 
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send broadcast msg error -> " << buffer << endl;
+    }
+}
+// "history" command handler   one:friendid | group:groupid
+void history(int clientfd, string str)
+{
+    int idx = str.find(":");
+    if (-1 == idx)
+    {
+        cerr << "history command invalid!" << endl;
+        return;
+    }
+    string type = str.substr(0, idx);
+    int id = atoi(str.substr(idx + 1).c_str());
+    if (type != "one" && type != "group")
+    {
+        cerr << "history command invalid!" << endl;
+        return;
+    }
+
+    long long before = 0;
+    {
+        lock_guard<mutex> lock(g_historyMutex);
+        auto it = g_historyCursor.find(type + ":" + to_string(id));
+        if (it != g_historyCursor.end())
+        {
+            before = it->second;
+        }
+    }
+    if (before < 0)
+    {
+        cout << "没有更早的历史消息了" << endl;
+        return;
+    }
+
+    proto::HistoryReq req;
+    req.id = g_currentUser.getId();
+    (type == "group" ? req.groupid : req.peer) = id;
+    req.before = before;
+    string buffer = proto::encode(req);
+
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send history msg error -> " << buffer << endl;
+    }
+}
+// "search" command handler   keywords
+void searchmsg(int clientfd, string str)
+{
+    if (str.empty())
+    {
+        cerr << "search command invalid!" << endl;
+        return;
+    }
+
+    proto::SearchReq req;
+    req.id = g_currentUser.getId();
+    req.query = str;
+    string buffer = proto::encode(req);
+
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send search msg error -> " << buffer << endl;
+    }
+}
+// "inbox" command handler
+void inbox(int clientfd, string)
+{
+    proto::ConvListReq req;
+    req.id = g_currentUser.getId();
+    string buffer = proto::encode(req);
+
+    int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
+    if (-1 == len)
+    {
+        cerr << "send inbox msg error -> " << buffer << endl;
+    }
+}
+// "loginout" command handler
+void loginout(int clientfd, string)
+{
+    proto::LoginOutReq req;
+    req.id = g_currentUser.getId();
+    string buffer = proto::encode(req);
+
     int len = send(clientfd, buffer.c_str(), strlen(buffer.c_str()) + 1, 0);
     if (-1 == len)
     {
@@ -0,0 +1,210 @@
+#include "localbus.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+
+LocalBus::LocalBus() : _quit(false)
+{
+}
+
+LocalBus::~LocalBus()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cond.notify_all();
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+// 启动投递线程，配置了预写日志时先恢复群序号
+bool LocalBus::connect()
+{
+    string dir = Config::instance().getString("state_journal_dir", "");
+    if (!dir.empty())
+    {
+        size_t snapshotBytes = (size_t)Config::instance().getInt("state_snapshot_mb", 64) << 20;
+        _journal.reset(new StateJournal(dir, snapshotBytes));
+        if (!_journal->open())
+        {
+            LOG_ERROR << "open state journal " << dir << " failed, group sequences are kept in memory only";
+            _journal.reset();
+        }
+    }
+    _thread = thread(&LocalBus::dispatch, this);
+    return true;
+}
+
+// 没有订阅者的消息直接丢弃，与redis发布-订阅的行为一致
+bool LocalBus::publish(int channel, string message)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_channels.count(channel) == 0)
+        {
+            return true;
+        }
+        _queue.push_back({false, channel, std::move(message)});
+    }
+    _cond.notify_one();
+    return true;
+}
+
+bool LocalBus::publishBatch(const vector<pair<int, string>> &messages)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        for (const auto &msg : messages)
+        {
+            if (_channels.count(msg.first) != 0)
+            {
+                _queue.push_back({false, msg.first, msg.second});
+            }
+        }
+    }
+    _cond.notify_one();
+    return true;
+}
+
+bool LocalBus::subscribe(int channel)
+{
+    lock_guard<mutex> lock(_mutex);
+    _channels.insert(channel);
+    return true;
+}
+
+bool LocalBus::unsubscribe(int channel)
+{
+    lock_guard<mutex> lock(_mutex);
+    _channels.erase(channel);
+    return true;
+}
+
+bool LocalBus::subscribeNode(int nodeid)
+{
+    lock_guard<mutex> lock(_mutex);
+    _nodes.insert(nodeid);
+    return true;
+}
+
+bool LocalBus::publishNode(int nodeid, string message)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_nodes.count(nodeid) == 0)
+        {
+            return true;
+        }
+        _queue.push_back({true, nodeid, std::move(message)});
+    }
+    _cond.notify_one();
+    return true;
+}
+
+bool LocalBus::setRoute(int userid, int nodeid)
+{
+    lock_guard<mutex> lock(_mutex);
+    _routes[userid] = nodeid;
+    return true;
+}
+
+bool LocalBus::removeRoute(int userid)
+{
+    lock_guard<mutex> lock(_mutex);
+    _routes.erase(userid);
+    return true;
+}
+
+bool LocalBus::queryRoutes(const vector<int> &userids, vector<int> &nodeids)
+{
+    lock_guard<mutex> lock(_mutex);
+    nodeids.clear();
+    nodeids.reserve(userids.size());
+    for (int userid : userids)
+    {
+        auto it = _routes.find(userid);
+        nodeids.push_back(it == _routes.end() ? -1 : it->second);
+    }
+    return true;
+}
+
+// 分配的序号落盘后才返回，多个I/O线程同时分配时共用一次fdatasync
+long long LocalBus::nextSequence(int groupid, long long floor)
+{
+    if (_journal)
+    {
+        uint64_t lsn;
+        long long seq = _journal->update(StateJournal::key(StateJournal::KIND_GROUP_SEQ, groupid),
+                                         [floor](int64_t seq) { return seq < floor ? floor + 1 : seq + 1; }, lsn);
+        // 序号没有落盘时不能使用，重启后可能再次分配出去
+        if (!_journal->waitDurable(lsn))
+        {
+            return -1;
+        }
+        return seq;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    long long &seq = _sequences[groupid];
+    seq = seq < floor ? floor + 1 : seq + 1;
+    return seq;
+}
+
+long long LocalBus::currentSequence(int groupid)
+{
+    if (_journal)
+    {
+        int64_t seq = 0;
+        _journal->get(StateJournal::key(StateJournal::KIND_GROUP_SEQ, groupid), seq);
+        return seq;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    auto it = _sequences.find(groupid);
+    return it == _sequences.end() ? 0 : it->second;
+}
+
+void LocalBus::init_notify_handler(function<void(int, string)> fn)
+{
+    _notify_message_handler = fn;
+}
+
+void LocalBus::init_node_handler(function<void(int, string)> fn)
+{
+    _notify_node_handler = fn;
+}
+
+// 投递线程，每次取走队列中的全部消息，在锁外逐条上报
+void LocalBus::dispatch()
+{
+    for (;;)
+    {
+        deque<Envelope> batch;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [this]() { return _quit || !_queue.empty(); });
+            if (_quit)
+            {
+                return;
+            }
+            batch.swap(_queue);
+        }
+
+        for (Envelope &env : batch)
+        {
+            if (env.node)
+            {
+                if (_notify_node_handler)
+                {
+                    _notify_node_handler(env.channel, env.message);
+                }
+            }
+            else if (_notify_message_handler)
+            {
+                _notify_message_handler(env.channel, env.message);
+            }
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#include "messagebus.hpp"
+#include "redis.hpp"
+#include "localbus.hpp"
+#include "shmbus.hpp"
+
+// 默认逐条发布
+bool MessageBus::publishBatch(const vector<pair<int, string>> &messages)
+{
+    bool ok = true;
+    for (const auto &msg : messages)
+    {
+        ok = publish(msg.first, msg.second) && ok;
+    }
+    return ok;
+}
+
+// 根据类型名创建消息总线
+MessageBus *MessageBus::create(const string &type)
+{
+    if (type == "redis")
+    {
+        return new Redis();
+    }
+    if (type == "local")
+    {
+        return new LocalBus();
+    }
+    if (type == "shm")
+    {
+        return new ShmBus();
+    }
+    return nullptr;
+}
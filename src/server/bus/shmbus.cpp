@@ -0,0 +1,453 @@
+#include "shmbus.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <cstring>
+
+static const uint32_t SHM_MAGIC = 0x43484253;  // "CHBS"
+static const uint32_t SLOT_COUNT = 4096;       // 环形缓冲区槽位数
+static const uint32_t SLOT_DATA = 4072;        // 每个槽位可容纳的消息字节数
+static const uint32_t ROUTE_COUNT = 1 << 20;   // 路由表容量，userid需小于该值
+static const uint32_t SEQ_COUNT = 1 << 16;     // 群序号表容量
+
+// 共享内存段头部
+struct ShmBus::Header
+{
+    atomic<uint32_t> magic;     // 初始化完成后写入，其他进程据此判断可以使用
+    uint32_t slotCount;
+    pthread_mutex_t mutex;      // 进程间互斥锁，保护写入
+    pthread_cond_t cond;        // 进程间条件变量，通知有新消息
+    atomic<uint64_t> writeSeq;  // 最后一条已写入消息的序号，从1开始
+};
+
+// 环形缓冲区槽位，seq为0表示正在写入
+struct ShmBus::Slot
+{
+    atomic<uint64_t> seq;
+    int32_t node;
+    int32_t channel;
+    uint32_t len;
+    char data[SLOT_DATA];
+};
+
+// 群序号表项，groupid为0表示空闲，groupid一经写入不再改变
+struct ShmBus::SeqEntry
+{
+    atomic<int32_t> groupid;
+    atomic<int64_t> seq;
+};
+
+ShmBus::ShmBus()
+    : _fd(-1), _addr(nullptr), _size(0), _header(nullptr), _slots(nullptr), _routes(nullptr), _sequences(nullptr), _readSeq(0), _quit(false)
+{
+    _name = Config::instance().getString("shm_name", "/chatserver_bus");
+}
+
+ShmBus::~ShmBus()
+{
+    _quit = true;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+    if (_addr != nullptr)
+    {
+        munmap(_addr, _size);
+    }
+    if (_fd != -1)
+    {
+        close(_fd);
+    }
+}
+
+bool ShmBus::connect()
+{
+    if (!attach())
+    {
+        LOG_ERROR << "attach shared memory bus " << _name << " failed!";
+        return false;
+    }
+
+    // 只接收连接之后发布的消息
+    _readSeq = _header->writeSeq.load(memory_order_acquire);
+    _thread = thread(&ShmBus::observer, this);
+    LOG_INFO << "attach shared memory bus " << _name << " success!";
+    return true;
+}
+
+// 第一个进程负责创建并初始化共享内存段，其他进程等待初始化完成后直接映射
+bool ShmBus::attach()
+{
+    _size = sizeof(Header) + sizeof(Slot) * SLOT_COUNT + sizeof(atomic<int32_t>) * ROUTE_COUNT + sizeof(SeqEntry) * SEQ_COUNT;
+
+    bool creator = true;
+    _fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (_fd == -1 && errno == EEXIST)
+    {
+        creator = false;
+        _fd = shm_open(_name.c_str(), O_RDWR, 0666);
+    }
+    if (_fd == -1)
+    {
+        return false;
+    }
+
+    if (creator)
+    {
+        if (ftruncate(_fd, _size) == -1)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // 等待创建者设置好共享内存段的大小
+        struct stat st;
+        for (int i = 0; i < 100; ++i)
+        {
+            if (fstat(_fd, &st) == 0 && (size_t)st.st_size >= _size)
+            {
+                break;
+            }
+            usleep(10000);
+        }
+        if (fstat(_fd, &st) != 0 || (size_t)st.st_size < _size)
+        {
+            return false;
+        }
+    }
+
+    _addr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_addr == MAP_FAILED)
+    {
+        _addr = nullptr;
+        return false;
+    }
+    _header = static_cast<Header *>(_addr);
+    _slots = reinterpret_cast<Slot *>(static_cast<char *>(_addr) + sizeof(Header));
+    _routes = reinterpret_cast<atomic<int32_t> *>(_slots + SLOT_COUNT);
+    _sequences = reinterpret_cast<SeqEntry *>(_routes + ROUTE_COUNT);
+
+    if (creator)
+    {
+        pthread_mutexattr_t mattr;
+        pthread_mutexattr_init(&mattr);
+        pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&_header->mutex, &mattr);
+        pthread_mutexattr_destroy(&mattr);
+
+        pthread_condattr_t cattr;
+        pthread_condattr_init(&cattr);
+        pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+        pthread_cond_init(&_header->cond, &cattr);
+        pthread_condattr_destroy(&cattr);
+
+        _header->slotCount = SLOT_COUNT;
+        _header->writeSeq.store(0, memory_order_relaxed);
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i)
+        {
+            _slots[i].seq.store(0, memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < ROUTE_COUNT; ++i)
+        {
+            _routes[i].store(0, memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < SEQ_COUNT; ++i)
+        {
+            _sequences[i].groupid.store(0, memory_order_relaxed);
+            _sequences[i].seq.store(0, memory_order_relaxed);
+        }
+        _header->magic.store(SHM_MAGIC, memory_order_release);
+        return true;
+    }
+
+    // 等待创建者完成初始化
+    for (int i = 0; i < 100; ++i)
+    {
+        if (_header->magic.load(memory_order_acquire) == SHM_MAGIC)
+        {
+            return _header->slotCount == SLOT_COUNT;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+void ShmBus::lockShared()
+{
+    if (pthread_mutex_lock(&_header->mutex) == EOWNERDEAD)
+    {
+        // 持锁的进程崩溃了，槽位最多只写了一半，序号仍为0，读取方会跳过它
+        pthread_mutex_consistent(&_header->mutex);
+    }
+}
+
+void ShmBus::unlockShared()
+{
+    pthread_mutex_unlock(&_header->mutex);
+}
+
+// 写入下一个槽位，调用方需持有进程间互斥锁
+bool ShmBus::append(bool node, int channel, const string &message)
+{
+    if (message.size() > SLOT_DATA)
+    {
+        LOG_ERROR << "shm bus message too large: " << message.size() << " bytes";
+        return false;
+    }
+
+    uint64_t seq = _header->writeSeq.load(memory_order_relaxed) + 1;
+    Slot &slot = _slots[seq % SLOT_COUNT];
+    slot.seq.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.node = node ? 1 : 0;
+    slot.channel = channel;
+    slot.len = message.size();
+    memcpy(slot.data, message.data(), message.size());
+    slot.seq.store(seq, memory_order_release);
+    _header->writeSeq.store(seq, memory_order_release);
+    return true;
+}
+
+bool ShmBus::publish(int channel, string message)
+{
+    lockShared();
+    bool ok = append(false, channel, message);
+    unlockShared();
+    pthread_cond_broadcast(&_header->cond);
+    return ok;
+}
+
+// 一次加锁写入全部消息，只唤醒一次读取方
+bool ShmBus::publishBatch(const vector<pair<int, string>> &messages)
+{
+    bool ok = true;
+    lockShared();
+    for (const auto &msg : messages)
+    {
+        ok = append(false, msg.first, msg.second) && ok;
+    }
+    unlockShared();
+    pthread_cond_broadcast(&_header->cond);
+    return ok;
+}
+
+bool ShmBus::subscribe(int channel)
+{
+    lock_guard<mutex> lock(_mutex);
+    _channels.insert(channel);
+    return true;
+}
+
+bool ShmBus::unsubscribe(int channel)
+{
+    lock_guard<mutex> lock(_mutex);
+    _channels.erase(channel);
+    return true;
+}
+
+bool ShmBus::subscribeNode(int nodeid)
+{
+    lock_guard<mutex> lock(_mutex);
+    _nodes.insert(nodeid);
+    return true;
+}
+
+bool ShmBus::publishNode(int nodeid, string message)
+{
+    lockShared();
+    bool ok = append(true, nodeid, message);
+    unlockShared();
+    pthread_cond_broadcast(&_header->cond);
+    return ok;
+}
+
+bool ShmBus::setRoute(int userid, int nodeid)
+{
+    if (userid < 0 || (uint32_t)userid >= ROUTE_COUNT)
+    {
+        LOG_ERROR << "shm bus route table overflow, userid: " << userid;
+        return false;
+    }
+    _routes[userid].store(nodeid + 1, memory_order_release);
+    return true;
+}
+
+bool ShmBus::removeRoute(int userid)
+{
+    if (userid < 0 || (uint32_t)userid >= ROUTE_COUNT)
+    {
+        return false;
+    }
+    _routes[userid].store(0, memory_order_release);
+    return true;
+}
+
+bool ShmBus::queryRoutes(const vector<int> &userids, vector<int> &nodeids)
+{
+    nodeids.clear();
+    nodeids.reserve(userids.size());
+    for (int userid : userids)
+    {
+        if (userid < 0 || (uint32_t)userid >= ROUTE_COUNT)
+        {
+            nodeids.push_back(-1);
+            continue;
+        }
+        nodeids.push_back(_routes[userid].load(memory_order_acquire) - 1);
+    }
+    return true;
+}
+
+// 开放寻址查找groupid的表项，没有则用CAS占用一个空闲表项
+long long ShmBus::nextSequence(int groupid, long long floor)
+{
+    uint32_t start = (uint32_t)groupid * 2654435761u % SEQ_COUNT;
+    for (uint32_t i = 0; i < SEQ_COUNT; ++i)
+    {
+        SeqEntry &entry = _sequences[(start + i) % SEQ_COUNT];
+        int32_t id = entry.groupid.load(memory_order_acquire);
+        if (id == 0)
+        {
+            int32_t expected = 0;
+            if (!entry.groupid.compare_exchange_strong(expected, groupid, memory_order_acq_rel))
+            {
+                id = expected;
+            }
+            else
+            {
+                id = groupid;
+            }
+        }
+        if (id != groupid)
+        {
+            continue;
+        }
+
+        int64_t seq = entry.seq.load(memory_order_relaxed);
+        for (;;)
+        {
+            int64_t next = seq < floor ? floor + 1 : seq + 1;
+            if (entry.seq.compare_exchange_weak(seq, next, memory_order_acq_rel))
+            {
+                return next;
+            }
+        }
+    }
+    LOG_ERROR << "shm bus sequence table is full";
+    return -1;
+}
+
+long long ShmBus::currentSequence(int groupid)
+{
+    uint32_t start = (uint32_t)groupid * 2654435761u % SEQ_COUNT;
+    for (uint32_t i = 0; i < SEQ_COUNT; ++i)
+    {
+        SeqEntry &entry = _sequences[(start + i) % SEQ_COUNT];
+        int32_t id = entry.groupid.load(memory_order_acquire);
+        if (id == 0)
+        {
+            return 0;
+        }
+        if (id == groupid)
+        {
+            return entry.seq.load(memory_order_acquire);
+        }
+    }
+    return 0;
+}
+
+void ShmBus::init_notify_handler(function<void(int, string)> fn)
+{
+    _notify_message_handler = fn;
+}
+
+void ShmBus::init_node_handler(function<void(int, string)> fn)
+{
+    _notify_node_handler = fn;
+}
+
+// 观察线程，等待新消息，逐条读取槽位并上报本进程订阅的通道
+void ShmBus::observer()
+{
+    while (!_quit)
+    {
+        lockShared();
+        while (!_quit && _header->writeSeq.load(memory_order_acquire) == _readSeq)
+        {
+            // 定时醒来检查退出标志
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000 * 1000;
+            if (ts.tv_nsec >= 1000000000)
+            {
+                ts.tv_sec += 1;
+                ts.tv_nsec -= 1000000000;
+            }
+            if (pthread_cond_timedwait(&_header->cond, &_header->mutex, &ts) == EOWNERDEAD)
+            {
+                pthread_mutex_consistent(&_header->mutex);
+            }
+        }
+        unlockShared();
+
+        uint64_t writeSeq = _header->writeSeq.load(memory_order_acquire);
+        if (writeSeq - _readSeq > SLOT_COUNT)
+        {
+            LOG_ERROR << "shm bus reader overrun, lost " << writeSeq - SLOT_COUNT - _readSeq << " messages";
+            _readSeq = writeSeq - SLOT_COUNT;
+        }
+
+        string message;
+        while (_readSeq < writeSeq)
+        {
+            uint64_t next = _readSeq + 1;
+            Slot &slot = _slots[next % SLOT_COUNT];
+            _readSeq = next;
+
+            uint64_t before = slot.seq.load(memory_order_acquire);
+            if (before != next)
+            {
+                // 槽位已被下一圈覆盖或正在写入
+                continue;
+            }
+            bool node = slot.node != 0;
+            int channel = slot.channel;
+            message.assign(slot.data, slot.len < SLOT_DATA ? slot.len : SLOT_DATA);
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.seq.load(memory_order_relaxed) != before)
+            {
+                continue;
+            }
+
+            bool subscribed;
+            {
+                lock_guard<mutex> lock(_mutex);
+                subscribed = node ? _nodes.count(channel) != 0 : _channels.count(channel) != 0;
+            }
+            if (!subscribed)
+            {
+                continue;
+            }
+
+            if (node)
+            {
+                if (_notify_node_handler)
+                {
+                    _notify_node_handler(channel, message);
+                }
+            }
+            else if (_notify_message_handler)
+            {
+                _notify_message_handler(channel, message);
+            }
+        }
+    }
+}
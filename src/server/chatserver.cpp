@@ -1,12 +1,17 @@
 // #include "../../include/server/chatserver.hpp"
 #include "chatserver.hpp"
-#include "json.hpp"
 #include "chatservice.hpp"
+#include "loopdispatcher.hpp"
+#include "outboundbatch.hpp"
+#include <muduo/base/Logging.h>
 #include <functional>
 #include <string>
+#include <cstring>
 using namespace std;
 using namespace placeholders;
-using json = nlohmann::json;
+
+// 一条消息的最大长度，超过时认为客户端没有按'\0'分隔消息，断开连接
+static const size_t MAX_MESSAGE_BYTES = 1024 * 1024;
 
 ChatServer::ChatServer(EventLoop *loop,
                        const InetAddress &listenAddr,
@@ -18,6 +23,12 @@ ChatServer::ChatServer(EventLoop *loop,
     // 注册独写回调
     _server.setMessageCallback(std::bind(&ChatServer::onMessage, this, _1, _2, _3));
 
+    // I/O线程启动时注册到LoopDispatcher，其他线程通过它把消息交给连接所属的I/O线程发送
+    LoopDispatcher::instance()->registerLoop(loop);
+    _server.setThreadInitCallback([](EventLoop *ioLoop) {
+        LoopDispatcher::instance()->registerLoop(ioLoop);
+    });
+
     // 设置线程数量
     _server.setThreadNum(4);
 }
@@ -40,16 +51,56 @@ void ChatServer::onMessage(const TcpConnectionPtr &conn,
                            Buffer *buffer,
                            Timestamp time)
 {
-    string buf = buffer->retrieveAllAsString();
-    // 数据的反序列化
-    json js = json::parse(buf); 
+    // 处理期间发往其他I/O线程的消息按目标线程攒批，处理结束后每个目标线程只唤醒一次
+    OutboundBatch::Scope batch;
+
+    // 客户端的每条消息以'\0'结尾，一次读到的数据可能包含多条消息，也可能只有一条消息的前一部分，
+    // 依次处理完整的消息，不完整的部分留在缓冲区中等待后续数据
+    const char *end;
+    while ((end = static_cast<const char *>(memchr(buffer->peek(), '\0', buffer->readableBytes()))) != nullptr)
+    {
+        string buf = buffer->retrieveAsString(end - buffer->peek());
+        buffer->retrieve(1);
+        if (!buf.empty())
+        {
+            onFrame(conn, buf, time);
+        }
+    }
+
+    if (buffer->readableBytes() > MAX_MESSAGE_BYTES)
+    {
+        LOG_ERROR << "message from " << conn->peerAddress().toIpPort() << " exceeds " << MAX_MESSAGE_BYTES
+                  << " bytes, close connection";
+        buffer->retrieveAll();
+        conn->forceClose();
+    }
+}
+
+// 处理一条完整的消息
+void ChatServer::onFrame(const TcpConnectionPtr &conn, const string &buf, Timestamp time)
+{
+    // 数据的反序列化：快速解析只记录各个值在原文中的位置，不构建json对象，
+    // 由各消息注册的解码函数一遍读出需要的字段
+    // 不是合法的json或嵌套过深的消息记录日志后丢弃，不影响连接上的其他消息
+    static thread_local JsonTape tape;
+    if (!tape.parse(buf))
+    {
+        LOG_ERROR << "can not parse message: " << buf;
+        return;
+    }
+    int msgid;
+    if (!tape.root()["msgid"].get(msgid))
+    {
+        LOG_ERROR << "message without msgid: " << buf;
+        return;
+    }
 
     // 希望达到的目的：完全解耦网络模块的代码和业务模块的代码
-    // 通过js["msgid"] 获取-》业务handler （利用回调的思想），派发conn，js，time
+    // 通过msgid 获取-》业务handler （利用回调的思想），派发conn，msg，time
     // 在oop语言里要解耦模块之间的关系，一般有两种方法
     // 1. 使用基于面向接口的编程（c++里没有接口，或者说就是抽象类）
     // 2. 基于回调操作
-    auto msgHandler = ChatService::instance()->getHandler(js["msgid"].get<int>());
+    auto msgHandler = ChatService::instance()->getHandler(msgid);
     // 回调消息绑定好的事件处理器，来执行相应的业务处理
-    msgHandler(conn, js, time);
+    msgHandler(conn, tape.root(), time);
 }
\ No newline at end of file
@@ -1,12 +1,163 @@
 #include "chatservice.hpp"
 #include "public.hpp"
+#include "config.hpp"
+#include "outboundbatch.hpp"
+#include "coalescer.hpp"
+#include "ackwindow.hpp"
+#include "idgenerator.hpp"
 #include <muduo/base/Logging.h>
 #include <string>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <climits>
 using namespace muduo;
 using namespace std;
 
+// 登录时最多返回的离线群消息条数
+static const int MAX_OFFLINE_GROUP_MSG = 1000;
+
+// 一次群消息同步最多返回的消息条数
+static const int MAX_SYNC_GROUP_MSG = 200;
+
+// 历史消息默认的每页条数
+static const int DEFAULT_HISTORY_PAGE = 20;
+
+// 历史消息搜索默认返回的条数
+static const int DEFAULT_SEARCH_LIMIT = 20;
+
+// 会话列表默认返回的会话数
+static const int DEFAULT_CONV_LIST = 50;
+
+// 响应中的成员名片段，编译期生成
+static constexpr JsonKey KEY_MSGID("msgid");
+static constexpr JsonKey KEY_ERRNO("errno");
+static constexpr JsonKey KEY_ERRMSG("errmsg");
+static constexpr JsonKey KEY_ID("id");
+static constexpr JsonKey KEY_NAME("name");
+static constexpr JsonKey KEY_STATE("state");
+static constexpr JsonKey KEY_ROLE("role");
+static constexpr JsonKey KEY_GROUPNAME("groupname");
+static constexpr JsonKey KEY_GROUPDESC("groupdesc");
+static constexpr JsonKey KEY_USERS("users");
+static constexpr JsonKey KEY_COALESCE("coalesce");
+static constexpr JsonKey KEY_ACK("ack");
+static constexpr JsonKey KEY_OFFLINEMSG("offlinemsg");
+static constexpr JsonKey KEY_FRIENDS("friends");
+static constexpr JsonKey KEY_GROUPS("groups");
+static constexpr JsonKey KEY_GROUPID("groupid");
+static constexpr JsonKey KEY_PEER("peer");
+static constexpr JsonKey KEY_FROM("from");
+static constexpr JsonKey KEY_SEQ("seq");
+static constexpr JsonKey KEY_MORE("more");
+static constexpr JsonKey KEY_MSGS("msgs");
+static constexpr JsonKey KEY_NEXT("next");
+static constexpr JsonKey KEY_COUNT("count");
+static constexpr JsonKey KEY_BROADCAST("broadcast");
+static constexpr JsonKey KEY_NODE("node");
+static constexpr JsonKey KEY_QUERY("query");
+static constexpr JsonKey KEY_MIDS("mids");
+static constexpr JsonKey KEY_UNREAD("unread");
+static constexpr JsonKey KEY_LASTMID("lastmid");
+static constexpr JsonKey KEY_CONVS("convs");
+static constexpr JsonKey KEY_PROTO("proto");
+static constexpr JsonKey KEY_OFFLINEMORE("offlinemore");
+
+// 发送只有错误码和错误信息的响应 {"msgid":msgid,"errno":err,"errmsg":errmsg}
+static void sendError(const TcpConnectionPtr &conn, int msgid, int err, const char *errmsg)
+{
+    string &out = JsonWriter::buffer();
+    JsonWriter(out).beginObject().field(KEY_MSGID, msgid).field(KEY_ERRNO, err).field(KEY_ERRMSG, errmsg).endObject();
+    conn->send(out);
+}
+
+// 节点信封中的整数字段，缺失或不是整数时返回def；json::value在类型不符时会抛出异常
+static long long envelopeField(const json &header, const char *key, long long def)
+{
+    auto it = header.find(key);
+    return it != header.end() && it->is_number_integer() ? it->get<long long>() : def;
+}
+
+// 登录响应中的好友 {"id","name","state"}
+static void writeFriend(JsonWriter &writer, User &user)
+{
+    writer.beginObject()
+        .field(KEY_ID, user.getId())
+        .field(KEY_NAME, user.getName())
+        .field(KEY_STATE, user.getState())
+        .endObject();
+}
+
+// 登录响应中的群成员 {"id","name","state","role"}
+static void writeGroupUser(JsonWriter &writer, GroupUser &user)
+{
+    writer.beginObject()
+        .field(KEY_ID, user.getId())
+        .field(KEY_NAME, user.getName())
+        .field(KEY_STATE, user.getState())
+        .field(KEY_ROLE, user.getRole())
+        .endObject();
+}
+
+// 登录响应中的群组 {"id","groupname","groupdesc","users"}
+// nested为false时按旧协议把每个群成员写成json文本，item在各成员之间复用
+static void writeGroup(JsonWriter &writer, Group &group, bool nested, string &item)
+{
+    writer.beginObject()
+        .field(KEY_ID, group.getId())
+        .field(KEY_GROUPNAME, group.getName())
+        .field(KEY_GROUPDESC, group.getDesc())
+        .key(KEY_USERS).beginArray();
+    for (GroupUser &groupuser : group.getUsers())
+    {
+        if (nested)
+        {
+            writeGroupUser(writer, groupuser);
+        }
+        else
+        {
+            item.clear();
+            JsonWriter member(item);
+            writeGroupUser(member, groupuser);
+            writer.value(item);
+        }
+    }
+    writer.endArray().endObject();
+}
+
+// 在客户端发来的聊天消息前插入服务器分配的字段，消息的其余部分原样保留，不再重新序列化
+// fields形如 "mid":1,"seq":2 ；客户端自己带了同名字段时（正常客户端不会）退回json对象覆盖，避免出现重复的成员
+static string stampMessage(const JsonTape::Value &msg, int64_t mid, long long seq)
+{
+    if (msg["mid"].valid() || (seq > 0 && msg["seq"].valid()))
+    {
+        json js = json::parse(msg.raw());
+        js["mid"] = mid;
+        if (seq > 0)
+        {
+            js["seq"] = seq;
+        }
+        return js.dump();
+    }
+
+    string_view raw = msg.raw();
+    string out;
+    out.reserve(raw.size() + 48);
+    out += "{\"mid\":";
+    out += to_string(mid);
+    if (seq > 0)
+    {
+        out += ",\"seq\":";
+        out += to_string(seq);
+    }
+    if (msg.size() > 0)
+    {
+        out += ',';
+    }
+    out.append(raw.data() + 1, raw.size() - 1);
+    return out;
+}
+
 // 获取单例对象的接口函数
 ChatService *ChatService::instance()
 {
@@ -17,34 +168,95 @@ ChatService *ChatService::instance()
 
 // 注册消息以及对应的handler回调操作
 ChatService::ChatService()
+    : _nodeId(Config::instance().getInt("node_id", 0)), _fanout(_sessions), _sequencer(_bus, _timelineModel),
+      _broadcastLimiter(Config::instance().getInt("broadcast_rate", 1), Config::instance().getInt("broadcast_burst", 3))
 {
-    // 用户基本业务管理相关事件处理回调注册
-    _msgHandlerMap.insert({LOGIN_MSG, std::bind(&ChatService::login, this, _1, _2, _3)});
-    _msgHandlerMap.insert({LOGINOUT_MSG, std::bind(&ChatService::loginOut, this, _1, _2, _3)});
-    _msgHandlerMap.insert({REG_MSG, std::bind(&ChatService::reg, this, _1, _2, _3)});
-    _msgHandlerMap.insert({ONE_CHAT_MSG, std::bind(&ChatService::oneChat, this, _1, _2, _3)});
-    _msgHandlerMap.insert({ADD_FRIEND_MSG, std::bind(&ChatService::addFriend, this, _1, _2, _3)});
+    // 用户基本业务管理相关事件处理回调注册，消息id由消息结构决定
+    registerHandler(&ChatService::login);
+    registerHandler(&ChatService::loginOut);
+    registerHandler(&ChatService::reg);
+    registerHandler(&ChatService::oneChat);
+    registerHandler(&ChatService::addFriend);
+    registerHandler(&ChatService::deliveryAck);
 
     // 群组业务管理相关事件回调注册
-    _msgHandlerMap.insert({CREATE_GROUP_MSG, std::bind(&ChatService::createGroup, this, _1, _2, _3)});
-    _msgHandlerMap.insert({ADD_GROUP_MSG, std::bind(&ChatService::addGroup, this, _1, _2, _3)});
-    _msgHandlerMap.insert({GROUP_CHAT_MSG, std::bind(&ChatService::groupChat, this, _1, _2, _3)});
+    registerHandler(&ChatService::createGroup);
+    registerHandler(&ChatService::addGroup);
+    registerHandler(&ChatService::groupChat);
+    registerHandler(&ChatService::groupSync);
+    registerHandler(&ChatService::history);
+    registerHandler(&ChatService::search);
+    registerHandler(&ChatService::conversations);
 
-    // 连接redis服务器
-    if (_redis.connect())
+    // 系统公告业务回调注册，管理员列表形如 "1,2,3"
+    registerHandler(&ChatService::broadcast);
+    string admins = Config::instance().getString("broadcast_admins", "");
+    for (size_t pos = 0; pos < admins.size();)
     {
-        // 设置上报消息的回调
-        _redis.init_notify_handler(std::bind(&ChatService::handleRedisSubscribeMessage, this, _1, _2));
+        size_t end = admins.find(',', pos);
+        if (end == string::npos)
+        {
+            end = admins.size();
+        }
+        int id = atoi(admins.substr(pos, end - pos).c_str());
+        if (id > 0)
+        {
+            _broadcastAdmins.insert(id);
+        }
+        pos = end + 1;
+    }
+
+    // 其他线程投递给I/O线程的消息，在I/O线程中发送
+    LoopDispatcher::instance()->setDeliverCallback(std::bind(&ChatService::deliver, this, _1));
+    // 合并发送暂存的消息因连接断开无法写出时，转存离线消息
+    Coalescer::setDropCallback(std::bind(&ChatService::storeOfflineAsync, this, _1, _2));
+
+    // 创建并连接消息总线，默认使用redis
+    string busType = Config::instance().getString("bus", "redis");
+    _bus.reset(MessageBus::create(busType));
+    if (!_bus)
+    {
+        LOG_ERROR << "unknown message bus type: " << busType << ", use redis";
+        _bus.reset(MessageBus::create("redis"));
+    }
+    // 设置上报消息的回调，需在连接之前设置，连接后观察线程就开始上报消息
+    _bus->init_notify_handler(std::bind(&ChatService::handleRedisSubscribeMessage, this, _1, _2));
+    _bus->init_node_handler(std::bind(&ChatService::handleNodeMessage, this, _1, _2));
+    if (_bus->connect())
+    {
+        // 订阅本节点的节点通道，接收按节点合并的群消息；订阅广播通道，接收系统公告
+        _bus->subscribeNode(_nodeId);
+        _bus->subscribeNode(MessageBus::ALL_NODES);
     }
-    
 }
 
 void ChatService::reset()
 {
+    // 删除本节点在线用户的路由
+    for (int userid : _sessions.userids())
+    {
+        _bus->removeRoute(userid);
+    }
+
     // 把online状态的用户设置为offline
     _userModel.resetState();
 }
 
+// 注册消息结构Req的处理器
+template <typename Req>
+void ChatService::registerHandler(void (ChatService::*handler)(const TcpConnectionPtr &, const Req &, Timestamp))
+{
+    _msgHandlerMap.insert({Req::MSGID, [this, handler](const TcpConnectionPtr &conn, const JsonTape::Value &msg, Timestamp time) {
+        Req req;
+        if (!proto::decode(msg, req))
+        {
+            LOG_ERROR << "msgid: " << Req::MSGID << " invalid message";
+            return;
+        }
+        (this->*handler)(conn, req, time);
+    }});
+}
+
 // 获取消息对应的处理器
 MsgHandler ChatService::getHandler(int msgid)
 {
@@ -53,7 +265,7 @@ MsgHandler ChatService::getHandler(int msgid)
     if (it == _msgHandlerMap.end())
     {
         // 返回一个默认的处理器，空操作
-        return [=](const TcpConnectionPtr &conn, json &js, Timestamp time) { // 这些参数是为了匹配返回值的MsgHandler类型
+        return [=](const TcpConnectionPtr &conn, const JsonTape::Value &msg, Timestamp time) { // 这些参数是为了匹配返回值的MsgHandler类型
             LOG_ERROR << "msgid: " << msgid << " can not find handler!";
         };
         // 这样设计即使没有对应的处理器，程序也不会挂掉，还是能正常进行
@@ -66,11 +278,11 @@ MsgHandler ChatService::getHandler(int msgid)
 }
 
 // 处理登录业务 id pwd
-void ChatService::login(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::login(const TcpConnectionPtr &conn, const proto::LoginReq &req, Timestamp time)
 {
     LOG_INFO << "do login service !";
-    int id = js["id"];
-    string pwd = js["password"];
+    int id = req.id;
+    const string &pwd = req.password;
 
     User user = _userModel.query(id); // 通过id值查找得到对应的User对象
     if (user.getId() != -1)
@@ -82,130 +294,182 @@ void ChatService::login(const TcpConnectionPtr &conn, json &js, Timestamp time)
             if (user.getState() == "online")
             {
                 // 用户已登录
-                json response;
-                response["msgid"] = LOGIN_MSG_ACK;
-                response["errno"] = 3;
-                response["errmsg"] = "用户已登录，请勿重复登录";
-                conn->send(response.dump());
+                sendError(conn, LOGIN_MSG_ACK, 3, "用户已登录，请勿重复登录");
             }
             else
             {
-                // 登录成功，记录用户连接信息
+                // 登录成功，记录用户连接信息和所在的群组
+                // 群组需在记录路由之前记录，之后发往本节点的群消息才能按成员位图找到该用户
+                vector<Group> groupVec = _groupModel.queryGroups(id);
+                vector<int> groupids;
+                for (Group &group : groupVec)
+                {
+                    groupids.push_back(group.getId());
+                }
+                _sessions.add(id, conn);
+                _sessions.setGroups(id, groupids);
+
+                // 客户端可以解析批量帧时，合并发往该连接的聊天消息
+                bool coalesce = req.coalesce && Coalescer::available();
+                if (coalesce)
                 {
-                    lock_guard<mutex> lock(_connMutex);
-                    _userConnMap.insert({id, conn});
-                } // 出这个作用域之后锁就释放了
+                    Coalescer::enable(conn);
+                }
+                // 客户端会回复送达确认时，记录写出后尚未确认的聊天消息
+                bool ack = req.ack && AckWindow::available();
+                if (ack)
+                {
+                    AckWindow::enable(conn);
+                }
 
-                // id用户登录成功后，向redis订阅channel（id）
-                _redis.subscribe(id);
+                // id用户登录成功后，向redis订阅channel（id），并记录用户所在的节点
+                _bus->subscribe(id);
+                _bus->setRoute(id, _nodeId);
 
                 // 登录成功，更新用户状态信息
                 user.setState("online");
                 _userModel.updateState(user);
 
-                json response;
-                response["msgid"] = LOGIN_MSG_ACK;
-                response["errno"] = 0;
-                response["id"] = user.getId();
-                response["name"] = user.getName();
+                string &out = JsonWriter::buffer();
+                JsonWriter response(out);
+                response.beginObject()
+                    .field(KEY_MSGID, LOGIN_MSG_ACK)
+                    .field(KEY_ERRNO, 0)
+                    .field(KEY_ID, user.getId())
+                    .field(KEY_NAME, user.getName())
+                    .field(KEY_COALESCE, coalesce)
+                    .field(KEY_ACK, ack);
+
+                // 用户登录之后，读取并删除该用户的离线消息
+                vector<string> vec = _offlineMsgModel.take(id);
+
+                // 离线期间的群消息从群时间线中按游标读取，读取后推进游标
+                map<int, long long> unfinished;
+                vector<GroupMessage> groupMsgs = _timelineModel.queryUnread(id, MAX_OFFLINE_GROUP_MSG, unfinished);
+                if (!groupMsgs.empty())
+                {
+                    map<int, long long> cursors;
+                    for (GroupMessage &msg : groupMsgs)
+                    {
+                        vec.push_back(msg.msg);
+                        cursors[msg.groupid] = msg.seq;
+                    }
+                    _dbWorker.post([this, id, cursors]() {
+                        for (auto &cursor : cursors)
+                        {
+                            _timelineModel.setCursor(id, cursor.first, cursor.second);
+                        }
+                    });
+                }
 
-                // 用户登录之后，查询该用户是否有离线消息
-                vector<string> vec = _offlineMsgModel.query(id);
                 if (!vec.empty())
                 {
-                    response["offlinemsg"] = vec;
-                    // 读取后删除
-                    _offlineMsgModel.remove(id);
+                    response.field(KEY_OFFLINEMSG, vec);
+                }
+
+                // 达到上限或遇到还没有写入的序号而没有读完的群组在offlinemore中列出序号，由客户端用群消息同步分页读取
+                // 这些群组读完之前，下线时不推进游标，没有读到的消息下次上线仍能收到
+                if (!unfinished.empty())
+                {
+                    unordered_set<int> backlog;
+                    response.key(KEY_OFFLINEMORE).beginArray();
+                    for (auto &cursor : unfinished)
+                    {
+                        response.beginObject().field(KEY_GROUPID, cursor.first).field(KEY_SEQ, cursor.second).endObject();
+                        backlog.insert(cursor.first);
+                    }
+                    response.endArray();
+                    lock_guard<mutex> lock(_backlogMutex);
+                    _groupBacklog[id] = std::move(backlog);
+                }
+
+                // 客户端声明支持时，好友、群组和群成员写成嵌套的对象，并在响应中回复协议版本
+                // 否则按旧协议作为json文本放在字符串数组中，item和members在各元素之间复用
+                bool nested = req.proto >= LOGIN_PROTO_NESTED;
+                if (nested)
+                {
+                    response.field(KEY_PROTO, (int)LOGIN_PROTO_NESTED);
                 }
+                string item;
+                string members;
 
                 // 查询该用户的好友信息并返回
                 vector<User> userVec = _friendModel.query(id);
                 if (!userVec.empty())
                 {
-                    vector<string> vec2;
+                    response.key(KEY_FRIENDS).beginArray();
                     for (User &user : userVec)
                     {
-                        json js;
-                        js["id"] = user.getId();
-                        js["name"] = user.getName();
-                        js["state"] = user.getState();
-                        vec2.push_back(js.dump());
+                        if (nested)
+                        {
+                            writeFriend(response, user);
+                        }
+                        else
+                        {
+                            item.clear();
+                            JsonWriter js(item);
+                            writeFriend(js, user);
+                            response.value(item);
+                        }
                     }
-                    response["friends"] = vec2;
+                    response.endArray();
                 }
 
                 // 查询该用户的群组信息并返回
-                vector<Group> groupVec = _groupModel.queryGroups(id);
                 if (!groupVec.empty())
                 {
-                    vector<string> vec3;
+                    response.key(KEY_GROUPS).beginArray();
                     for (Group &group : groupVec)
                     {
-                        json js;
-                        js["id"] = group.getId();
-                        js["groupname"] = group.getName();
-                        js["groupdesc"] = group.getDesc();
-                        vector<GroupUser> vec4 = group.getUsers();
-                        vector<string> vec5;
-                        for (GroupUser &groupuser : vec4)
+                        if (nested)
                         {
-                            json gujs;
-                            gujs["id"] = groupuser.getId();
-                            gujs["name"] = groupuser.getName();
-                            gujs["state"] = groupuser.getState();
-                            gujs["role"] = groupuser.getRole();
-                            vec5.push_back(gujs.dump());
+                            writeGroup(response, group, true, members);
+                        }
+                        else
+                        {
+                            item.clear();
+                            JsonWriter js(item);
+                            writeGroup(js, group, false, members);
+                            response.value(item);
                         }
-                        js["users"] = vec5;
-                        vec3.push_back(js.dump());
                     }
-                    response["groups"] = vec3;
+                    response.endArray();
                 }
 
-                conn->send(response.dump());
+                response.endObject();
+                conn->send(out);
             }
         }
         else
         {
             // 密码错误
-            json response;
-            response["msgid"] = LOGIN_MSG_ACK;
-            response["errno"] = 2;
-            response["errmsg"] = "密码错误";
-            conn->send(response.dump());
+            sendError(conn, LOGIN_MSG_ACK, 2, "密码错误");
         }
     }
     else
     {
         // 用户不存在
-        json response;
-        response["msgid"] = LOGIN_MSG_ACK;
-        response["errno"] = 1;
-        response["errmsg"] = "该用户不存在";
-        conn->send(response.dump());
+        sendError(conn, LOGIN_MSG_ACK, 1, "该用户不存在");
     }
 }
 
 // 处理注销业务
-void ChatService::loginOut(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::loginOut(const TcpConnectionPtr &conn, const proto::LoginOutReq &req, Timestamp time)
 {
-    int userid = js["id"].get<int>(); // 只需要一个id
+    int userid = req.id; // 只需要一个id
 
-    {
-        lock_guard<mutex> lock(_connMutex); // 因为要对_userConnMap进行操作，所以要注意线程安全
-        auto it = _userConnMap.begin();
-        while (it != _userConnMap.end())
-        {
-            if (it->first == userid)
-            {
-                _userConnMap.erase(it); // 删除对应的连接
-                break;
-            }
-        }
-    }
+    // 在线期间的群消息已经实时收到，群时间线游标推进到最新，离线消息没有读完的群组除外
+    // 需在删除连接之前推进，之后追加的群消息宁可上线时重复收到，也不会丢失
+    _timelineModel.advanceCursors(userid, takeGroupBacklog(userid));
+
+    // 删除对应的连接，连接可能继续使用，先发出暂存的消息，再转存仍未确认的消息
+    Coalescer::disable(conn);
+    spillUnacked(conn, userid);
+    _sessions.remove(userid);
 
     // 用户注销，相当于就是下线，在redis中取消订阅通道
-    _redis.unsubscribe(userid);
+    _bus->unsubscribe(userid);
+    _bus->removeRoute(userid);
 
     User user;
     user.setId(userid);
@@ -214,10 +478,10 @@ void ChatService::loginOut(const TcpConnectionPtr &conn, json &js, Timestamp tim
 }
 
 // 处理注册业务     name  password
-void ChatService::reg(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::reg(const TcpConnectionPtr &conn, const proto::RegReq &req, Timestamp time)
 {
-    string name = js["name"];
-    string pwd = js["password"];
+    const string &name = req.name;
+    const string &pwd = req.password;
 
     User user;
     user.setName(name);
@@ -226,67 +490,75 @@ void ChatService::reg(const TcpConnectionPtr &conn, json &js, Timestamp time)
     if (state)
     {
         // 注册成功
-        json response;
-        response["msgid"] = REG_MSG_ACK;
-        response["errno"] = 0; // 表示响应成功，若为1则需要加errmsg说明错误消息
-        response["id"] = user.getId();
-        conn->send(response.dump());
+        string &out = JsonWriter::buffer();
+        JsonWriter(out).beginObject()
+            .field(KEY_MSGID, REG_MSG_ACK)
+            .field(KEY_ERRNO, 0) // 表示响应成功，若为1则需要加errmsg说明错误消息
+            .field(KEY_ID, user.getId())
+            .endObject();
+        conn->send(out);
     }
     else
     {
         // 注册失败
-        json response;
-        response["msgid"] = REG_MSG_ACK;
-        response["errno"] = 1; // 表示响应失败
-        response["id"] = user.getId();
-        conn->send(response.dump());
+        string &out = JsonWriter::buffer();
+        JsonWriter(out).beginObject()
+            .field(KEY_MSGID, REG_MSG_ACK)
+            .field(KEY_ERRNO, 1) // 表示响应失败
+            .field(KEY_ID, user.getId())
+            .endObject();
+        conn->send(out);
     }
 }
 
 // 处理客户端异常退出
 void ChatService::clientCloseException(const TcpConnectionPtr &conn)
 {
-    User user;
+    // 群时间线游标推进到最新，需在删除连接之前推进，原因同loginOut
+    int userid = _sessions.find(conn);
+    if (userid != -1)
     {
-        lock_guard<mutex> lock(_connMutex); // 因为要对_userConnMap进行操作，所以要注意线程安全
-        for (auto it = _userConnMap.begin(); it != _userConnMap.end(); it++)
-        {
-            // 查表，因为没有id，所以不能直接访问，只能遍历哈希表
-            if (it->second == conn)
-            {
-                // 从map表删除用户的连接信息
-                user.setId(it->first);
-                _userConnMap.erase(it);
-                break;
-            }
-        }
+        _timelineModel.advanceCursors(userid, takeGroupBacklog(userid));
     }
 
+    // 未确认的消息先转存，暂存的消息随后由合并发送的回调转存，离线消息保持原来的顺序
+    spillUnacked(conn, userid);
+
+    // 从连接表删除用户的连接信息，连接表维护了连接到userid的反向索引，不需要遍历
+    Coalescer::disable(conn);
+    User user;
+    user.setId(_sessions.remove(conn));
+
     // 用户注销，相当于就是下线，在redis中取消订阅通道
-    _redis.unsubscribe(user.getId());
+    _bus->unsubscribe(user.getId());
 
     // 更新用户的状态信息
     if (user.getId() != -1)
     {
+        _bus->removeRoute(user.getId());
         user.setState("offline");
         _userModel.updateState(user);
     }
 }
 
 // 一对一聊天业务
-void ChatService::oneChat(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::oneChat(const TcpConnectionPtr &conn, const proto::OneChatMsg &req, Timestamp time)
 {
-    int toid = js["to"].get<int>();
-    bool userState = false;
+    // 只解码路由需要的字段，不构建json对象
+    int userid = req.id;
+    int toid = req.to;
+
+    // 分配消息id，插入到原始消息中转发，异步写入历史消息
+    int64_t mid = IdGenerator::instance()->next();
+    string msg = stampMessage(req.body, mid, 0);
+    storeHistoryAsync({mid, HistoryModel::oneChatConv(userid, toid), userid, msg});
+
+    TcpConnectionPtr toConn = _sessions.find(toid);
+    if (toConn)   // 说明目标用户在同样的服务器上登录了，那就可以直接转发消息
     {
-        lock_guard<mutex> lock(_connMutex);
-        auto it = _userConnMap.find(toid);
-        if (it != _userConnMap.end())   // 说明目标用户在同样的服务器上登录了，那就可以直接转发消息
-        {
-            // toid 在线，转发消息  服务器主动推送消息给toid用户
-            it->second->send(js.dump());
-            return;
-        }
+        // toid 在线，转发消息  服务器主动推送消息给toid用户
+        OutboundBatch::send(toConn, toid, make_shared<const string>(std::move(msg)));
+        return;
     }
 
     // 若目标用户未在该服务器上登录，则有两种情况
@@ -297,30 +569,32 @@ void ChatService::oneChat(const TcpConnectionPtr &conn, json &js, Timestamp time
     User user = _userModel.query(toid);
     if (user.getState() == "online")
     {
-        // toid用户在其他服务器上登录
-        _redis.publish(toid, js.dump());
-        return;
+        // toid用户在其他服务器上登录；发布失败（如消息超过总线的长度上限）时转存离线消息
+        if (_bus->publish(toid, msg))
+        {
+            return;
+        }
+        LOG_ERROR << "publish message to user " << toid << " failed, store it offline";
     }
 
     // toid 不在线，存储离线消息
-    _offlineMsgModel.insert(toid, js.dump());
+    if (!_offlineMsgModel.insert(toid, msg))
+    {
+        LOG_ERROR << "store offline message for user " << toid << " failed";
+    }
 }
 
 // 添加好友业务  msgid  id  friendid
-void ChatService::addFriend(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::addFriend(const TcpConnectionPtr &conn, const proto::AddFriendReq &req, Timestamp time)
 {
-    int userid = js["id"].get<int>();
-    int friendid = js["friendid"].get<int>();
+    int userid = req.id;
+    int friendid = req.friendid;
 
     // 判断friendid是否存在
     User user = _userModel.query(friendid);
     if (user.getId() == -1)
     {
-        json response;
-        response["msgid"] = ADD_FRIEND_ACK;
-        response["errno"] = 1; // 表示friendid不存在
-        response["errmsg"] = "friendid 不存在";
-        conn->send(response.dump());
+        sendError(conn, ADD_FRIEND_ACK, 1, "friendid 不存在"); // 表示friendid不存在
         return;
     }
     // 判断是否已经是好友
@@ -336,26 +610,21 @@ void ChatService::addFriend(const TcpConnectionPtr &conn, json &js, Timestamp ti
     if (it != vec.end())
     {
         // 好友已存在
-        json response;
-        response["msgid"] = ADD_FRIEND_ACK;
-        response["errno"] = 2; // 已经是好友了
-        response["errmsg"] = "你们已经是好友";
-        conn->send(response.dump());
+        sendError(conn, ADD_FRIEND_ACK, 2, "你们已经是好友"); // 已经是好友了
         return;
     }
     _friendModel.insert(userid, friendid);
-    json response;
-    response["msgid"] = ADD_FRIEND_ACK;
-    response["errno"] = 0; // 成功添加好友
-    conn->send(response.dump());
+    string &out = JsonWriter::buffer();
+    JsonWriter(out).beginObject().field(KEY_MSGID, ADD_FRIEND_ACK).field(KEY_ERRNO, 0).endObject(); // 成功添加好友
+    conn->send(out);
 }
 
 // 创建群组业务
-void ChatService::createGroup(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::createGroup(const TcpConnectionPtr &conn, const proto::CreateGroupReq &req, Timestamp time)
 {
-    int userid = js["id"].get<int>();
-    string name = js["groupname"];
-    string desc = js["groupdesc"];
+    int userid = req.id;
+    const string &name = req.groupname;
+    const string &desc = req.groupdesc;
 
     // 存储新创建的群组信息
     Group group(-1, name, desc);
@@ -363,63 +632,573 @@ void ChatService::createGroup(const TcpConnectionPtr &conn, json &js, Timestamp
     {
         // 存储群组创建人信息
         _groupModel.addGroup(userid, group.getId(), "creator");
+        _timelineModel.initCursor(userid, group.getId());
+        _sessions.joinGroup(userid, group.getId());
     }
 }
 
 // 加入群组业务
-void ChatService::addGroup(const TcpConnectionPtr &conn, json &js, Timestamp time)
+void ChatService::addGroup(const TcpConnectionPtr &conn, const proto::AddGroupReq &req, Timestamp time)
 {
-    int userid = js["id"].get<int>();
-    int groupid = js["groupid"].get<int>();
+    int userid = req.id;
+    int groupid = req.groupid;
     _groupModel.addGroup(userid, groupid, "normal");
+    // 新成员从入群之后的消息开始读取
+    _timelineModel.initCursor(userid, groupid);
+    _sessions.joinGroup(userid, groupid);
 }
 
 // 群组聊天业务
-void ChatService::groupChat(const TcpConnectionPtr &conn, json &js, Timestamp time)
+// 本节点上的成员按连接所属的I/O线程划分，由各I/O线程并行发送；
+// 其他节点上的在线成员按节点合并，每个节点只发布一次群消息信封
+void ChatService::groupChat(const TcpConnectionPtr &conn, const proto::GroupChatMsg &req, Timestamp time)
 {
     LOG_INFO << "do groupchat service !";
-    int userid = js["id"].get<int>();
-    int groupid = js["groupid"].get<int>();
+    // 只解码路由需要的字段，不构建json对象
+    int userid = req.id;
+    int groupid = req.groupid;
     vector<int> useridVec = _groupModel.queryGroupUsers(userid, groupid);
-    lock_guard<mutex> lock(_connMutex);
+
+    // 由服务器分配群内单调递增的序号，成员据此同步错过的消息
+    long long seq = _sequencer.next(groupid);
+    // 分配消息id，插入到原始消息中，群消息只生成一次，所有成员共享，历史消息中也只存一份
+    int64_t mid = IdGenerator::instance()->next();
+    auto payload = make_shared<const string>(stampMessage(req.body, mid, seq));
+    storeHistoryAsync({mid, HistoryModel::groupConv(groupid), userid, *payload});
+    if (seq > 0)
+    {
+        _sequencer.record(groupid, seq, payload);
+    }
+
+    // 本节点在线的成员由群组成员位图和在线位图求交集得到，其余成员按路由发往其他节点或存为离线
+    vector<int> remote;
+    vector<int> local = _fanout.fanoutGroup(groupid, userid, payload, remote);
     for (int id : useridVec)
     {
-        LOG_INFO << "transfer message";
-        auto it = _userConnMap.find(id);
-        if (it != _userConnMap.end())
+        if (!binary_search(local.begin(), local.end(), id))
         {
-            // 转发群消息
-            it->second->send(js.dump());
+            remote.push_back(id);
         }
-        else
+    }
+
+    bool hasOffline = false;
+    map<int, vector<int>> nodeUsers;
+    vector<int> nodeids;
+    if (!remote.empty() && !_bus->queryRoutes(remote, nodeids))
+    {
+        // 路由表不可用，退化为逐个成员查询状态并发布
+        for (int id : remote)
         {
             User user = _userModel.query(id);
-            if (user.getState() == "online")
+            // 发布失败的成员按离线处理，上线或同步时从群时间线读取
+            if (user.getState() != "online" || !_bus->publish(id, *payload))
+            {
+                hasOffline = true;
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < remote.size(); ++i)
+        {
+            // 没有路由的成员不在线；路由指向本节点却不在本节点的成员刚刚下线
+            if (nodeids[i] == -1 || nodeids[i] == _nodeId)
             {
-                _redis.publish(id, js.dump());
+                hasOffline = true;
             }
             else
             {
-                // 存储离线群消息
-                _offlineMsgModel.insert(id, js.dump());
+                nodeUsers[nodeids[i]].push_back(remote[i]);
             }
         }
     }
+
+    // 每个目标节点发布一次，目标节点用自己的成员位图找到接收者，信封不需要携带成员列表
+    // 信封格式：头部json + '\n' + 原始群消息，原始消息不需要再次转义；各节点的信封相同，只生成一次
+    if (!nodeUsers.empty())
+    {
+        string &envelope = JsonWriter::buffer();
+        JsonWriter(envelope).beginObject()
+            .field(KEY_GROUPID, groupid)
+            .field(KEY_FROM, userid)
+            .field(KEY_SEQ, seq)
+            .endObject();
+        envelope += '\n';
+        envelope += *payload;
+        for (auto &node : nodeUsers)
+        {
+            // 发布失败的节点上的成员收不到这条消息，按离线处理，同步时从群时间线读取
+            if (!_bus->publishNode(node.first, envelope))
+            {
+                LOG_ERROR << "publish group " << groupid << " message to node " << node.first << " failed";
+                hasOffline = true;
+            }
+        }
+    }
+
+    // 存储群消息：不再给每个离线成员各存一份，只在群时间线中追加一条，离线成员上线时按自己的游标读取
+    // 有离线成员时必须在返回前写入，保证成员上线时能读到；否则交给数据库线程写入，供同步时回退查询
+    if (seq <= 0)
+    {
+        // 总线分配序号失败，由数据库分配序号
+        _sequencer.reseed(groupid);
+        if (hasOffline)
+        {
+            _timelineModel.append(groupid, *payload);
+        }
+    }
+    else if (hasOffline)
+    {
+        _timelineModel.append(groupid, seq, *payload);
+    }
+    else
+    {
+        _dbWorker.post([this, groupid, seq, payload]() { _timelineModel.append(groupid, seq, *payload); });
+    }
 }
 
-// 从redis消息队列中获取订阅的消息
-void ChatService::handleRedisSubscribeMessage(int userid, string msg)
+// 从本节点的节点通道获取群消息信封，运行在总线的观察线程中
+void ChatService::handleNodeMessage(int nodeid, string msg)
+{
+    size_t pos = msg.find('\n');
+    // 信封头不完整时丢弃，异常不能抛到总线的观察线程中
+    json header = json::parse(msg.substr(0, pos), nullptr, false);
+    if (pos == string::npos || !header.is_object())
+    {
+        LOG_ERROR << "invalid node message: " << msg;
+        return;
+    }
+    auto payload = make_shared<const string>(msg.substr(pos + 1));
+
+    // 系统公告发给本节点所有在线用户，发出公告的节点已经发送过
+    if (header.contains("broadcast"))
+    {
+        if (envelopeField(header, "node", 0) != _nodeId)
+        {
+            _fanout.broadcast(payload);
+        }
+        return;
+    }
+
+    long long groupid = envelopeField(header, "groupid", -1);
+    long long from = envelopeField(header, "from", -1);
+    if (groupid < 0 || groupid > INT_MAX || from < 0 || from > INT_MAX)
+    {
+        LOG_ERROR << "invalid node message header from node " << nodeid << ": " << msg.substr(0, pos);
+        return;
+    }
+
+    // 缓存到本节点的最近群消息中，供本节点的成员按序号同步
+    long long seq = envelopeField(header, "seq", 0);
+    if (seq > 0)
+    {
+        _sequencer.record(groupid, seq, payload);
+    }
+
+    // 接收者由本节点的群组成员位图和在线位图求交集得到，不需要查询数据库
+    vector<int> missed;
+    _fanout.fanoutGroup(groupid, from, payload, missed);
+    for (int id : missed)
+    {
+        // 发布之后用户已经下线，转存离线消息
+        storeOfflineAsync(id, *payload);
+    }
+}
+
+// 群消息同步业务  id groupid since
+// 返回序号大于since的群消息，优先从内存中的最近消息缓存读取，缓存覆盖不到时读取群时间线
+void ChatService::groupSync(const TcpConnectionPtr &conn, const proto::GroupSyncReq &req, Timestamp time)
+{
+    // 以连接登录的用户为准，不信任消息中的id，否则可以推进其他用户的游标
+    int userid = _sessions.find(conn);
+    if (userid == -1)
+    {
+        sendError(conn, GROUP_SYNC_ACK, 2, "用户未登录");
+        return;
+    }
+    int groupid = req.groupid;
+    long long since = req.since;
+
+    string &out = JsonWriter::buffer();
+    JsonWriter response(out);
+    response.beginObject().field(KEY_MSGID, GROUP_SYNC_ACK).field(KEY_GROUPID, groupid);
+    if (!_sessions.inGroup(userid, groupid))
+    {
+        response.field(KEY_ERRNO, 1).field(KEY_ERRMSG, "不是该群的成员").endObject();
+        conn->send(out);
+        return;
+    }
+
+    // 消息直接写入响应，不复制到中间的数组中
+    size_t count = 0;
+    long long lastSeq = since;
+    bool gapped = false;
+    vector<shared_ptr<const string>> cached;
+    response.key(KEY_MSGS).beginArray();
+    if (_sequencer.since(groupid, since, MAX_SYNC_GROUP_MSG, cached, lastSeq))
+    {
+        for (auto &msg : cached)
+        {
+            response.value(*msg);
+        }
+        count = cached.size();
+    }
+    else
+    {
+        // 只读到序号连续的位置，异步追加还没有写入的消息留到下次同步，游标不越过它们
+        vector<GroupMessage> msgs = _timelineModel.query(groupid, since, MAX_SYNC_GROUP_MSG, gapped);
+        for (GroupMessage &msg : msgs)
+        {
+            response.value(msg.msg);
+            lastSeq = msg.seq;
+        }
+        count = msgs.size();
+    }
+    response.endArray();
+
+    if (lastSeq > since)
+    {
+        _dbWorker.post([this, userid, groupid, lastSeq]() { _timelineModel.setCursor(userid, groupid, lastSeq); });
+    }
+    if (count < (size_t)MAX_SYNC_GROUP_MSG && !gapped)
+    {
+        // 群组的离线消息已经读完，下线时可以推进游标
+        lock_guard<mutex> lock(_backlogMutex);
+        auto it = _groupBacklog.find(userid);
+        if (it != _groupBacklog.end())
+        {
+            it->second.erase(groupid);
+        }
+    }
+
+    response.field(KEY_ERRNO, 0)
+        .field(KEY_SEQ, lastSeq)
+        .field(KEY_MORE, count >= (size_t)MAX_SYNC_GROUP_MSG)
+        .endObject();
+    conn->send(out);
+}
+
+// 系统公告业务  id msg
+// 公告只序列化一次，本节点按I/O线程并行发送，其他节点通过总线的广播通道各收到一次
+void ChatService::broadcast(const TcpConnectionPtr &conn, const proto::BroadcastMsg &req, Timestamp time)
+{
+    // 权限按连接登录的用户检查；公告原样转发，消息中的id必须就是发送者，接收者看到的发送者才是真实的
+    int userid = _sessions.find(conn);
+
+    if (userid == -1 || req.id != userid || _broadcastAdmins.count(userid) == 0)
+    {
+        sendError(conn, BROADCAST_ACK, 1, "没有发送系统公告的权限");
+        return;
+    }
+    if (!_broadcastLimiter.tryAcquire())
+    {
+        sendError(conn, BROADCAST_ACK, 2, "系统公告发送过于频繁，请稍后再试");
+        return;
+    }
+
+    // 公告原样转发
+    auto payload = make_shared<const string>(req.body.raw());
+    size_t count = _fanout.broadcast(payload);
+
+    // 信封头部记录发出的节点，本节点收到自己发出的公告时忽略
+    string &envelope = JsonWriter::buffer();
+    JsonWriter(envelope).beginObject()
+        .field(KEY_BROADCAST, true)
+        .field(KEY_NODE, _nodeId)
+        .field(KEY_FROM, userid)
+        .endObject();
+    envelope += '\n';
+    envelope += *payload;
+    if (!_bus->publishNode(MessageBus::ALL_NODES, envelope))
+    {
+        LOG_ERROR << "publish broadcast from user " << userid << " to other nodes failed";
+    }
+
+    string &out = JsonWriter::buffer();
+    JsonWriter(out).beginObject()
+        .field(KEY_MSGID, BROADCAST_ACK)
+        .field(KEY_ERRNO, 0)
+        .field(KEY_COUNT, count)
+        .endObject();
+    conn->send(out);
+}
+
+// 历史消息查询业务  id peer|groupid before limit
+// 按消息id游标分页，每页条数有上限，一次查询只扫描一页
+void ChatService::history(const TcpConnectionPtr &conn, const proto::HistoryReq &req, Timestamp time)
+{
+    // 以连接登录的用户为准，不信任消息中的id，否则可以读取其他用户的会话
+    int userid = _sessions.find(conn);
+    if (userid == -1)
+    {
+        sendError(conn, HISTORY_ACK, 2, "用户未登录");
+        return;
+    }
+
+    string &out = JsonWriter::buffer();
+    JsonWriter response(out);
+    response.beginObject().field(KEY_MSGID, HISTORY_ACK);
+    int64_t convid;
+    if (req.groupid != 0)
+    {
+        int groupid = req.groupid;
+        response.field(KEY_GROUPID, groupid);
+        if (!_sessions.inGroup(userid, groupid))
+        {
+            response.field(KEY_ERRNO, 1).field(KEY_ERRMSG, "不是该群的成员").endObject();
+            conn->send(out);
+            return;
+        }
+        convid = HistoryModel::groupConv(groupid);
+    }
+    else
+    {
+        int peer = req.peer;
+        response.field(KEY_PEER, peer);
+        convid = HistoryModel::oneChatConv(userid, peer);
+    }
+
+    int64_t before = req.before;
+    int pageMax = Config::instance().getInt("history_page_max", 50);
+    int limit = min(max(req.limit != 0 ? req.limit : DEFAULT_HISTORY_PAGE, 1), pageMax);
+
+    int64_t next = 0;
+    vector<HistoryMessage> page = _historyModel.query(convid, before, limit);
+    if (before == 0)
+    {
+        // 读取第一页即打开了会话，未读数清零，由数据库线程在已排队的未读数更新之后执行
+        _dbWorker.post([this, userid, convid]() { _conversationModel.markRead(userid, convid); });
+    }
+    response.key(KEY_MSGS).beginArray();
+    for (HistoryMessage &msg : page)
+    {
+        response.value(msg.msg);
+    }
+    response.endArray();
+    if ((int)page.size() == limit)
+    {
+        // 可能还有更早的消息，下一页从本页最早的消息之前开始
+        next = page.back().id;
+    }
+
+    response.field(KEY_ERRNO, 0).field(KEY_NEXT, next).endObject();
+    conn->send(out);
+}
+
+// 历史消息搜索业务  id query limit
+// 在内存索引中查找，只返回用户参与的一对一会话和所在群组中的消息，再按id从history表读取消息内容
+void ChatService::search(const TcpConnectionPtr &conn, const proto::SearchReq &req, Timestamp time)
+{
+    // 以连接登录的用户为准，不信任消息中的id，否则可以搜索其他用户的会话
+    int userid = _sessions.find(conn);
+    if (userid == -1)
+    {
+        sendError(conn, SEARCH_ACK, 2, "用户未登录");
+        return;
+    }
+    const string &query = req.query;
+    int limitMax = Config::instance().getInt("search_limit_max", 50);
+    int limit = min(max(req.limit != 0 ? req.limit : DEFAULT_SEARCH_LIMIT, 1), limitMax);
+
+    vector<InvertedIndex::Hit> hits = _search.search(userid, _sessions.groups(userid), query, limit);
+    vector<pair<int64_t, int64_t>> keys;
+    for (auto &hit : hits)
+    {
+        keys.push_back({hit.convid, hit.mid});
+    }
+
+    // 按相关度排列的消息id和内容
+    vector<HistoryMessage> found = _historyModel.query(keys);
+    string &out = JsonWriter::buffer();
+    JsonWriter response(out);
+    response.beginObject().field(KEY_MSGID, SEARCH_ACK).field(KEY_ERRNO, 0).field(KEY_QUERY, query);
+    response.key(KEY_MIDS).beginArray();
+    for (HistoryMessage &msg : found)
+    {
+        response.value(msg.id);
+    }
+    response.endArray().key(KEY_MSGS).beginArray();
+    for (HistoryMessage &msg : found)
+    {
+        response.value(msg.msg);
+    }
+    response.endArray().endObject();
+    conn->send(out);
+}
+
+// 聊天消息送达确认业务 mids
+// 运行在连接所属的I/O线程中，只更新该线程的确认窗口
+void ChatService::deliveryAck(const TcpConnectionPtr &conn, const proto::DeliveryAckReq &req, Timestamp time)
 {
-    lock_guard<mutex> lock(_connMutex);
-    auto it = _userConnMap.find(userid);
-    if (it != _userConnMap.end())
+    for (int64_t mid : req.mids)
     {
-        it->second->send(msg);
+        AckWindow::ack(conn, mid);
+    }
+}
+
+// 会话列表查询业务  id limit
+// 只返回会话号、未读数和最近消息id，不包含消息内容，客户端需要时再按会话读取历史消息
+void ChatService::conversations(const TcpConnectionPtr &conn, const proto::ConvListReq &req, Timestamp time)
+{
+    // 以连接登录的用户为准，不信任消息中的id，否则可以读取其他用户的会话列表
+    int userid = _sessions.find(conn);
+    if (userid == -1)
+    {
+        sendError(conn, CONV_LIST_ACK, 2, "用户未登录");
         return;
     }
+    int limitMax = Config::instance().getInt("conv_list_max", 200);
+    int limit = min(max(req.limit != 0 ? req.limit : DEFAULT_CONV_LIST, 1), limitMax);
 
+    string &out = JsonWriter::buffer();
+    JsonWriter response(out);
+    response.beginObject().field(KEY_MSGID, CONV_LIST_ACK).field(KEY_ERRNO, 0).key(KEY_CONVS).beginArray();
+    int total = 0;
+    for (Conversation &conv : _conversationModel.query(userid, limit))
+    {
+        response.beginObject();
+        if (conv.convid < 0)
+        {
+            response.field(KEY_GROUPID, -conv.convid);
+        }
+        else
+        {
+            int low = static_cast<int>(conv.convid >> 32);
+            int high = static_cast<int>(conv.convid & 0xFFFFFFFF);
+            response.field(KEY_PEER, low == userid ? high : low);
+        }
+        response.field(KEY_UNREAD, conv.unread).field(KEY_LASTMID, conv.lastmid).endObject();
+        total += conv.unread;
+    }
+    response.endArray().field(KEY_UNREAD, total).endObject();
+    conn->send(out);
+}
+
+// 从消息总线中获取订阅的消息，运行在总线的观察线程中
+// 只在分片锁内查找连接，发送交给连接所属的I/O线程，离线存储交给数据库线程，观察线程不会被阻塞
+void ChatService::handleRedisSubscribeMessage(int userid, string msg)
+{
+    TcpConnectionPtr conn = _sessions.find(userid);
+    if (conn)
+    {
+        LoopDispatcher::instance()->post(conn->getLoop(), {userid, conn, make_shared<const string>(std::move(msg))});
+        return;
+    }
 
     // 存储该用户的离线信息
-    _offlineMsgModel.insert(userid, msg);
+    storeOfflineAsync(userid, std::move(msg));
+}
+
+// 在连接所属的I/O线程中发送一条投递的消息
+void ChatService::deliver(Delivery &delivery)
+{
+    TcpConnectionPtr conn = delivery.conn.lock();
+    if (conn && conn->connected())
+    {
+        Coalescer::send(conn, delivery.userid, delivery.payload);
+        return;
+    }
+
+    // 投递途中连接已断开，转存离线消息
+    storeOfflineAsync(delivery.userid, *delivery.payload);
+}
+
+// 异步存储离线消息，只有第一条待写入的消息会投递任务，之后的消息由同一个任务一起写入
+void ChatService::storeOfflineAsync(int userid, string msg)
+{
+    bool first;
+    {
+        lock_guard<mutex> lock(_offlineMutex);
+        first = _pendingOffline.empty();
+        _pendingOffline.emplace_back(userid, std::move(msg));
+    }
 
-}
\ No newline at end of file
+    if (first)
+    {
+        _dbWorker.post([this]() {
+            vector<pair<int, string>> msgs;
+            {
+                lock_guard<mutex> lock(_offlineMutex);
+                msgs.swap(_pendingOffline);
+            }
+            if (!_offlineMsgModel.insert(msgs))
+            {
+                LOG_ERROR << "store " << msgs.size() << " offline messages failed";
+            }
+        });
+    }
+}
+
+// 把确认窗口中未确认的消息一次转存为离线消息
+void ChatService::spillUnacked(const TcpConnectionPtr &conn, int userid)
+{
+    vector<shared_ptr<const string>> unacked = AckWindow::close(conn);
+    if (unacked.empty() || userid == -1)
+    {
+        return;
+    }
+
+    bool first;
+    {
+        lock_guard<mutex> lock(_offlineMutex);
+        first = _pendingOffline.empty();
+        for (auto &msg : unacked)
+        {
+            _pendingOffline.emplace_back(userid, *msg);
+        }
+    }
+    LOG_INFO << "user " << userid << " disconnected with " << unacked.size() << " unacked messages, stored offline";
+
+    if (first)
+    {
+        _dbWorker.post([this]() {
+            vector<pair<int, string>> msgs;
+            {
+                lock_guard<mutex> lock(_offlineMutex);
+                msgs.swap(_pendingOffline);
+            }
+            if (!_offlineMsgModel.insert(msgs))
+            {
+                LOG_ERROR << "store " << msgs.size() << " offline messages failed";
+            }
+        });
+    }
+}
+
+// 异步存储历史消息，由数据库线程合并写入
+void ChatService::storeHistoryAsync(HistoryMessage msg)
+{
+    bool first;
+    {
+        lock_guard<mutex> lock(_historyMutex);
+        first = _pendingHistory.empty();
+        _pendingHistory.push_back(std::move(msg));
+    }
+
+    if (first)
+    {
+        _dbWorker.post([this]() {
+            vector<HistoryMessage> msgs;
+            {
+                lock_guard<mutex> lock(_historyMutex);
+                msgs.swap(_pendingHistory);
+            }
+            _historyModel.insert(msgs);
+            _conversationModel.apply(msgs);
+        });
+    }
+}
+
+// 取出userid用户还有离线群消息没有读完的群组
+vector<int> ChatService::takeGroupBacklog(int userid)
+{
+    vector<int> groupids;
+    lock_guard<mutex> lock(_backlogMutex);
+    auto it = _groupBacklog.find(userid);
+    if (it != _groupBacklog.end())
+    {
+        groupids.assign(it->second.begin(), it->second.end());
+        _groupBacklog.erase(it);
+    }
+    return groupids;
+}
@@ -0,0 +1,49 @@
+#include "config.hpp"
+#include <cctype>
+#include <cstdlib>
+
+Config &Config::instance()
+{
+    static Config config;
+    return config;
+}
+
+// 设置配置项（覆盖环境变量）
+void Config::set(const string &key, const string &value)
+{
+    lock_guard<mutex> lock(_mutex);
+    _values[key] = value;
+}
+
+// 读取字符串配置项
+string Config::getString(const string &key, const string &def)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto it = _values.find(key);
+        if (it != _values.end())
+        {
+            return it->second;
+        }
+    }
+
+    // 环境变量名：CHAT_ + key的大写形式
+    string env = "CHAT_";
+    for (char c : key)
+    {
+        env += toupper(c);
+    }
+    const char *value = getenv(env.c_str());
+    return value != nullptr ? string(value) : def;
+}
+
+// 读取整数配置项
+int Config::getInt(const string &key, int def)
+{
+    string value = getString(key, "");
+    if (value.empty())
+    {
+        return def;
+    }
+    return atoi(value.c_str());
+}
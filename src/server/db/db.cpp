@@ -63,3 +63,12 @@ MYSQL_RES* MySQL::query(string sql)
 MYSQL* MySQL::getConnection() {
     return _conn;
 }
+
+// 转义字符串，用于拼接到sql语句的引号中
+string MySQL::escape(const string &str)
+{
+    string result(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(_conn, &result[0], str.c_str(), str.size());
+    result.resize(len);
+    return result;
+}
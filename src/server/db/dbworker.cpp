@@ -0,0 +1,48 @@
+#include "dbworker.hpp"
+
+DbWorker::DbWorker() : _quit(false)
+{
+    _thread = thread(&DbWorker::run, this);
+}
+
+DbWorker::~DbWorker()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+}
+
+// 投递一个数据库任务
+void DbWorker::post(function<void()> task)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cond.notify_one();
+}
+
+void DbWorker::run()
+{
+    for (;;)
+    {
+        deque<function<void()>> tasks;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [this]() { return _quit || !_tasks.empty(); });
+            if (_tasks.empty())
+            {
+                return;  // _quit且任务已全部执行完
+            }
+            tasks.swap(_tasks);
+        }
+
+        for (auto &task : tasks)
+        {
+            task();
+        }
+    }
+}
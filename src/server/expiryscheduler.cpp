@@ -0,0 +1,85 @@
+#include "expiryscheduler.hpp"
+#include "offlinestore.hpp"
+#include "idgenerator.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <chrono>
+
+// 提前建立的历史消息月分区数
+static const int HISTORY_MONTHS_AHEAD = 2;
+
+static const int64_t MILLIS_PER_DAY = 24LL * 3600 * 1000;
+
+ExpiryScheduler::ExpiryScheduler()
+    : _intervalSeconds(max(Config::instance().getInt("expire_interval", 600), 1)),
+      _offlineTtlMillis(max(Config::instance().getInt("offline_ttl_days", 30), 0) * MILLIS_PER_DAY),
+      _historyTtlMillis(max(Config::instance().getInt("history_retention_days", 0), 0) * MILLIS_PER_DAY),
+      _quit(false)
+{
+    _thread = thread(&ExpiryScheduler::run, this);
+}
+
+ExpiryScheduler::~ExpiryScheduler()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+}
+
+// 后台线程
+void ExpiryScheduler::run()
+{
+    unique_lock<mutex> lock(_mutex);
+    while (!_quit)
+    {
+        lock.unlock();
+        expire();
+        lock.lock();
+        _cond.wait_for(lock, chrono::seconds(_intervalSeconds), [this]() { return _quit; });
+    }
+}
+
+// 执行一次过期清理
+void ExpiryScheduler::expire()
+{
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+    // 离线消息
+    OfflineStore *store = OfflineStore::instance();
+    unordered_map<string, int> refs;
+    int dropped = store->expire(now, _offlineTtlMillis > 0 ? now - _offlineTtlMillis : 0, refs);
+    int64_t rows = 0, bytes = 0;
+    for (const PartitionInfo &partition : store->partitions())
+    {
+        LOG_INFO << "offline partition " << partition.name << ": " << partition.rows << " messages, "
+                 << partition.bytes << " bytes";
+        rows += partition.rows;
+        bytes += partition.bytes;
+    }
+    LOG_INFO << "offline messages retained: " << rows << " messages, " << bytes << " bytes, "
+             << dropped << " partitions expired";
+
+    // 减少删除的离线消息对共享内容的引用，不再被引用的内容随之删除
+    if (!refs.empty())
+    {
+        _payloadModel.release(refs);
+        LOG_INFO << "offline payload references released: " << refs.size() << " payloads";
+    }
+
+    // 历史消息，分区上界为消息id
+    dropped = _partitionModel.rotate("history", PartitionModel::MONTHLY, &IdGenerator::fromMillis, now,
+                                     _historyTtlMillis > 0 ? now - _historyTtlMillis : 0, HISTORY_MONTHS_AHEAD);
+    rows = bytes = 0;
+    for (const PartitionInfo &partition : _partitionModel.query("history"))
+    {
+        LOG_INFO << "history partition " << partition.name << ": " << partition.rows << " messages, "
+                 << partition.bytes << " bytes";
+        rows += partition.rows;
+        bytes += partition.bytes;
+    }
+    LOG_INFO << "history messages retained: " << rows << " messages, " << bytes << " bytes, "
+             << dropped << " partitions expired";
+}
@@ -0,0 +1,142 @@
+#include "groupsequencer.hpp"
+#include "config.hpp"
+
+GroupSequencer::GroupSequencer(unique_ptr<MessageBus> &bus, GroupTimelineModel &timeline)
+    : _bus(bus), _timeline(timeline)
+{
+    _ringSize = Config::instance().getInt("group_ring_size", 512);
+    _maxGroups = Config::instance().getInt("group_ring_groups", 4096);
+    _idleSeconds = Config::instance().getInt("group_ring_idle", 600);
+}
+
+// 分配groupid群组的下一个序号
+long long GroupSequencer::next(int groupid)
+{
+    bool seeded;
+    {
+        lock_guard<mutex> lock(_mutex);
+        seeded = _seeded[groupid];
+    }
+
+    // 本进程第一次给该群分配序号时，用已持久化的最大序号作为下限
+    long long floor = seeded ? 0 : _timeline.maxSeq(groupid);
+    long long seq = _bus->nextSequence(groupid, floor);
+    if (seq > 0 && !seeded)
+    {
+        lock_guard<mutex> lock(_mutex);
+        _seeded[groupid] = true;
+    }
+    return seq;
+}
+
+void GroupSequencer::reseed(int groupid)
+{
+    lock_guard<mutex> lock(_mutex);
+    _seeded[groupid] = false;
+}
+
+// 缓存一条已分配序号的群消息
+void GroupSequencer::record(int groupid, long long seq, const shared_ptr<const string> &msg)
+{
+    time_t now = time(nullptr);
+    lock_guard<mutex> lock(_mutex);
+    auto it = _rings.find(groupid);
+    if (it == _rings.end())
+    {
+        if (_rings.size() >= _maxGroups)
+        {
+            evictIdle(now);
+            if (_rings.size() >= _maxGroups)
+            {
+                return;
+            }
+        }
+        it = _rings.emplace(groupid, Ring()).first;
+    }
+
+    Ring &ring = it->second;
+    ring.lastActive = now;
+    long long lastSeq = ring.firstSeq + (long long)ring.msgs.size() - 1;
+    if (ring.msgs.empty() || seq > lastSeq + (long long)_ringSize || seq < ring.firstSeq - (long long)_ringSize)
+    {
+        // 新的群或者与缓存的范围相距太远，重新开始缓存
+        ring.msgs.clear();
+        ring.firstSeq = seq;
+        ring.msgs.push_back(msg);
+        return;
+    }
+
+    if (seq < ring.firstSeq)
+    {
+        // 迟到的旧消息，在前面补齐空洞
+        ring.msgs.insert(ring.msgs.begin(), ring.firstSeq - seq, shared_ptr<const string>());
+        ring.firstSeq = seq;
+    }
+    else if (seq > lastSeq)
+    {
+        // 跳过的序号先留下空洞，等其他节点的消息到达后填上
+        ring.msgs.resize(ring.msgs.size() + (seq - lastSeq));
+    }
+    ring.msgs[seq - ring.firstSeq] = msg;
+
+    while (ring.msgs.size() > _ringSize)
+    {
+        ring.msgs.pop_front();
+        ++ring.firstSeq;
+    }
+}
+
+// 从缓存中取groupid群组序号大于since的消息
+bool GroupSequencer::since(int groupid, long long since, int limit, vector<shared_ptr<const string>> &msgs, long long &lastSeq)
+{
+    // 集群中该群最后分配的序号，在锁外查询
+    long long current = _bus->currentSequence(groupid);
+    if (current < 0)
+    {
+        return false;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    auto it = _rings.find(groupid);
+    if (it == _rings.end() || it->second.msgs.empty())
+    {
+        return false;
+    }
+
+    Ring &ring = it->second;
+    if (since + 1 < ring.firstSeq || ring.firstSeq + (long long)ring.msgs.size() - 1 < current)
+    {
+        // 请求的范围已经被覆盖，或者有消息没有到达本节点
+        return false;
+    }
+
+    lastSeq = since;
+    for (long long seq = since + 1; seq < ring.firstSeq + (long long)ring.msgs.size() && (int)msgs.size() < limit; ++seq)
+    {
+        const shared_ptr<const string> &msg = ring.msgs[seq - ring.firstSeq];
+        if (!msg)
+        {
+            msgs.clear();
+            return false;
+        }
+        msgs.push_back(msg);
+        lastSeq = seq;
+    }
+    return true;
+}
+
+// 淘汰长时间不活跃的群的缓存
+void GroupSequencer::evictIdle(time_t now)
+{
+    for (auto it = _rings.begin(); it != _rings.end();)
+    {
+        if (now - it->second.lastActive > _idleSeconds)
+        {
+            it = _rings.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
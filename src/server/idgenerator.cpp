@@ -0,0 +1,62 @@
+#include "idgenerator.hpp"
+#include "config.hpp"
+#include <chrono>
+#include <thread>
+
+static int64_t nowMillis()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+IdGenerator *IdGenerator::instance()
+{
+    static IdGenerator generator;
+    return &generator;
+}
+
+IdGenerator::IdGenerator()
+    : _node(Config::instance().getInt("node_id", 0) & ((1 << NODE_BITS) - 1)), _lastMillis(0), _sequence(0)
+{
+}
+
+// 生成下一个id
+int64_t IdGenerator::next()
+{
+    lock_guard<mutex> lock(_mutex);
+    int64_t millis = nowMillis();
+    if (millis < _lastMillis)
+    {
+        // 时钟回拨，沿用上一次的时间，保证id递增
+        millis = _lastMillis;
+    }
+    if (millis == _lastMillis)
+    {
+        _sequence = (_sequence + 1) & ((1 << SEQUENCE_BITS) - 1);
+        if (_sequence == 0)
+        {
+            // 本毫秒的序号用完，等到下一毫秒
+            while ((millis = nowMillis()) <= _lastMillis)
+            {
+                this_thread::yield();
+            }
+        }
+    }
+    else
+    {
+        _sequence = 0;
+    }
+    _lastMillis = millis;
+    return ((millis - EPOCH) << (NODE_BITS + SEQUENCE_BITS)) | (_node << SEQUENCE_BITS) | _sequence;
+}
+
+// 毫秒时间戳对应的最小id
+int64_t IdGenerator::fromMillis(int64_t millis)
+{
+    return (millis - EPOCH) << (NODE_BITS + SEQUENCE_BITS);
+}
+
+// id中的毫秒时间戳
+int64_t IdGenerator::toMillis(int64_t id)
+{
+    return (id >> (NODE_BITS + SEQUENCE_BITS)) + EPOCH;
+}
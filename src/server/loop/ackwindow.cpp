@@ -0,0 +1,164 @@
+#include "ackwindow.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <unordered_map>
+#include <cstdlib>
+
+namespace
+{
+// 窗口容量，启动时读取一次，向上取整为2的幂，0表示不开启
+size_t capacity()
+{
+    static size_t cap = []() {
+        int value = Config::instance().getInt("ack_window", 256);
+        size_t cap = 0;
+        if (value > 0)
+        {
+            cap = 1;
+            while (cap < static_cast<size_t>(value))
+            {
+                cap <<= 1;
+            }
+        }
+        return cap;
+    }();
+    return cap;
+}
+
+// 窗口中的一条消息，payload为空表示已经确认
+struct Entry
+{
+    int64_t mid = 0;
+    shared_ptr<const string> payload;
+};
+
+// 一个连接的确认窗口，[head, tail)是仍在跟踪的消息，下标对容量取模
+struct Window
+{
+    vector<Entry> ring;
+    size_t head = 0;
+    size_t tail = 0;
+    size_t evicted = 0;     // 窗口满时不再跟踪的消息数
+};
+
+// 每个I/O线程自己的窗口
+thread_local unordered_map<const TcpConnection *, Window> t_windows;
+
+// 从序列化好的消息中取出mid，没有时返回0
+int64_t midOf(const string &payload)
+{
+    static const string key = "\"mid\":";
+    size_t pos = payload.find(key);
+    if (pos == string::npos)
+    {
+        return 0;
+    }
+    return strtoll(payload.c_str() + pos + key.size(), nullptr, 10);
+}
+}
+
+// 服务器是否配置了确认窗口
+bool AckWindow::available()
+{
+    return capacity() > 0;
+}
+
+// 开启连接conn的送达确认
+void AckWindow::enable(const TcpConnectionPtr &conn)
+{
+    if (available())
+    {
+        t_windows[conn.get()].ring.resize(capacity());
+    }
+}
+
+// 记录写出到连接conn的一条消息
+void AckWindow::track(const TcpConnection *conn, const shared_ptr<const string> &payload)
+{
+    if (t_windows.empty())
+    {
+        return;
+    }
+    auto it = t_windows.find(conn);
+    if (it == t_windows.end())
+    {
+        return;
+    }
+    int64_t mid = midOf(*payload);
+    if (mid == 0)
+    {
+        return;
+    }
+
+    Window &window = it->second;
+    size_t mask = window.ring.size() - 1;
+    if (window.tail - window.head == window.ring.size())
+    {
+        // 窗口已满，最老的消息不再跟踪，客户端长时间不确认时只丢失送达保证，不影响发送
+        if (window.evicted++ == 0)
+        {
+            LOG_WARN << "ack window of connection " << conn->name() << " is full, stop tracking the oldest messages";
+        }
+        window.ring[window.head & mask].payload.reset();
+        ++window.head;
+    }
+    Entry &entry = window.ring[window.tail & mask];
+    entry.mid = mid;
+    entry.payload = payload;
+    ++window.tail;
+}
+
+// 确认连接conn收到了消息mid
+void AckWindow::ack(const TcpConnectionPtr &conn, int64_t mid)
+{
+    auto it = t_windows.find(conn.get());
+    if (it == t_windows.end())
+    {
+        return;
+    }
+
+    Window &window = it->second;
+    size_t mask = window.ring.size() - 1;
+    for (size_t i = window.head; i != window.tail; ++i)
+    {
+        Entry &entry = window.ring[i & mask];
+        if (entry.payload && entry.mid == mid)
+        {
+            entry.payload.reset();
+            break;
+        }
+    }
+    // 最老的消息都已确认时前移窗口
+    while (window.head != window.tail && !window.ring[window.head & mask].payload)
+    {
+        ++window.head;
+    }
+}
+
+// 关闭连接conn的送达确认，返回未确认的消息
+vector<shared_ptr<const string>> AckWindow::close(const TcpConnectionPtr &conn)
+{
+    vector<shared_ptr<const string>> unacked;
+    auto it = t_windows.find(conn.get());
+    if (it == t_windows.end())
+    {
+        return unacked;
+    }
+
+    Window &window = it->second;
+    size_t mask = window.ring.size() - 1;
+    for (size_t i = window.head; i != window.tail; ++i)
+    {
+        Entry &entry = window.ring[i & mask];
+        if (entry.payload)
+        {
+            unacked.push_back(std::move(entry.payload));
+        }
+    }
+    if (window.evicted > 0)
+    {
+        LOG_WARN << "connection " << conn->name() << " closed with " << window.evicted << " untracked messages";
+    }
+    t_windows.erase(it);
+    return unacked;
+}
@@ -0,0 +1,187 @@
+#include "coalescer.hpp"
+#include "ackwindow.hpp"
+#include "config.hpp"
+#include "public.hpp"
+#include <muduo/net/EventLoop.h>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+// 合并参数，启动时读取一次
+struct Options
+{
+    int windowMs;       // 合并窗口，0表示不合并
+    size_t maxMsgs;     // 一个批量帧最多包含的消息条数
+    size_t maxBytes;    // 一个批量帧最多包含的消息字节数
+
+    Options()
+    {
+        windowMs = Config::instance().getInt("coalesce_window_ms", 0);
+        maxMsgs = Config::instance().getInt("coalesce_max_msgs", 32);
+        maxBytes = Config::instance().getInt("coalesce_max_bytes", 1400);
+    }
+};
+
+const Options &options()
+{
+    static Options opts;
+    return opts;
+}
+
+Coalescer::DropCallback g_dropCallback;
+
+// 一个开启了合并的连接暂存的消息
+struct Pending
+{
+    weak_ptr<TcpConnection> conn;
+    int userid = -1;
+    vector<shared_ptr<const string>> msgs;
+    size_t bytes = 0;
+};
+
+// 每个I/O线程自己的合并状态
+struct ThreadState
+{
+    unordered_map<TcpConnection *, Pending> conns;  // 开启了合并的连接
+    vector<TcpConnection *> dirty;                  // 有暂存消息的连接
+    bool armed = false;                             // 合并窗口定时器是否已经启动
+};
+
+thread_local ThreadState t_state;
+
+// 把连接暂存的消息写出，只有一条时按原样发送
+void flushPending(Pending &pending)
+{
+    if (pending.msgs.empty())
+    {
+        return;
+    }
+
+    TcpConnectionPtr conn = pending.conn.lock();
+    if (conn && conn->connected())
+    {
+        for (auto &msg : pending.msgs)
+        {
+            AckWindow::track(conn.get(), msg);
+        }
+        if (pending.msgs.size() == 1)
+        {
+            conn->send(*pending.msgs[0]);
+        }
+        else
+        {
+            // 暂存的都是序列化好的json对象，直接拼接成数组，不需要再次解析和转义
+            string frame;
+            frame.reserve(pending.bytes + pending.msgs.size() + 32);
+            frame += "{\"msgid\":";
+            frame += to_string(BATCH_MSG);
+            frame += ",\"msgs\":[";
+            for (size_t i = 0; i < pending.msgs.size(); ++i)
+            {
+                if (i > 0)
+                {
+                    frame += ',';
+                }
+                frame += *pending.msgs[i];
+            }
+            frame += "]}";
+            conn->send(frame);
+        }
+    }
+    else if (g_dropCallback)
+    {
+        for (auto &msg : pending.msgs)
+        {
+            g_dropCallback(pending.userid, *msg);
+        }
+    }
+    pending.msgs.clear();
+    pending.bytes = 0;
+}
+
+// 合并窗口到期，写出当前线程所有连接暂存的消息
+void flushAll()
+{
+    t_state.armed = false;
+    for (TcpConnection *key : t_state.dirty)
+    {
+        auto it = t_state.conns.find(key);
+        if (it != t_state.conns.end())
+        {
+            flushPending(it->second);
+        }
+    }
+    t_state.dirty.clear();
+}
+}
+
+// 设置无法写出的消息的处理回调
+void Coalescer::setDropCallback(const DropCallback &cb)
+{
+    g_dropCallback = cb;
+}
+
+// 服务器是否配置了合并窗口
+bool Coalescer::available()
+{
+    return options().windowMs > 0;
+}
+
+// 开启连接conn的合并发送
+void Coalescer::enable(const TcpConnectionPtr &conn)
+{
+    if (available())
+    {
+        t_state.conns[conn.get()].conn = conn;
+    }
+}
+
+// 关闭连接conn的合并发送，已暂存的消息立即发出
+void Coalescer::disable(const TcpConnectionPtr &conn)
+{
+    auto it = t_state.conns.find(conn.get());
+    if (it != t_state.conns.end())
+    {
+        flushPending(it->second);
+        t_state.conns.erase(it);
+    }
+}
+
+// 发送一条聊天消息给userid用户的连接conn
+void Coalescer::send(const TcpConnectionPtr &conn, int userid, const shared_ptr<const string> &payload)
+{
+    auto it = t_state.conns.find(conn.get());
+    if (it == t_state.conns.end())
+    {
+        AckWindow::track(conn.get(), payload);
+        conn->send(*payload);
+        return;
+    }
+
+    const Options &opts = options();
+    Pending &pending = it->second;
+    pending.userid = userid;
+    if (!pending.msgs.empty() && pending.bytes + payload->size() > opts.maxBytes)
+    {
+        flushPending(pending);
+    }
+    if (pending.msgs.empty())
+    {
+        t_state.dirty.push_back(conn.get());
+    }
+    pending.msgs.push_back(payload);
+    pending.bytes += payload->size();
+
+    if (pending.msgs.size() >= opts.maxMsgs || pending.bytes >= opts.maxBytes)
+    {
+        flushPending(pending);
+        return;
+    }
+
+    if (!t_state.armed)
+    {
+        t_state.armed = true;
+        conn->getLoop()->runAfter(opts.windowMs / 1000.0, flushAll);
+    }
+}
@@ -0,0 +1,48 @@
+#include "fanoutengine.hpp"
+
+// 把payload发给userids中在本节点在线的用户
+vector<int> FanoutEngine::fanout(const vector<int> &userids, const shared_ptr<const string> &payload)
+{
+    LoopBatches batches;
+    vector<int> missed;
+    _sessions.partition(userids, payload, batches, missed);
+
+    for (auto &batch : batches)
+    {
+        LoopDispatcher::instance()->postBatch(batch.first, batch.second);
+    }
+    return missed;
+}
+
+// 把payload发给groupid群组中在本节点在线的成员
+vector<int> FanoutEngine::fanoutGroup(int groupid, int from, const shared_ptr<const string> &payload, vector<int> &missed)
+{
+    vector<int> userids = _sessions.onlineMembers(groupid, from);
+    if (userids.empty())
+    {
+        return userids;
+    }
+
+    LoopBatches batches;
+    _sessions.partition(userids, payload, batches, missed);
+
+    for (auto &batch : batches)
+    {
+        LoopDispatcher::instance()->postBatch(batch.first, batch.second);
+    }
+    return userids;
+}
+
+// 把payload发给本节点所有在线用户
+size_t FanoutEngine::broadcast(const shared_ptr<const string> &payload)
+{
+    LoopBatches batches;
+    size_t count = _sessions.partitionAll(payload, batches);
+
+    // 每个loop一批，I/O线程每轮最多处理一部分，剩下的下一轮再处理，不会长时间占用I/O线程
+    for (auto &batch : batches)
+    {
+        LoopDispatcher::instance()->postBatch(batch.first, batch.second);
+    }
+    return count;
+}
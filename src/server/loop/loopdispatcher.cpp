@@ -0,0 +1,97 @@
+#include "loopdispatcher.hpp"
+#include <muduo/base/Logging.h>
+
+// 每次drain最多处理的消息数，剩余的消息重新排队，避免长时间占用I/O线程
+static const int MAX_DRAIN_BATCH = 4096;
+
+LoopDispatcher *LoopDispatcher::instance()
+{
+    static LoopDispatcher dispatcher;
+    return &dispatcher;
+}
+
+// 注册事件循环
+void LoopDispatcher::registerLoop(EventLoop *loop)
+{
+    lock_guard<mutex> lock(_registerMutex);
+    if (_queues.find(loop) == _queues.end())
+    {
+        _queues.emplace(loop, unique_ptr<LoopQueue>(new LoopQueue(loop)));
+    }
+}
+
+void LoopDispatcher::setDeliverCallback(DeliverCallback cb)
+{
+    _deliver = cb;
+}
+
+// 注册只发生在服务启动阶段，之后查找不需要加锁
+LoopDispatcher::LoopQueue *LoopDispatcher::find(EventLoop *loop)
+{
+    auto it = _queues.find(loop);
+    return it == _queues.end() ? nullptr : it->second.get();
+}
+
+void LoopDispatcher::post(EventLoop *loop, Delivery delivery)
+{
+    LoopQueue *lq = find(loop);
+    if (lq == nullptr)
+    {
+        // 未注册的loop退化为普通的跨线程调用
+        LOG_ERROR << "LoopDispatcher: loop is not registered";
+        auto d = make_shared<Delivery>(std::move(delivery));
+        loop->queueInLoop([this, d]() { _deliver(*d); });
+        return;
+    }
+    lq->queue.push(std::move(delivery));
+    schedule(lq);
+}
+
+void LoopDispatcher::postBatch(EventLoop *loop, vector<Delivery> &batch)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+    LoopQueue *lq = find(loop);
+    if (lq == nullptr)
+    {
+        for (Delivery &d : batch)
+        {
+            post(loop, std::move(d));
+        }
+        return;
+    }
+    for (Delivery &d : batch)
+    {
+        lq->queue.push(std::move(d));
+    }
+    schedule(lq);
+}
+
+// 只有把scheduled从false改为true的线程负责唤醒loop
+void LoopDispatcher::schedule(LoopQueue *lq)
+{
+    if (!lq->scheduled.exchange(true, memory_order_acq_rel))
+    {
+        lq->loop->queueInLoop([this, lq]() { drain(lq); });
+    }
+}
+
+void LoopDispatcher::drain(LoopQueue *lq)
+{
+    // 先清除标志再取消息，之后入队的生产者会重新调度一次drain，消息不会滞留
+    lq->scheduled.store(false, memory_order_release);
+
+    Delivery delivery;
+    int count = 0;
+    while (lq->queue.pop(delivery))
+    {
+        _deliver(delivery);
+        if (++count >= MAX_DRAIN_BATCH)
+        {
+            schedule(lq);
+            break;
+        }
+    }
+}
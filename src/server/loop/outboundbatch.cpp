@@ -0,0 +1,65 @@
+#include "outboundbatch.hpp"
+#include "coalescer.hpp"
+
+namespace
+{
+// 每个线程自己的批次，I/O线程数量很少，用vector线性查找目标loop即可
+struct ThreadBatch
+{
+    int depth = 0;
+    vector<pair<EventLoop *, vector<Delivery>>> loops;
+};
+
+thread_local ThreadBatch t_batch;
+}
+
+OutboundBatch::Scope::Scope()
+{
+    ++t_batch.depth;
+}
+
+OutboundBatch::Scope::~Scope()
+{
+    if (--t_batch.depth == 0)
+    {
+        OutboundBatch::flush();
+    }
+}
+
+// 发送消息给userid用户的连接conn
+void OutboundBatch::send(const TcpConnectionPtr &conn, int userid, const shared_ptr<const string> &payload)
+{
+    EventLoop *loop = conn->getLoop();
+    if (loop->isInLoopThread())
+    {
+        Coalescer::send(conn, userid, payload);
+        return;
+    }
+
+    if (t_batch.depth == 0)
+    {
+        LoopDispatcher::instance()->post(loop, {userid, conn, payload});
+        return;
+    }
+
+    for (auto &entry : t_batch.loops)
+    {
+        if (entry.first == loop)
+        {
+            entry.second.push_back({userid, conn, payload});
+            return;
+        }
+    }
+    t_batch.loops.emplace_back(loop, vector<Delivery>());
+    t_batch.loops.back().second.push_back({userid, conn, payload});
+}
+
+// 把当前线程暂存的消息按目标loop各投递一次
+void OutboundBatch::flush()
+{
+    for (auto &entry : t_batch.loops)
+    {
+        LoopDispatcher::instance()->postBatch(entry.first, entry.second);
+    }
+    t_batch.loops.clear();
+}
@@ -0,0 +1,282 @@
+#include "sessiontable.hpp"
+#include <algorithm>
+
+// 记录userid用户的连接，连接所属的loop取自conn
+void SessionTable::add(int userid, const TcpConnectionPtr &conn)
+{
+    add(userid, conn, conn->getLoop());
+}
+
+// 记录userid用户的连接
+void SessionTable::add(int userid, const TcpConnectionPtr &conn, EventLoop *loop)
+{
+    {
+        Shard &shard = _shards[shardOf(userid)];
+        lock_guard<mutex> lock(shard.mtx);
+        shard.users[userid] = {conn, loop, vector<int>()};
+        setOnline(userid, true);
+    }
+    {
+        Shard &shard = _shards[shardOf(conn.get())];
+        lock_guard<mutex> lock(shard.mtx);
+        shard.conns[conn.get()] = userid;
+    }
+}
+
+// 删除userid用户的连接
+void SessionTable::remove(int userid)
+{
+    TcpConnectionPtr conn;
+    {
+        Shard &shard = _shards[shardOf(userid)];
+        lock_guard<mutex> lock(shard.mtx);
+        auto it = shard.users.find(userid);
+        if (it == shard.users.end())
+        {
+            return;
+        }
+        conn = it->second.conn;
+        shard.users.erase(it);
+        setOnline(userid, false);
+    }
+    Shard &shard = _shards[shardOf(conn.get())];
+    lock_guard<mutex> lock(shard.mtx);
+    shard.conns.erase(conn.get());
+}
+
+// 删除连接conn，返回它对应的userid
+int SessionTable::remove(const TcpConnectionPtr &conn)
+{
+    int userid = -1;
+    {
+        Shard &shard = _shards[shardOf(conn.get())];
+        lock_guard<mutex> lock(shard.mtx);
+        auto it = shard.conns.find(conn.get());
+        if (it == shard.conns.end())
+        {
+            return -1;
+        }
+        userid = it->second;
+        shard.conns.erase(it);
+    }
+    {
+        Shard &shard = _shards[shardOf(userid)];
+        lock_guard<mutex> lock(shard.mtx);
+        auto it = shard.users.find(userid);
+        if (it == shard.users.end() || it->second.conn != conn)
+        {
+            return userid;
+        }
+        shard.users.erase(it);
+        setOnline(userid, false);
+    }
+    return userid;
+}
+
+// 查找userid用户的连接
+TcpConnectionPtr SessionTable::find(int userid)
+{
+    Shard &shard = _shards[shardOf(userid)];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.users.find(userid);
+    return it == shard.users.end() ? TcpConnectionPtr() : it->second.conn;
+}
+
+// 查找连接conn对应的userid
+int SessionTable::find(const TcpConnectionPtr &conn)
+{
+    Shard &shard = _shards[shardOf(conn.get())];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.conns.find(conn.get());
+    return it == shard.conns.end() ? -1 : it->second;
+}
+
+// 记录userid用户所在的群组
+void SessionTable::setGroups(int userid, const vector<int> &groupids)
+{
+    {
+        lock_guard<mutex> lock(_bitmapMutex);
+        for (int groupid : groupids)
+        {
+            _members[groupid].add(userid);
+        }
+    }
+
+    Shard &shard = _shards[shardOf(userid)];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.users.find(userid);
+    if (it != shard.users.end())
+    {
+        it->second.groups = groupids;
+    }
+}
+
+// userid用户加入了groupid群组
+void SessionTable::joinGroup(int userid, int groupid)
+{
+    {
+        lock_guard<mutex> lock(_bitmapMutex);
+        _members[groupid].add(userid);
+    }
+
+    Shard &shard = _shards[shardOf(userid)];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.users.find(userid);
+    if (it != shard.users.end())
+    {
+        it->second.groups.push_back(groupid);
+    }
+}
+
+// userid用户是否在线且是groupid群组的成员
+bool SessionTable::inGroup(int userid, int groupid)
+{
+    Shard &shard = _shards[shardOf(userid)];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.users.find(userid);
+    if (it == shard.users.end())
+    {
+        return false;
+    }
+    for (int id : it->second.groups)
+    {
+        if (id == groupid)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// userid用户所在的群组
+vector<int> SessionTable::groups(int userid)
+{
+    Shard &shard = _shards[shardOf(userid)];
+    lock_guard<mutex> lock(shard.mtx);
+    auto it = shard.users.find(userid);
+    if (it == shard.users.end())
+    {
+        return {};
+    }
+    return it->second.groups;
+}
+
+// groupid群组中在本节点在线的成员，不包括exclude
+vector<int> SessionTable::onlineMembers(int groupid, int exclude)
+{
+    vector<int> userids;
+    {
+        lock_guard<mutex> lock(_bitmapMutex);
+        auto it = _members.find(groupid);
+        if (it == _members.end())
+        {
+            return userids;
+        }
+        UserBitmap::intersect(it->second, _online).toVector(userids);
+    }
+
+    auto it = lower_bound(userids.begin(), userids.end(), exclude);
+    if (it != userids.end() && *it == exclude)
+    {
+        userids.erase(it);
+    }
+    return userids;
+}
+
+// 更新在线用户位图，在userid所在分片的锁内调用，保证和连接表一致
+void SessionTable::setOnline(int userid, bool online)
+{
+    lock_guard<mutex> lock(_bitmapMutex);
+    if (online)
+    {
+        _online.add(userid);
+    }
+    else
+    {
+        _online.remove(userid);
+    }
+}
+
+// 当前所有在线用户的userid
+vector<int> SessionTable::userids()
+{
+    vector<int> vec;
+    for (Shard &shard : _shards)
+    {
+        lock_guard<mutex> lock(shard.mtx);
+        for (auto &user : shard.users)
+        {
+            vec.push_back(user.first);
+        }
+    }
+    return vec;
+}
+
+// 先按分片分组，每个分片只加一次锁完成这一组用户的查找
+void SessionTable::partition(const vector<int> &userids, const shared_ptr<const string> &payload,
+                             LoopBatches &batches, vector<int> &missed)
+{
+    vector<int> shardUsers[SHARD_COUNT];
+    for (int id : userids)
+    {
+        shardUsers[shardOf(id)].push_back(id);
+    }
+
+    for (int i = 0; i < SHARD_COUNT; ++i)
+    {
+        if (shardUsers[i].empty())
+        {
+            continue;
+        }
+        Shard &shard = _shards[i];
+        lock_guard<mutex> lock(shard.mtx);
+        for (int id : shardUsers[i])
+        {
+            auto it = shard.users.find(id);
+            if (it == shard.users.end())
+            {
+                missed.push_back(id);
+                continue;
+            }
+
+            // I/O线程数量很少，线性查找目标loop的分组即可
+            EventLoop *loop = it->second.loop;
+            size_t k = 0;
+            while (k < batches.size() && batches[k].first != loop)
+            {
+                ++k;
+            }
+            if (k == batches.size())
+            {
+                batches.emplace_back(loop, vector<Delivery>());
+            }
+            batches[k].second.push_back({id, it->second.conn, payload});
+        }
+    }
+}
+
+// 把发给本节点所有在线用户的payload按连接所属的loop分组追加到batches中
+size_t SessionTable::partitionAll(const shared_ptr<const string> &payload, LoopBatches &batches)
+{
+    size_t count = 0;
+    for (Shard &shard : _shards)
+    {
+        lock_guard<mutex> lock(shard.mtx);
+        for (auto &user : shard.users)
+        {
+            EventLoop *loop = user.second.loop;
+            size_t k = 0;
+            while (k < batches.size() && batches[k].first != loop)
+            {
+                ++k;
+            }
+            if (k == batches.size())
+            {
+                batches.emplace_back(loop, vector<Delivery>());
+            }
+            batches[k].second.push_back({user.first, user.second.conn, payload});
+            ++count;
+        }
+    }
+    return count;
+}
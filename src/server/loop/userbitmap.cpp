@@ -0,0 +1,291 @@
+#include "userbitmap.hpp"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// out = a & b，返回结果中1的个数，n是4的倍数
+size_t andWords(const uint64_t *a, const uint64_t *b, uint64_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i += 4)
+    {
+#if defined(__AVX2__)
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_and_si256(va, vb));
+#elif defined(__SSE2__)
+        __m128i va0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i va1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 2));
+        __m128i vb1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_and_si128(va0, vb0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 2), _mm_and_si128(va1, vb1));
+#else
+        out[i] = a[i] & b[i];
+        out[i + 1] = a[i + 1] & b[i + 1];
+        out[i + 2] = a[i + 2] & b[i + 2];
+        out[i + 3] = a[i + 3] & b[i + 3];
+#endif
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        count += __builtin_popcountll(out[i]);
+    }
+    return count;
+}
+}
+
+void UserBitmap::Container::toBitmap()
+{
+    bits.assign(WORDS, 0);
+    for (uint16_t low : array)
+    {
+        bits[low >> 6] |= 1ULL << (low & 63);
+    }
+    vector<uint16_t>().swap(array);
+}
+
+void UserBitmap::Container::toArray()
+{
+    array.clear();
+    array.reserve(count);
+    for (size_t i = 0; i < WORDS; ++i)
+    {
+        uint64_t word = bits[i];
+        while (word)
+        {
+            array.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+            word &= word - 1;
+        }
+    }
+    vector<uint64_t>().swap(bits);
+}
+
+size_t UserBitmap::lowerBound(uint16_t key) const
+{
+    size_t lo = 0, hi = _containers.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (_containers[mid].key < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 加入userid
+void UserBitmap::add(uint32_t userid)
+{
+    uint16_t key = userid >> 16;
+    uint16_t low = userid & 0xFFFF;
+    size_t pos = lowerBound(key);
+    if (pos == _containers.size() || _containers[pos].key != key)
+    {
+        Container c;
+        c.key = key;
+        _containers.insert(_containers.begin() + pos, std::move(c));
+    }
+
+    Container &c = _containers[pos];
+    if (c.isBitmap())
+    {
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(c.bits[low >> 6] & mask))
+        {
+            c.bits[low >> 6] |= mask;
+            ++c.count;
+        }
+        return;
+    }
+
+    auto it = lower_bound(c.array.begin(), c.array.end(), low);
+    if (it != c.array.end() && *it == low)
+    {
+        return;
+    }
+    c.array.insert(it, low);
+    ++c.count;
+    if (c.count > ARRAY_MAX)
+    {
+        c.toBitmap();
+    }
+}
+
+// 删除userid
+void UserBitmap::remove(uint32_t userid)
+{
+    uint16_t key = userid >> 16;
+    uint16_t low = userid & 0xFFFF;
+    size_t pos = lowerBound(key);
+    if (pos == _containers.size() || _containers[pos].key != key)
+    {
+        return;
+    }
+
+    Container &c = _containers[pos];
+    if (c.isBitmap())
+    {
+        uint64_t mask = 1ULL << (low & 63);
+        if (!(c.bits[low >> 6] & mask))
+        {
+            return;
+        }
+        c.bits[low >> 6] &= ~mask;
+        if (--c.count <= ARRAY_MAX)
+        {
+            c.toArray();
+        }
+    }
+    else
+    {
+        auto it = lower_bound(c.array.begin(), c.array.end(), low);
+        if (it == c.array.end() || *it != low)
+        {
+            return;
+        }
+        c.array.erase(it);
+        --c.count;
+    }
+
+    if (c.count == 0)
+    {
+        _containers.erase(_containers.begin() + pos);
+    }
+}
+
+// 是否包含userid
+bool UserBitmap::contains(uint32_t userid) const
+{
+    uint16_t key = userid >> 16;
+    uint16_t low = userid & 0xFFFF;
+    size_t pos = lowerBound(key);
+    if (pos == _containers.size() || _containers[pos].key != key)
+    {
+        return false;
+    }
+
+    const Container &c = _containers[pos];
+    if (c.isBitmap())
+    {
+        return c.bits[low >> 6] & (1ULL << (low & 63));
+    }
+    return binary_search(c.array.begin(), c.array.end(), low);
+}
+
+// 元素个数
+size_t UserBitmap::cardinality() const
+{
+    size_t count = 0;
+    for (const Container &c : _containers)
+    {
+        count += c.count;
+    }
+    return count;
+}
+
+// 计算两个key相同的容器的交集
+void UserBitmap::intersect(const Container &a, const Container &b, Container &out)
+{
+    out.key = a.key;
+    if (a.isBitmap() && b.isBitmap())
+    {
+        out.bits.resize(WORDS);
+        out.count = andWords(a.bits.data(), b.bits.data(), out.bits.data(), WORDS);
+        if (out.count <= ARRAY_MAX)
+        {
+            out.toArray();
+        }
+        return;
+    }
+
+    if (a.isBitmap() || b.isBitmap())
+    {
+        // 用数组中的元素逐个检查位图
+        const Container &bitmap = a.isBitmap() ? a : b;
+        const Container &array = a.isBitmap() ? b : a;
+        for (uint16_t low : array.array)
+        {
+            if (bitmap.bits[low >> 6] & (1ULL << (low & 63)))
+            {
+                out.array.push_back(low);
+            }
+        }
+    }
+    else
+    {
+        set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                         back_inserter(out.array));
+    }
+    out.count = out.array.size();
+}
+
+// 计算a和b的交集
+UserBitmap UserBitmap::intersect(const UserBitmap &a, const UserBitmap &b)
+{
+    UserBitmap result;
+    size_t i = 0, j = 0;
+    while (i < a._containers.size() && j < b._containers.size())
+    {
+        uint16_t ka = a._containers[i].key;
+        uint16_t kb = b._containers[j].key;
+        if (ka < kb)
+        {
+            ++i;
+        }
+        else if (kb < ka)
+        {
+            ++j;
+        }
+        else
+        {
+            Container c;
+            intersect(a._containers[i], b._containers[j], c);
+            if (c.count > 0)
+            {
+                result._containers.push_back(std::move(c));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+// 按从小到大的顺序把所有元素追加到out中
+void UserBitmap::toVector(vector<int> &out) const
+{
+    for (const Container &c : _containers)
+    {
+        uint32_t high = static_cast<uint32_t>(c.key) << 16;
+        if (!c.isBitmap())
+        {
+            for (uint16_t low : c.array)
+            {
+                out.push_back(high | low);
+            }
+            continue;
+        }
+        for (size_t i = 0; i < WORDS; ++i)
+        {
+            uint64_t word = c.bits[i];
+            while (word)
+            {
+                out.push_back(high | (i * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+}
@@ -1,6 +1,7 @@
 // #include "../../include/server/chatserver.hpp"
 #include "chatserver.hpp"
 #include "chatservice.hpp"
+#include "config.hpp"
 #include <signal.h>
 #include <iostream>
 using namespace std;
@@ -20,6 +21,12 @@ int main(int argc, char **argv) {
     char *ip = argv[1];
     uint16_t port = atoi(argv[2]);
 
+    // 集群中每台服务器的节点号需唯一，默认使用监听端口，可以通过CHAT_NODE_ID指定
+    if (Config::instance().getInt("node_id", -1) == -1)
+    {
+        Config::instance().set("node_id", to_string(port));
+    }
+
     signal(SIGINT, resetHandler);
 
     EventLoop loop;
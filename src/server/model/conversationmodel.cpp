@@ -0,0 +1,130 @@
+#include "conversationmodel.hpp"
+#include "db.h"
+#include <algorithm>
+#include <map>
+
+// 按一批已路由的消息更新一对一会话的未读数和最近消息id
+void ConversationModel::apply(const vector<HistoryMessage> &msgs)
+{
+    // <用户, 会话> -> <未读数增量, 最近消息id>
+    map<pair<int, int64_t>, pair<int, int64_t>> updates;
+    for (const HistoryMessage &msg : msgs)
+    {
+        if (msg.convid <= 0)
+        {
+            continue;
+        }
+        int low = static_cast<int>(msg.convid >> 32);
+        int high = static_cast<int>(msg.convid & 0xFFFFFFFF);
+        int toid = msg.fromid == low ? high : low;
+
+        auto &sender = updates[{msg.fromid, msg.convid}];
+        sender.second = max(sender.second, msg.id);
+        auto &receiver = updates[{toid, msg.convid}];
+        receiver.first++;
+        receiver.second = max(receiver.second, msg.id);
+    }
+    if (updates.empty())
+    {
+        return;
+    }
+
+    string sql = "insert into conversation (userid, convid, unread, lastmid) values";
+    bool first = true;
+    for (auto &item : updates)
+    {
+        if (!first)
+        {
+            sql += ",";
+        }
+        first = false;
+        sql += "(" + to_string(item.first.first) + "," + to_string(item.first.second) + "," +
+               to_string(item.second.first) + "," + to_string(item.second.second) + ")";
+    }
+    sql += " on duplicate key update unread = unread + values(unread), lastmid = greatest(lastmid, values(lastmid))";
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        mysql.update(sql);
+    }
+}
+
+// 把userid用户的convid会话标记为已读
+void ConversationModel::markRead(int userid, int64_t convid)
+{
+    char sql[1024] = {0};
+    if (convid > 0)
+    {
+        sprintf(sql, "update conversation set unread = 0 where userid = %d and convid = %lld and unread > 0",
+                userid, (long long)convid);
+    }
+    else
+    {
+        // 群会话记录已读到的序号
+        sprintf(sql, "insert into conversation (userid, convid, readseq) \
+                select %d, %lld, ifnull((select seq from groupseq where groupid = %lld), 0) \
+                on duplicate key update readseq = greatest(readseq, values(readseq))",
+                userid, (long long)convid, (long long)-convid);
+    }
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        mysql.update(sql);
+    }
+}
+
+// 查询userid用户的会话列表
+vector<Conversation> ConversationModel::query(int userid, int limit)
+{
+    vector<Conversation> convs;
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return convs;
+    }
+
+    // 一对一会话：(userid, lastmid)索引上的倒序扫描
+    char sql[1024] = {0};
+    sprintf(sql, "select convid, unread, lastmid from conversation where userid = %d and convid > 0 \
+            order by lastmid desc limit %d", userid, limit);
+    MYSQL_RES *res = mysql.query(sql);
+    if (res != nullptr)
+    {
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            convs.push_back({atoll(row[0]), atoi(row[1]), atoll(row[2])});
+        }
+        mysql_free_result(res);
+    }
+
+    // 群会话：最新序号减去已读序号，最近消息id由history表的主键(convid, id)直接定位
+    sprintf(sql, "select u.groupid, ifnull(s.seq, 0) - coalesce(c.readseq, g.seq, 0), \
+            (select ifnull(max(h.id), 0) from history h where h.convid = -u.groupid) \
+            from groupuser u left join groupseq s on s.groupid = u.groupid \
+            left join conversation c on c.userid = u.userid and c.convid = -u.groupid \
+            left join groupcursor g on g.groupid = u.groupid and g.userid = u.userid \
+            where u.userid = %d", userid);
+    res = mysql.query(sql);
+    if (res != nullptr)
+    {
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(res)) != nullptr)
+        {
+            int unread = max(atoi(row[1]), 0);
+            convs.push_back({HistoryModel::groupConv(atoi(row[0])), unread, atoll(row[2])});
+        }
+        mysql_free_result(res);
+    }
+
+    stable_sort(convs.begin(), convs.end(), [](const Conversation &a, const Conversation &b) {
+        return a.lastmid > b.lastmid;
+    });
+    if ((int)convs.size() > limit)
+    {
+        convs.resize(limit);
+    }
+    return convs;
+}
@@ -0,0 +1,39 @@
+#include "dictionarymodel.hpp"
+#include "db.h"
+
+// 写入version版本的字典
+bool DictionaryModel::insert(int version, const string &dict)
+{
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return false;
+    }
+
+    // 多个节点同时训练出同一版本时只有第一个写入成功，其余节点重新读取后使用它
+    string sql = "insert ignore into payloaddict values(" + to_string(version) + ",'" + mysql.escape(dict) + "')";
+    return mysql.update(sql) && mysql_affected_rows(mysql.getConnection()) == 1;
+}
+
+// 查询所有版本的字典
+vector<pair<int, string>> DictionaryModel::query()
+{
+    vector<pair<int, string>> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query("select version, dict from payloaddict");
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                // 字典是二进制内容，按长度读取
+                unsigned long *lengths = mysql_fetch_lengths(res);
+                vec.push_back({atoi(row[0]), string(row[1], lengths[1])});
+            }
+            mysql_free_result(res);
+        }
+    }
+    return vec;
+}
@@ -0,0 +1,273 @@
+#include "grouptimelinemodel.hpp"
+#include "idgenerator.hpp"
+#include "db.h"
+#include "json.hpp"
+#include <chrono>
+using json = nlohmann::json;
+
+// 空洞之后的消息写入超过这个时间，空洞视为不会再写入；应大于数据库线程中异步追加的排队时间
+static const int64_t GAP_SETTLE_MILLIS = 30 * 1000;
+
+// 序号跳过的消息是否还可能被写入：由空洞之后第一条消息的id中的时间判断，没有id的旧消息不等待
+static bool gapPending(const GroupMessage &next)
+{
+    json js = json::parse(next.msg, nullptr, false);
+    if (!js.is_object())
+    {
+        return false;
+    }
+    auto it = js.find("mid");
+    if (it == js.end() || !it->is_number_integer())
+    {
+        return false;
+    }
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    return now - IdGenerator::toMillis(it->get<int64_t>()) < GAP_SETTLE_MILLIS;
+}
+
+// 追加一条群消息
+long long GroupTimelineModel::append(int groupid, const string &msg)
+{
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return -1;
+    }
+
+    // 按群分配序号，LAST_INSERT_ID(expr)让mysql_insert_id返回本连接分配到的序号，行锁保证并发唯一
+    char sql[1024] = {0};
+    sprintf(sql, "insert into groupseq values(%d, last_insert_id(1)) \
+            on duplicate key update seq = last_insert_id(seq + 1)", groupid);
+    if (!mysql.update(sql))
+    {
+        return -1;
+    }
+    long long seq = mysql_insert_id(mysql.getConnection());
+
+    string insert = "insert into grouptimeline values(" + to_string(groupid) + "," + to_string(seq) + ",'" + mysql.escape(msg) + "')";
+    if (!mysql.update(insert))
+    {
+        return -1;
+    }
+    return seq;
+}
+
+// 追加一条已经分配好序号的群消息
+bool GroupTimelineModel::append(int groupid, long long seq, const string &msg)
+{
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return false;
+    }
+
+    char sql[1024] = {0};
+    sprintf(sql, "insert into groupseq values(%d, %lld) on duplicate key update seq = greatest(seq, values(seq))", groupid, seq);
+    if (!mysql.update(sql))
+    {
+        return false;
+    }
+
+    string insert = "insert into grouptimeline values(" + to_string(groupid) + "," + to_string(seq) + ",'" + mysql.escape(msg) + "')";
+    return mysql.update(insert);
+}
+
+// 查询groupid群组已分配的最大序号
+long long GroupTimelineModel::maxSeq(int groupid)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "select seq from groupseq where groupid = %d", groupid);
+
+    long long seq = 0;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row = mysql_fetch_row(res);
+            if (row != nullptr)
+            {
+                seq = atoll(row[0]);
+            }
+            mysql_free_result(res);
+        }
+    }
+    return seq;
+}
+
+// 查询groupid群组中序号大于since且连续的消息
+vector<GroupMessage> GroupTimelineModel::query(int groupid, long long since, int limit, bool &gapped)
+{
+    gapped = false;
+    char sql[1024] = {0};
+    sprintf(sql, "select seq, message from grouptimeline where groupid = %d and seq > %lld order by seq limit %d",
+            groupid, since, limit);
+
+    vector<GroupMessage> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            long long expected = since + 1;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                GroupMessage msg{groupid, atoll(row[0]), row[1]};
+                if (msg.seq != expected && gapPending(msg))
+                {
+                    gapped = true;
+                    break;
+                }
+                expected = msg.seq + 1;
+                vec.push_back(std::move(msg));
+            }
+            mysql_free_result(res);
+        }
+    }
+    return vec;
+}
+
+// 查询userid用户所在群组中游标之后序号连续的消息
+vector<GroupMessage> GroupTimelineModel::queryUnread(int userid, int limit, map<int, long long> &unfinished)
+{
+    char sql[1024] = {0};
+    // 从groupuser出发，没有游标记录的成员按游标为0读取
+    sprintf(sql, "select t.groupid, t.seq, t.message, ifnull(c.seq, 0) from groupuser u \
+            left join groupcursor c on c.groupid = u.groupid and c.userid = u.userid \
+            inner join grouptimeline t on t.groupid = u.groupid and t.seq > ifnull(c.seq, 0) \
+            where u.userid = %d order by t.groupid, t.seq limit %d", userid, limit);
+
+    vector<GroupMessage> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            // 每个群组从游标开始检查序号是否连续，遇到空洞后跳过该群组之后的消息
+            int groupid = 0;
+            long long expected = 0;
+            bool gapped = false;
+            int rows = 0;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                ++rows;
+                GroupMessage msg{atoi(row[0]), atoll(row[1]), row[2]};
+                if (msg.groupid != groupid)
+                {
+                    groupid = msg.groupid;
+                    expected = atoll(row[3]) + 1;
+                    gapped = false;
+                }
+                if (gapped)
+                {
+                    continue;
+                }
+                if (msg.seq != expected && gapPending(msg))
+                {
+                    unfinished[groupid] = expected - 1;
+                    gapped = true;
+                    continue;
+                }
+                expected = msg.seq + 1;
+                vec.push_back(std::move(msg));
+            }
+            mysql_free_result(res);
+
+            // 达到上限时，最后一个群组和之后游标落后的群组也没有读完
+            if (rows >= limit)
+            {
+                unfinished.emplace(groupid, expected - 1);
+                for (auto &cursor : queryBehind(userid))
+                {
+                    if (cursor.first > groupid)
+                    {
+                        unfinished.emplace(cursor.first, cursor.second);
+                    }
+                }
+            }
+        }
+    }
+    return vec;
+}
+
+// 查询userid用户所在群组中游标落后于最新序号的群组
+map<int, long long> GroupTimelineModel::queryBehind(int userid)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "select u.groupid, ifnull(c.seq, 0) from groupuser u \
+            left join groupcursor c on c.groupid = u.groupid and c.userid = u.userid \
+            inner join groupseq s on s.groupid = u.groupid and s.seq > ifnull(c.seq, 0) where u.userid = %d", userid);
+
+    map<int, long long> cursors;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                cursors[atoi(row[0])] = atoll(row[1]);
+            }
+            mysql_free_result(res);
+        }
+    }
+    return cursors;
+}
+
+// 设置userid用户在groupid群组中的游标
+void GroupTimelineModel::setCursor(int userid, int groupid, long long seq)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "insert into groupcursor values(%d, %d, %lld) \
+            on duplicate key update seq = greatest(seq, values(seq))", groupid, userid, seq);
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        mysql.update(sql);
+    }
+}
+
+// 把userid用户在所有群组中的游标推进到群组的最新序号
+void GroupTimelineModel::advanceCursors(int userid, const vector<int> &exclude)
+{
+    string skip;
+    for (int groupid : exclude)
+    {
+        skip += (skip.empty() ? " and u.groupid not in (" : ",") + to_string(groupid);
+    }
+    if (!skip.empty())
+    {
+        skip += ")";
+    }
+    string sql = "insert into groupcursor select u.groupid, u.userid, ifnull(s.seq, 0) from groupuser u "
+                 "left join groupseq s on s.groupid = u.groupid where u.userid = " + to_string(userid) + skip +
+                 " on duplicate key update seq = greatest(groupcursor.seq, values(seq))";
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        mysql.update(sql);
+    }
+}
+
+// 新成员的游标设为群组当前的最新序号
+void GroupTimelineModel::initCursor(int userid, int groupid)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "insert into groupcursor select %d, %d, ifnull((select seq from groupseq where groupid = %d), 0) \
+            on duplicate key update seq = values(seq)", groupid, userid, groupid);
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        mysql.update(sql);
+    }
+}
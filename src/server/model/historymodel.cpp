@@ -0,0 +1,157 @@
+#include "historymodel.hpp"
+#include "db.h"
+#include "payloadcodec.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+// 一对一聊天的会话号
+int64_t HistoryModel::oneChatConv(int userid, int peerid)
+{
+    int64_t low = min(userid, peerid);
+    int64_t high = max(userid, peerid);
+    return (low << 32) | high;
+}
+
+// 群聊的会话号
+int64_t HistoryModel::groupConv(int groupid)
+{
+    return -static_cast<int64_t>(groupid);
+}
+
+// 批量存储历史消息
+void HistoryModel::insert(const vector<HistoryMessage> &msgs)
+{
+    if (msgs.empty())
+    {
+        return;
+    }
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        // 组装一条多行insert语句，消息内容需要转义
+        string sql = "insert into history values";
+        for (size_t i = 0; i < msgs.size(); ++i)
+        {
+            if (i != 0)
+            {
+                sql += ",";
+            }
+            sql += "(" + to_string(msgs[i].id) + "," + to_string(msgs[i].convid) + "," +
+                   to_string(msgs[i].fromid) + ",'" + mysql.escape(PayloadCodec::instance()->encode(msgs[i].msg)) + "')";
+        }
+        mysql.update(sql);
+    }
+}
+
+// 查询convid会话中id小于before的消息
+vector<HistoryMessage> HistoryModel::query(int64_t convid, int64_t before, int limit)
+{
+    // 主键(convid, id)上的范围扫描，只读取一页
+    char sql[1024] = {0};
+    if (before > 0)
+    {
+        sprintf(sql, "select id, fromid, message from history where convid = %lld and id < %lld \
+                order by id desc limit %d", (long long)convid, (long long)before, limit);
+    }
+    else
+    {
+        sprintf(sql, "select id, fromid, message from history where convid = %lld \
+                order by id desc limit %d", (long long)convid, limit);
+    }
+
+    vector<HistoryMessage> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                unsigned long *lengths = mysql_fetch_lengths(res);
+                vec.push_back({atoll(row[0]), convid, atoi(row[1]), PayloadCodec::instance()->decode(string(row[2], lengths[2]))});
+            }
+            mysql_free_result(res);
+        }
+    }
+    return vec;
+}
+
+// 扫描id大于after的消息
+vector<HistoryMessage> HistoryModel::scan(int64_t after, int limit)
+{
+    // id上的二级索引，按id分区只会访问最近的分区
+    char sql[1024] = {0};
+    sprintf(sql, "select id, convid, fromid, message from history where id > %lld order by id limit %d",
+            (long long)after, limit);
+
+    vector<HistoryMessage> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                unsigned long *lengths = mysql_fetch_lengths(res);
+                vec.push_back({atoll(row[0]), atoll(row[1]), atoi(row[2]), PayloadCodec::instance()->decode(string(row[3], lengths[3]))});
+            }
+            mysql_free_result(res);
+        }
+    }
+    return vec;
+}
+
+// 按(会话号, 消息id)批量查询消息
+vector<HistoryMessage> HistoryModel::query(const vector<pair<int64_t, int64_t>> &keys)
+{
+    vector<HistoryMessage> vec;
+    if (keys.empty())
+    {
+        return vec;
+    }
+
+    // 主键上的多点查询
+    string sql = "select id, convid, fromid, message from history where (convid, id) in (";
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (i != 0)
+        {
+            sql += ",";
+        }
+        sql += "(" + to_string(keys[i].first) + "," + to_string(keys[i].second) + ")";
+    }
+    sql += ")";
+
+    unordered_map<int64_t, HistoryMessage> found;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                int64_t id = atoll(row[0]);
+                unsigned long *lengths = mysql_fetch_lengths(res);
+                found[id] = {id, atoll(row[1]), atoi(row[2]), PayloadCodec::instance()->decode(string(row[3], lengths[3]))};
+            }
+            mysql_free_result(res);
+        }
+    }
+
+    for (auto &key : keys)
+    {
+        auto it = found.find(key.second);
+        if (it != found.end())
+        {
+            vec.push_back(std::move(it->second));
+        }
+    }
+    return vec;
+}
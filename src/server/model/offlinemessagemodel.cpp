@@ -1,57 +1,144 @@
 #include "offlinemessagemodel.hpp"
-#include "db.h"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+
+OfflineMsgModel::OfflineMsgModel()
+    : _store(OfflineStore::instance()), _codec(PayloadCodec::instance()),
+      _dedupMinBytes(max(Config::instance().getInt("offline_dedup_min_bytes", 64), 0))
+{
+}
 
 // 存储用户的离线消息
-void OfflineMsgModel::insert(int userid, string msg)
+bool OfflineMsgModel::insert(int userid, string msg)
 {
-    // 1. 组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "insert into offlinemessage values(%d,'%s')", userid, msg.c_str());
+    return _store->insert(userid, _codec->encode(msg));
+}
 
-    MySQL mysql; // 定义一个mysql对象（这个MySQL类是我们自己定义的）
-    if (mysql.connect())
+// 批量存储离线消息
+bool OfflineMsgModel::insert(const vector<pair<int, string>> &msgs)
+{
+    vector<pair<int, string>> encoded;
+    encoded.reserve(msgs.size());
+    for (auto &msg : msgs)
     {
-        mysql.update(sql);
+        encoded.emplace_back(msg.first, _codec->encode(msg.second));
     }
+
+    if (_dedupMinBytes > 0 && encoded.size() > 1 && _store->sharesPayloads())
+    {
+        // 找出这一批中存给多个接收者的消息
+        unordered_map<string, vector<size_t>> same;
+        for (size_t i = 0; i < encoded.size(); ++i)
+        {
+            if (encoded[i].second.size() >= _dedupMinBytes)
+            {
+                same[encoded[i].second].push_back(i);
+            }
+        }
+
+        unordered_map<string, int> acquired;
+        vector<SharedPayload> shared;
+        unordered_set<string> hashes;
+        for (auto &item : same)
+        {
+            if (item.second.size() > 1)
+            {
+                // 同一批中哈希相同而内容不同的消息只共享第一条，其余按原样存储
+                string hash = OfflinePayloadModel::hash(item.first);
+                if (hashes.insert(hash).second)
+                {
+                    shared.push_back({std::move(hash), &item.first, (int)item.second.size()});
+                }
+            }
+        }
+
+        // 先写入共享内容再写入引用，收件箱中的引用总能找到内容；
+        // 写入失败或哈希碰撞（表中已有不同的内容）的消息按原样存储
+        unordered_set<string> referenced = _payloadModel.acquire(shared);
+        for (SharedPayload &payload : shared)
+        {
+            if (referenced.count(payload.hash) != 0)
+            {
+                string ref = OFFLINE_PAYLOAD_REF + payload.hash;
+                for (size_t i : same[*payload.payload])
+                {
+                    encoded[i].second = ref;
+                }
+                acquired[payload.hash] = payload.refs;
+            }
+        }
+
+        // 收件箱写入失败时引用不会被读取，撤销增加的引用
+        if (!_store->insert(encoded))
+        {
+            _payloadModel.release(acquired);
+            return false;
+        }
+        return true;
+    }
+    return _store->insert(encoded);
 }
 
 // 删除用户的离线消息
 void OfflineMsgModel::remove(int userid)
 {
-    // 1. 组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "delete from offlinemessage where userid = %d", userid);
+    take(userid);
+}
+
+// 查询用户的离线消息
+vector<string> OfflineMsgModel::query(int userid)
+{
+    unordered_map<string, int> refs;
+    return resolve(_store->query(userid), refs);
+}
 
-    MySQL mysql; // 定义一个mysql对象（这个MySQL类是我们自己定义的）
-    if (mysql.connect())
+// 读取并删除用户的离线消息
+vector<string> OfflineMsgModel::take(int userid)
+{
+    vector<string> stored = _store->take(userid);
+    if (stored.empty())
     {
-        mysql.update(sql);
+        return stored;
     }
+
+    unordered_map<string, int> refs;
+    vector<string> msgs = resolve(std::move(stored), refs);
+    _payloadModel.release(refs);
+    return msgs;
 }
 
-// 查询用户的离线消息
-vector<string> OfflineMsgModel::query(int userid)
+// 把引用替换成消息内容并解压
+vector<string> OfflineMsgModel::resolve(vector<string> stored, unordered_map<string, int> &refs)
 {
-    // 1. 组装sql语句
-    char sql[1024] = {0};
-    sprintf(sql, "select message from offlinemessage where userid = %d", userid);
+    vector<string> hashes;
+    for (string &msg : stored)
+    {
+        if (msg.size() == OFFLINE_REF_SIZE && msg[0] == OFFLINE_PAYLOAD_REF && refs[msg.substr(1)]++ == 0)
+        {
+            hashes.push_back(msg.substr(1));
+        }
+    }
 
-    vector<string> vec;
-    MySQL mysql; // 定义一个mysql对象（这个MySQL类是我们自己定义的）
-    if (mysql.connect())
+    unordered_map<string, string> payloads = _payloadModel.query(hashes);
+    vector<string> msgs;
+    msgs.reserve(stored.size());
+    for (string &msg : stored)
     {
-        MYSQL_RES *res = mysql.query(sql);
-        if (res != nullptr) {
-            // 把userid用户的所有消息放入vec中返回
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res)) != nullptr)
-            {   // 结果可能不止一行，所以一行一行地拿
-                vec.push_back(row[0]);  // 每行就一个，就是message
+        if (msg.size() == OFFLINE_REF_SIZE && msg[0] == OFFLINE_PAYLOAD_REF)
+        {
+            auto it = payloads.find(msg.substr(1));
+            if (it == payloads.end())
+            {
+                // 引用的内容已经不在表中，这条离线消息无法送达
+                LOG_ERROR << "offline payload " << msg.substr(1) << " not found, message dropped";
+                continue;
             }
-
-            mysql_free_result(res);     // 释放mysql资源
-            return vec;
+            msgs.push_back(_codec->decode(it->second));
+        }
+        else
+        {
+            msgs.push_back(_codec->decode(msg));
         }
     }
-    return vec;
+    return msgs;
 }
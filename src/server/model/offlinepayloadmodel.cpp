@@ -0,0 +1,158 @@
+#include "offlinepayloadmodel.hpp"
+#include "db.h"
+#include <cstdint>
+#include <cstdio>
+
+// 消息内容的哈希，两个不同的64位哈希拼成128位
+// 偶然碰撞的概率可以忽略，但不能防止有意构造的碰撞，acquire时比较已存的内容
+string OfflinePayloadModel::hash(const string &payload)
+{
+    // FNV-1a
+    uint64_t h1 = 14695981039346656037ULL;
+    // 乘法-移位混合，种子与h1不同
+    uint64_t h2 = 0x9E3779B97F4A7C15ULL ^ payload.size();
+    for (unsigned char c : payload)
+    {
+        h1 = (h1 ^ c) * 1099511628211ULL;
+        h2 = (h2 ^ c) * 0xFF51AFD7ED558CCDULL;
+        h2 ^= h2 >> 32;
+    }
+    h2 ^= h2 >> 33;
+    h2 *= 0xC4CEB9FE1A85EC53ULL;
+    h2 ^= h2 >> 33;
+
+    char buf[33];
+    snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+    return buf;
+}
+
+// 增加引用
+unordered_set<string> OfflinePayloadModel::acquire(const vector<SharedPayload> &payloads)
+{
+    unordered_set<string> acquired;
+    if (payloads.empty())
+    {
+        return acquired;
+    }
+
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return acquired;
+    }
+
+    // 一条多行insert，已经存在且内容相同的只增加引用数，内容不同的保持不变
+    string sql = "insert into offlinepayload(hash, refcount, message) values";
+    string in;
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+        if (i != 0)
+        {
+            sql += ",";
+        }
+        sql += "('" + payloads[i].hash + "'," + to_string(payloads[i].refs) + ",'" + mysql.escape(*payloads[i].payload) + "')";
+        in += (i == 0 ? "'" : ",'") + payloads[i].hash + "'";
+    }
+    string same = "cast(message as binary) = cast(values(message) as binary)";
+    sql += " on duplicate key update refcount = refcount + if(" + same + ", values(refcount), 0)";
+
+    // 在同一个事务中读回写入的行，行锁保证读到的就是insert时比较的内容
+    if (!mysql.update("start transaction"))
+    {
+        return acquired;
+    }
+    if (!mysql.update(sql))
+    {
+        mysql.update("rollback");
+        return acquired;
+    }
+    MYSQL_RES *res = mysql.query("select hash, message from offlinepayload where hash in (" + in + ") for update");
+    if (res == nullptr)
+    {
+        mysql.update("rollback");
+        return acquired;
+    }
+    unordered_map<string, string> stored;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr)
+    {
+        unsigned long *lengths = mysql_fetch_lengths(res);
+        stored[row[0]].assign(row[1], lengths[1]);
+    }
+    mysql_free_result(res);
+    if (!mysql.update("commit"))
+    {
+        return acquired;
+    }
+
+    for (const SharedPayload &payload : payloads)
+    {
+        auto it = stored.find(payload.hash);
+        if (it != stored.end() && it->second == *payload.payload)
+        {
+            acquired.insert(payload.hash);
+        }
+    }
+    return acquired;
+}
+
+// 按哈希查询消息内容
+unordered_map<string, string> OfflinePayloadModel::query(const vector<string> &hashes)
+{
+    unordered_map<string, string> payloads;
+    if (hashes.empty())
+    {
+        return payloads;
+    }
+
+    string sql = "select hash, message from offlinepayload where hash in (";
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        sql += (i == 0 ? "'" : ",'") + hashes[i] + "'";
+    }
+    sql += ")";
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                // 压缩后的内容可能包含'\0'，按长度读取
+                unsigned long *lengths = mysql_fetch_lengths(res);
+                payloads[row[0]].assign(row[1], lengths[1]);
+            }
+            mysql_free_result(res);
+        }
+    }
+    return payloads;
+}
+
+// 减少引用，并删除不再被引用的内容
+void OfflinePayloadModel::release(const unordered_map<string, int> &refs)
+{
+    if (refs.empty())
+    {
+        return;
+    }
+
+    MySQL mysql;
+    if (!mysql.connect())
+    {
+        return;
+    }
+
+    string in, cases;
+    for (auto &ref : refs)
+    {
+        in += (in.empty() ? "'" : ",'") + ref.first + "'";
+        cases += " when '" + ref.first + "' then " + to_string(ref.second);
+    }
+    mysql.update("update offlinepayload set refcount = refcount - case hash" + cases + " end where hash in (" + in + ")");
+    // 删除语句对行加锁，与并发的acquire串行执行，不会删除刚被重新引用的内容
+    mysql.update("delete from offlinepayload where hash in (" + in + ") and refcount <= 0");
+}
+
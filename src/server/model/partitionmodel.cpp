@@ -0,0 +1,158 @@
+#include "partitionmodel.hpp"
+#include "db.h"
+#include <muduo/base/Logging.h>
+#include <ctime>
+#include <climits>
+
+namespace
+{
+// 毫秒时间戳所在周期的开始时刻（UTC）
+struct tm periodStart(int64_t millis, PartitionModel::Period period)
+{
+    time_t seconds = millis / 1000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    if (period == PartitionModel::MONTHLY)
+    {
+        tm.tm_mday = 1;
+    }
+    return tm;
+}
+
+// 下一个周期
+struct tm nextPeriod(struct tm tm, PartitionModel::Period period)
+{
+    if (period == PartitionModel::MONTHLY)
+    {
+        tm.tm_mon++;
+    }
+    else
+    {
+        tm.tm_mday++;
+    }
+    time_t seconds = timegm(&tm);   // 规范化跨月、跨年
+    gmtime_r(&seconds, &tm);
+    return tm;
+}
+
+string periodName(const struct tm &tm, PartitionModel::Period period)
+{
+    char name[16];
+    strftime(name, sizeof(name), period == PartitionModel::MONTHLY ? "p%Y%m" : "p%Y%m%d", &tm);
+    return name;
+}
+}
+
+// 查询table的分区
+vector<PartitionInfo> PartitionModel::query(const string &table)
+{
+    char sql[1024] = {0};
+    sprintf(sql, "select partition_name, partition_description, table_rows, data_length + index_length \
+            from information_schema.partitions where table_schema = database() and table_name = '%s' \
+            and partition_name is not null order by partition_ordinal_position", table.c_str());
+
+    vector<PartitionInfo> vec;
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr)
+        {
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {
+                string bound = row[1] ? row[1] : "MAXVALUE";
+                vec.push_back({row[0], bound == "MAXVALUE" ? INT64_MAX : atoll(bound.c_str()),
+                               row[2] ? atoll(row[2]) : 0, row[3] ? atoll(row[3]) : 0});
+            }
+            mysql_free_result(res);
+        }
+    }
+    return vec;
+}
+
+// 删除table的分区
+bool PartitionModel::drop(const string &table, const vector<string> &names)
+{
+    if (names.empty())
+    {
+        return true;
+    }
+
+    string sql = "alter table " + table + " drop partition ";
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        sql += (i == 0 ? "" : ",") + names[i];
+    }
+
+    MySQL mysql;
+    return mysql.connect() && mysql.update(sql);
+}
+
+// 从MAXVALUE分区中拆分出新的分区
+bool PartitionModel::split(const string &table, const vector<pair<string, int64_t>> &partitions)
+{
+    if (partitions.empty())
+    {
+        return true;
+    }
+
+    string sql = "alter table " + table + " reorganize partition pmax into (";
+    for (auto &partition : partitions)
+    {
+        sql += "partition " + partition.first + " values less than (" + to_string(partition.second) + "),";
+    }
+    sql += "partition pmax values less than maxvalue)";
+
+    MySQL mysql;
+    return mysql.connect() && mysql.update(sql);
+}
+
+// 维护table的分区
+int PartitionModel::rotate(const string &table, Period period, const function<int64_t(int64_t)> &toBound,
+                           int64_t nowMillis, int64_t cutoffMillis, int ahead)
+{
+    vector<PartitionInfo> partitions = query(table);
+    if (partitions.empty() || partitions.back().bound != INT64_MAX)
+    {
+        LOG_ERROR << "table " << table << " is not partitioned by range with a pmax partition";
+        return 0;
+    }
+
+    // 整个分区都早于cutoff才删除
+    vector<string> expired;
+    int64_t maxBound = INT64_MIN;
+    for (const PartitionInfo &partition : partitions)
+    {
+        if (partition.bound == INT64_MAX)
+        {
+            continue;
+        }
+        if (cutoffMillis > 0 && partition.bound <= toBound(cutoffMillis))
+        {
+            expired.push_back(partition.name);
+        }
+        maxBound = max(maxBound, partition.bound);
+    }
+    if (!expired.empty() && !drop(table, expired))
+    {
+        expired.clear();
+    }
+
+    // 提前建立之后的分区
+    vector<pair<string, int64_t>> added;
+    struct tm tm = periodStart(nowMillis, period);
+    for (int i = 0; i <= ahead; ++i)
+    {
+        struct tm next = nextPeriod(tm, period);
+        int64_t bound = toBound(static_cast<int64_t>(timegm(&next)) * 1000);
+        if (bound > maxBound)
+        {
+            added.push_back({periodName(tm, period), bound});
+        }
+        tm = next;
+    }
+    split(table, added);
+    return expired.size();
+}
@@ -0,0 +1,848 @@
+#include "jsontape.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// 嵌套深度上限，超过时退回完整解析
+const int MAX_DEPTH = 64;
+
+// 一个64字节块的分类结果，第i位对应块中第i个字节
+struct BlockMasks
+{
+    uint64_t quote;     // '"'
+    uint64_t backslash; // '\\'
+    uint64_t op;        // { } [ ] : ,
+    uint64_t space;     // 空格 \t \n \r
+    uint64_t control;   // 小于0x20的字节，不能出现在字符串中
+    uint64_t high;      // 大于等于0x80的字节，需要校验UTF-8
+};
+
+#ifdef __SSE2__
+inline uint64_t movemask64(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    uint64_t r0 = static_cast<uint16_t>(_mm_movemask_epi8(a));
+    uint64_t r1 = static_cast<uint16_t>(_mm_movemask_epi8(b));
+    uint64_t r2 = static_cast<uint16_t>(_mm_movemask_epi8(c));
+    uint64_t r3 = static_cast<uint16_t>(_mm_movemask_epi8(d));
+    return r0 | (r1 << 16) | (r2 << 32) | (r3 << 48);
+}
+
+inline void classify16(__m128i v, __m128i &quote, __m128i &backslash, __m128i &op, __m128i &space, __m128i &control)
+{
+    quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+    backslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+    op = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']')))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+    space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    // 无符号比较 v <= 0x1F：max(v, 0x1F) == 0x1F
+    control = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+}
+
+void classify(const char *p, BlockMasks &m)
+{
+    __m128i q[4], b[4], o[4], s[4], c[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+        classify16(v, q[i], b[i], o[i], s[i], c[i]);
+    }
+    m.quote = movemask64(q[0], q[1], q[2], q[3]);
+    m.backslash = movemask64(b[0], b[1], b[2], b[3]);
+    m.op = movemask64(o[0], o[1], o[2], o[3]);
+    m.space = movemask64(s[0], s[1], s[2], s[3]);
+    m.control = movemask64(c[0], c[1], c[2], c[3]);
+    m.high = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        m.high |= static_cast<uint64_t>(static_cast<uint16_t>(
+                      _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i)))))
+                  << (16 * i);
+    }
+}
+#else
+void classify(const char *p, BlockMasks &m)
+{
+    m = BlockMasks{0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 64; ++i)
+    {
+        unsigned char ch = static_cast<unsigned char>(p[i]);
+        uint64_t bit = 1ULL << i;
+        switch (ch)
+        {
+        case '"':
+            m.quote |= bit;
+            break;
+        case '\\':
+            m.backslash |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            m.op |= bit;
+            break;
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            m.space |= bit;
+            break;
+        }
+        if (ch < 0x20)
+        {
+            m.control |= bit;
+        }
+        if (ch >= 0x80)
+        {
+            m.high |= bit;
+        }
+    }
+}
+#endif
+
+// 前缀异或：结果的第i位是x的第0..i位的异或，用于由引号位置求出字符串内部的范围
+inline uint64_t prefixXor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/*
+找出被转义的字符：奇数个连续反斜杠之后的那个字符被转义
+- 从奇数位开始的反斜杠序列加上序列本身，进位落在序列之后的位置，
+  序列长度为奇数时进位落在偶数位，反之落在奇数位，和起始位置的奇偶性比较即可判断
+- prevEscaped记录上一块最后一个字符是否转义了本块的第一个字符
+*/
+inline uint64_t findEscaped(uint64_t backslash, uint64_t &prevEscaped)
+{
+    const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+    if (backslash == 0)
+    {
+        uint64_t escaped = prevEscaped;
+        prevEscaped = 0;
+        return escaped;
+    }
+    backslash &= ~prevEscaped;
+    uint64_t followsEscape = (backslash << 1) | prevEscaped;
+    uint64_t oddStarts = backslash & ~EVEN_BITS & ~followsEscape;
+    uint64_t sequencesStartingOnEven;
+    prevEscaped = __builtin_add_overflow(oddStarts, backslash, &sequencesStartingOnEven) ? 1 : 0;
+    uint64_t invertMask = sequencesStartingOnEven << 1;
+    return (EVEN_BITS ^ invertMask) & followsEscape;
+}
+
+// 校验UTF-8编码，拒绝过长编码、代理项和超出U+10FFFF的码点
+bool validUtf8(const unsigned char *p, size_t len)
+{
+    const unsigned char *end = p + len;
+    while (p < end)
+    {
+        unsigned char c = *p;
+        if (c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF)
+        {
+            n = 1;
+        }
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 2;
+            if (c == 0xE0)
+            {
+                lo = 0xA0;
+            }
+            else if (c == 0xED)
+            {
+                hi = 0x9F;
+            }
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 3;
+            if (c == 0xF0)
+            {
+                lo = 0x90;
+            }
+            else if (c == 0xF4)
+            {
+                hi = 0x8F;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        if (static_cast<size_t>(end - p) <= n || p[1] < lo || p[1] > hi)
+        {
+            return false;
+        }
+        for (size_t i = 2; i <= n; ++i)
+        {
+            if ((p[i] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        p += n + 1;
+    }
+    return true;
+}
+
+// 标量（数字、true、false、null）之后的字符：空白、引号和结构字符
+struct ScalarEndTable
+{
+    bool table[256];
+    constexpr ScalarEndTable() : table()
+    {
+        const char ends[] = " \t\n\r\",:{}[]";
+        for (size_t i = 0; i + 1 < sizeof(ends); ++i)
+        {
+            table[static_cast<unsigned char>(ends[i])] = true;
+        }
+    }
+    bool operator[](unsigned char c) const { return table[c]; }
+};
+// 编译期初始化，其他编译单元的静态对象初始化时也可以使用
+constexpr ScalarEndTable SCALAR_END;
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool readHex4(const char *p, const char *end, uint32_t &code)
+{
+    if (end - p < 4)
+    {
+        return false;
+    }
+    code = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int h = hexValue(p[i]);
+        if (h < 0)
+        {
+            return false;
+        }
+        code = (code << 4) | h;
+    }
+    return true;
+}
+
+void appendUtf8(string &out, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out.push_back(static_cast<char>(code));
+    }
+    else if (code < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+} // namespace
+
+bool JsonTape::unescape(const char *p, size_t len, string &out)
+{
+    const char *end = p + len;
+    out.clear();
+    out.reserve(len);
+    while (p < end)
+    {
+        const char *slash = static_cast<const char *>(memchr(p, '\\', end - p));
+        if (slash == nullptr)
+        {
+            out.append(p, end);
+            break;
+        }
+        out.append(p, slash);
+        p = slash + 1;
+        if (p == end)
+        {
+            return false;
+        }
+        switch (*p++)
+        {
+        case '"':
+            out.push_back('"');
+            break;
+        case '\\':
+            out.push_back('\\');
+            break;
+        case '/':
+            out.push_back('/');
+            break;
+        case 'b':
+            out.push_back('\b');
+            break;
+        case 'f':
+            out.push_back('\f');
+            break;
+        case 'n':
+            out.push_back('\n');
+            break;
+        case 'r':
+            out.push_back('\r');
+            break;
+        case 't':
+            out.push_back('\t');
+            break;
+        case 'u':
+        {
+            uint32_t code;
+            if (!readHex4(p, end, code))
+            {
+                return false;
+            }
+            p += 4;
+            if (code >= 0xD800 && code <= 0xDBFF)
+            {
+                // 高代理项后面必须紧跟低代理项
+                uint32_t low;
+                if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !readHex4(p + 2, end, low) ||
+                    low < 0xDC00 || low > 0xDFFF)
+                {
+                    return false;
+                }
+                p += 6;
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if (code >= 0xDC00 && code <= 0xDFFF)
+            {
+                return false;
+            }
+            appendUtf8(out, code);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonTape::index(const char *data, size_t len)
+{
+    _structurals.clear();
+    uint64_t prevEscaped = 0;
+    uint64_t prevInString = 0;
+    uint64_t prevScalar = 0;
+    uint64_t high = 0;
+    for (size_t offset = 0; offset < len; offset += 64)
+    {
+        BlockMasks m;
+        if (len - offset >= 64)
+        {
+            classify(data + offset, m);
+        }
+        else
+        {
+            // 最后不足64字节的部分用空格补齐
+            char block[64];
+            memset(block, ' ', sizeof(block));
+            memcpy(block, data + offset, len - offset);
+            classify(block, m);
+        }
+
+        high |= m.high;
+        uint64_t escaped = findEscaped(m.backslash, prevEscaped);
+        uint64_t quote = m.quote & ~escaped;
+        // 字符串内部的范围：包括开头的引号，不包括结尾的引号
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+        if (m.control & inString)
+        {
+            return false;
+        }
+
+        uint64_t op = m.op & ~inString;
+        uint64_t scalar = ~(m.op | m.space | quote | inString);
+        uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+        prevScalar = scalar >> 63;
+
+        uint64_t structurals = op | quote | scalarStart;
+        while (structurals != 0)
+        {
+            _structurals.push_back(static_cast<uint32_t>(offset + __builtin_ctzll(structurals)));
+            structurals &= structurals - 1;
+        }
+    }
+    // 字符串没有结束
+    if (prevInString != 0)
+    {
+        return false;
+    }
+    // 只有出现非ASCII字节时才逐字节校验UTF-8
+    return high == 0 || validUtf8(reinterpret_cast<const unsigned char *>(data), len);
+}
+
+bool JsonTape::parse(const char *data, size_t len)
+{
+    _nodes.clear();
+    const char *nul = static_cast<const char *>(memchr(data, '\0', len));
+    if (nul != nullptr)
+    {
+        len = nul - data;
+    }
+    if (len >= UINT32_MAX)
+    {
+        return false;
+    }
+    _text = data;
+    _len = len;
+    if (!index(data, len) || _structurals.empty())
+    {
+        return false;
+    }
+
+    size_t k = 0;
+    if (!parseValue(k, 0) || k != _structurals.size())
+    {
+        _nodes.clear();
+        return false;
+    }
+    return true;
+}
+
+bool JsonTape::parseValue(size_t &k, int depth)
+{
+    if (k >= _structurals.size())
+    {
+        return false;
+    }
+    uint32_t pos = _structurals[k];
+    char c = _text[pos];
+    if (c == '"')
+    {
+        return parseString(k);
+    }
+    if (c != '{' && c != '[')
+    {
+        return parseScalar(k);
+    }
+    if (depth >= MAX_DEPTH)
+    {
+        return false;
+    }
+
+    bool object = c == '{';
+    char close = object ? '}' : ']';
+    uint32_t self = static_cast<uint32_t>(_nodes.size());
+    Node node;
+    node.begin = pos;
+    node.type = object ? TYPE_OBJECT : TYPE_ARRAY;
+    node.escaped = false;
+    node.num.i = 0;
+    _nodes.push_back(node);
+    ++k;
+
+    if (k < _structurals.size() && _text[_structurals[k]] == close)
+    {
+        _nodes[self].end = _structurals[k] + 1;
+        _nodes[self].next = static_cast<uint32_t>(_nodes.size());
+        ++k;
+        return true;
+    }
+    for (;;)
+    {
+        if (object)
+        {
+            // 成员名必须是字符串，后面跟':'
+            if (k >= _structurals.size() || _text[_structurals[k]] != '"' || !parseString(k))
+            {
+                return false;
+            }
+            if (k >= _structurals.size() || _text[_structurals[k]] != ':')
+            {
+                return false;
+            }
+            ++k;
+        }
+        if (!parseValue(k, depth + 1))
+        {
+            return false;
+        }
+        if (k >= _structurals.size())
+        {
+            return false;
+        }
+        char sep = _text[_structurals[k]];
+        ++k;
+        if (sep == close)
+        {
+            break;
+        }
+        if (sep != ',')
+        {
+            return false;
+        }
+    }
+    _nodes[self].end = _structurals[k - 1] + 1;
+    _nodes[self].next = static_cast<uint32_t>(_nodes.size());
+    return true;
+}
+
+bool JsonTape::parseString(size_t &k)
+{
+    // 开头的引号之后的下一个结构位置一定是结尾的引号
+    if (k + 1 >= _structurals.size())
+    {
+        return false;
+    }
+    uint32_t begin = _structurals[k];
+    uint32_t end = _structurals[k + 1];
+    Node node;
+    node.begin = begin;
+    node.end = end + 1;
+    node.next = static_cast<uint32_t>(_nodes.size()) + 1;
+    node.type = TYPE_STRING;
+    node.escaped = memchr(_text + begin + 1, '\\', end - begin - 1) != nullptr;
+    node.num.i = 0;
+    if (node.escaped)
+    {
+        // 转义不合法时整条消息交给完整解析处理
+        static thread_local string scratch;
+        if (!unescape(_text + begin + 1, end - begin - 1, scratch))
+        {
+            return false;
+        }
+    }
+    _nodes.push_back(node);
+    k += 2;
+    return true;
+}
+
+bool JsonTape::parseScalar(size_t &k)
+{
+    uint32_t begin = _structurals[k];
+    uint32_t end = begin;
+    while (end < _len && !SCALAR_END[static_cast<unsigned char>(_text[end])])
+    {
+        ++end;
+    }
+    const char *p = _text + begin;
+    size_t n = end - begin;
+
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.next = static_cast<uint32_t>(_nodes.size()) + 1;
+    node.escaped = false;
+    node.num.i = 0;
+    if (n == 4 && memcmp(p, "true", 4) == 0)
+    {
+        node.type = TYPE_TRUE;
+    }
+    else if (n == 5 && memcmp(p, "false", 5) == 0)
+    {
+        node.type = TYPE_FALSE;
+    }
+    else if (n == 4 && memcmp(p, "null", 4) == 0)
+    {
+        node.type = TYPE_NULL;
+    }
+    else
+    {
+        // 数字：-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        size_t i = 0;
+        bool negative = false;
+        if (i < n && p[i] == '-')
+        {
+            negative = true;
+            ++i;
+        }
+        if (i >= n || !isDigit(p[i]))
+        {
+            return false;
+        }
+        // 整数部分边校验边累加，超过19位时value已经无效，只用于按double处理
+        size_t intBegin = i;
+        uint64_t value = 0;
+        if (p[i] == '0')
+        {
+            ++i;
+        }
+        else
+        {
+            while (i < n && isDigit(p[i]))
+            {
+                value = value * 10 + (p[i] - '0');
+                ++i;
+            }
+        }
+        size_t intEnd = i;
+        bool integer = true;
+        if (i < n && p[i] == '.')
+        {
+            integer = false;
+            ++i;
+            if (i >= n || !isDigit(p[i]))
+            {
+                return false;
+            }
+            while (i < n && isDigit(p[i]))
+            {
+                ++i;
+            }
+        }
+        if (i < n && (p[i] == 'e' || p[i] == 'E'))
+        {
+            integer = false;
+            ++i;
+            if (i < n && (p[i] == '+' || p[i] == '-'))
+            {
+                ++i;
+            }
+            if (i >= n || !isDigit(p[i]))
+            {
+                return false;
+            }
+            while (i < n && isDigit(p[i]))
+            {
+                ++i;
+            }
+        }
+        if (i != n)
+        {
+            return false;
+        }
+
+        // 不超过19位的整数不会溢出uint64，在int64范围内的按整数处理（消息id有19位），其余按double处理
+        if (integer && intEnd - intBegin <= 19 && value <= static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0))
+        {
+            node.type = TYPE_INT;
+            node.num.i = negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+        }
+        else
+        {
+            char buf[64];
+            if (n >= sizeof(buf))
+            {
+                return false;
+            }
+            memcpy(buf, p, n);
+            buf[n] = '\0';
+            node.type = TYPE_DOUBLE;
+            node.num.d = strtod(buf, nullptr);
+            if (std::isinf(node.num.d))
+            {
+                return false;
+            }
+        }
+    }
+    _nodes.push_back(node);
+    ++k;
+    return true;
+}
+
+JsonTape::Value JsonTape::Value::operator[](string_view key) const
+{
+    if (type() != TYPE_OBJECT)
+    {
+        return Value();
+    }
+    // 成员名重复时取最后一个，和nlohmann::json的行为一致
+    const vector<Node> &nodes = _tape->_nodes;
+    uint32_t end = nodes[_index].next;
+    uint32_t found = 0;
+    string decoded;
+    for (uint32_t i = _index + 1; i < end; i = nodes[i + 1].next)
+    {
+        const Node &name = nodes[i];
+        const char *p = _tape->_text + name.begin + 1;
+        size_t n = name.end - name.begin - 2;
+        if (!name.escaped)
+        {
+            if (n == key.size() && memcmp(p, key.data(), n) == 0)
+            {
+                found = i + 1;
+            }
+        }
+        else if (unescape(p, n, decoded) && decoded == key)
+        {
+            found = i + 1;
+        }
+    }
+    return found != 0 ? Value(_tape, found) : Value();
+}
+
+JsonTape::Value JsonTape::Value::first() const
+{
+    if (type() != TYPE_ARRAY)
+    {
+        return Value();
+    }
+    uint32_t end = _tape->_nodes[_index].next;
+    return _index + 1 < end ? Value(_tape, _index + 1, end) : Value();
+}
+
+JsonTape::Value JsonTape::Value::next() const
+{
+    if (_tape == nullptr)
+    {
+        return Value();
+    }
+    uint32_t sibling = _tape->_nodes[_index].next;
+    return sibling < _end ? Value(_tape, sibling, _end) : Value();
+}
+
+size_t JsonTape::Value::size() const
+{
+    Type t = type();
+    if (t != TYPE_ARRAY && t != TYPE_OBJECT)
+    {
+        return 0;
+    }
+    const vector<Node> &nodes = _tape->_nodes;
+    size_t count = 0;
+    uint32_t end = nodes[_index].next;
+    for (uint32_t i = _index + 1; i < end; i = nodes[i].next)
+    {
+        ++count;
+    }
+    return t == TYPE_OBJECT ? count / 2 : count;
+}
+
+bool JsonTape::Value::get(int64_t &value) const
+{
+    if (type() != TYPE_INT)
+    {
+        return false;
+    }
+    value = _tape->_nodes[_index].num.i;
+    return true;
+}
+
+bool JsonTape::Value::get(int &value) const
+{
+    int64_t v;
+    if (!get(v) || v < INT32_MIN || v > INT32_MAX)
+    {
+        return false;
+    }
+    value = static_cast<int>(v);
+    return true;
+}
+
+bool JsonTape::Value::get(double &value) const
+{
+    Type t = type();
+    if (t == TYPE_INT)
+    {
+        value = static_cast<double>(_tape->_nodes[_index].num.i);
+        return true;
+    }
+    if (t == TYPE_DOUBLE)
+    {
+        value = _tape->_nodes[_index].num.d;
+        return true;
+    }
+    return false;
+}
+
+bool JsonTape::Value::get(bool &value) const
+{
+    Type t = type();
+    if (t != TYPE_TRUE && t != TYPE_FALSE)
+    {
+        return false;
+    }
+    value = t == TYPE_TRUE;
+    return true;
+}
+
+bool JsonTape::Value::get(string &value) const
+{
+    if (type() != TYPE_STRING)
+    {
+        return false;
+    }
+    const Node &node = _tape->_nodes[_index];
+    const char *p = _tape->_text + node.begin + 1;
+    size_t n = node.end - node.begin - 2;
+    if (!node.escaped)
+    {
+        value.assign(p, n);
+        return true;
+    }
+    return unescape(p, n, value);
+}
+
+int64_t JsonTape::Value::asInt(int64_t def) const
+{
+    int64_t value;
+    return get(value) ? value : def;
+}
+
+string JsonTape::Value::asString(const string &def) const
+{
+    string value;
+    return get(value) ? value : def;
+}
+
+bool JsonTape::Value::asBool(bool def) const
+{
+    bool value;
+    return get(value) ? value : def;
+}
+
+string_view JsonTape::Value::raw() const
+{
+    if (_tape == nullptr)
+    {
+        return string_view();
+    }
+    const Node &node = _tape->_nodes[_index];
+    return string_view(_tape->_text + node.begin, node.end - node.begin);
+}
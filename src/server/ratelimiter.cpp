@@ -0,0 +1,23 @@
+#include "ratelimiter.hpp"
+#include <algorithm>
+
+RateLimiter::RateLimiter(double rate, double burst)
+    : _rate(rate), _burst(max(burst, 1.0)), _tokens(_burst), _last(chrono::steady_clock::now())
+{
+}
+
+// 取一个令牌，没有令牌时返回false
+bool RateLimiter::tryAcquire()
+{
+    lock_guard<mutex> lock(_mutex);
+    auto now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - _last).count();
+    _last = now;
+    _tokens = min(_burst, _tokens + elapsed * _rate);
+    if (_tokens < 1.0)
+    {
+        return false;
+    }
+    _tokens -= 1.0;
+    return true;
+}
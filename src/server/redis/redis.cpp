@@ -1,7 +1,15 @@
 #include "redis.hpp"
 #include <iostream>
+#include <cstring>
+#include <string>
 using namespace std;
 
+// 节点通道名前缀，用户通道直接使用userid作为通道名
+static const char *NODE_CHANNEL_PREFIX = "node:";
+
+// 保存用户路由的哈希表
+static const char *ROUTE_KEY = "chat:route";
+
 Redis::Redis()
     : _publish_context(nullptr), _subscribe_context(nullptr)
 {
@@ -52,7 +60,8 @@ bool Redis::connect()
 // 向redis指定的通道channel发布消息
 bool Redis::publish(int channel, string message)
 {
-    redisReply *reply = (redisReply *)redisCommand(_publish_context, "PUBLISH %d %s", channel, message.c_str());
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "PUBLISH %d %b", channel, message.data(), message.size());
     // redisCommand第二个参数往后应该是构造一个redis的publish命令
     if (nullptr == reply)
     {
@@ -63,15 +72,44 @@ bool Redis::publish(int channel, string message)
     return true;
 }
 
-// 向redis指定的通道subscribe订阅消息
-bool Redis::subscribe(int channel)
+// 批量发布消息，先把所有命令追加到输出缓冲区，再逐个读取响应，只有一次网络往返
+bool Redis::publishBatch(const vector<pair<int, string>> &messages)
 {
-    // SUBSCRIBE命令本身会造成线程阻塞等待通道里面发生消息，这里只做订阅通道，不接收通道消息
-    // 通道消息的接收专门在observer_channel_message函数中的独立线程中进行
-    // 只负责发送命令，不阻塞接收redis server响应消息，否则和notifyMsg线程抢占响应资源
-    if (REDIS_ERR == redisAppendCommand(this->_subscribe_context, "SUBSCRIBE %d", channel))
+    lock_guard<mutex> lock(_publish_mutex);
+    for (const auto &msg : messages)
+    {
+        if (REDIS_ERR == redisAppendCommand(_publish_context, "PUBLISH %d %b", msg.first, msg.second.data(), msg.second.size()))
+        {
+            cerr << "publish command failed!" << endl;
+            return false;
+        }
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < messages.size(); ++i)
     {
-        cerr << "subscribe command failed!" << endl;
+        redisReply *reply = nullptr;
+        if (REDIS_OK != redisGetReply(_publish_context, (void **)&reply))
+        {
+            cerr << "publish command failed!" << endl;
+            return false;
+        }
+        if (reply != nullptr)
+        {
+            ok = ok && reply->type != REDIS_REPLY_ERROR;
+            freeReplyObject(reply);
+        }
+    }
+    return ok;
+}
+
+// 通过订阅上下文发送命令，只负责写出，不阻塞接收redis server的响应
+bool Redis::writeSubscribeCommand(const char *format, const char *channel)
+{
+    lock_guard<mutex> lock(_subscribe_mutex);
+    if (REDIS_ERR == redisAppendCommand(this->_subscribe_context, format, channel))
+    {
+        cerr << format << " command failed!" << endl;
         return false;
     }
     // redisBufferWrite可以循环发送缓冲区，直到缓冲区数据发送完毕（done被置为1）
@@ -80,47 +118,183 @@ bool Redis::subscribe(int channel)
     {
         if (REDIS_ERR == redisBufferWrite(this->_subscribe_context, &done))
         {
-            cerr << "subscribe command failed!" << endl;
+            cerr << format << " command failed!" << endl;
             return false;
         }
     }
-    // redisGetReply
-
     return true;
 }
 
+// 向redis指定的通道subscribe订阅消息
+bool Redis::subscribe(int channel)
+{
+    // SUBSCRIBE命令本身会造成线程阻塞等待通道里面发生消息，这里只做订阅通道，不接收通道消息
+    // 通道消息的接收专门在observer_channel_message函数中的独立线程中进行
+    // 只负责发送命令，不阻塞接收redis server响应消息，否则和notifyMsg线程抢占响应资源
+    return writeSubscribeCommand("SUBSCRIBE %s", to_string(channel).c_str());
+}
+
 // 向redis指定的通道unsubscribe取消订阅消息
 bool Redis::unsubscribe(int channel)
 {
-    if (REDIS_ERR == redisAppendCommand(this->_subscribe_context, "UNSUBSCRIBE %d", channel))
+    return writeSubscribeCommand("UNSUBSCRIBE %s", to_string(channel).c_str());
+}
+
+// 订阅节点通道
+bool Redis::subscribeNode(int nodeid)
+{
+    return writeSubscribeCommand("SUBSCRIBE %s", (NODE_CHANNEL_PREFIX + to_string(nodeid)).c_str());
+}
+
+// 向节点通道发布消息
+bool Redis::publishNode(int nodeid, string message)
+{
+    string channel = NODE_CHANNEL_PREFIX + to_string(nodeid);
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "PUBLISH %s %b", channel.c_str(), message.data(), message.size());
+    if (nullptr == reply)
     {
-        cerr << "unsubscribe command failed!" << endl;
+        cerr << "publish command failed!" << endl;
         return false;
     }
-    // redisBufferWrite可以循环发送缓冲区，直到缓冲区数据发送完毕（done被置为1）
-    int done = 0;
-    while (!done)
+    freeReplyObject(reply);
+    return true;
+}
+
+// 记录userid用户登录在nodeid节点上
+bool Redis::setRoute(int userid, int nodeid)
+{
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "HSET %s %d %d", ROUTE_KEY, userid, nodeid);
+    if (nullptr == reply)
     {
-        if (REDIS_ERR == redisBufferWrite(this->_subscribe_context, &done))
+        cerr << "hset command failed!" << endl;
+        return false;
+    }
+    freeReplyObject(reply);
+    return true;
+}
+
+// 删除userid用户的路由
+bool Redis::removeRoute(int userid)
+{
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "HDEL %s %d", ROUTE_KEY, userid);
+    if (nullptr == reply)
+    {
+        cerr << "hdel command failed!" << endl;
+        return false;
+    }
+    freeReplyObject(reply);
+    return true;
+}
+
+// 用一条HMGET批量查询用户所在的节点
+bool Redis::queryRoutes(const vector<int> &userids, vector<int> &nodeids)
+{
+    nodeids.assign(userids.size(), -1);
+    if (userids.empty())
+    {
+        return true;
+    }
+
+    vector<string> args;
+    args.reserve(userids.size() + 2);
+    args.push_back("HMGET");
+    args.push_back(ROUTE_KEY);
+    for (int userid : userids)
+    {
+        args.push_back(to_string(userid));
+    }
+    vector<const char *> argv;
+    vector<size_t> argvlen;
+    for (const string &arg : args)
+    {
+        argv.push_back(arg.data());
+        argvlen.push_back(arg.size());
+    }
+
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommandArgv(_publish_context, argv.size(), argv.data(), argvlen.data());
+    if (nullptr == reply)
+    {
+        cerr << "hmget command failed!" << endl;
+        return false;
+    }
+    bool ok = reply->type == REDIS_REPLY_ARRAY && reply->elements == userids.size();
+    if (ok)
+    {
+        for (size_t i = 0; i < reply->elements; ++i)
         {
-            cerr << "unsubscribe command failed!" << endl;
-            return false;
+            if (reply->element[i]->type == REDIS_REPLY_STRING)
+            {
+                nodeids[i] = atoi(reply->element[i]->str);
+            }
         }
     }
-    return true;
+    freeReplyObject(reply);
+    return ok;
+}
+
+// 分配groupid群组的下一个序号
+long long Redis::nextSequence(int groupid, long long floor)
+{
+    static const char *script =
+        "local v = redis.call('incr', KEYS[1]) "
+        "if v <= tonumber(ARGV[1]) then v = tonumber(ARGV[1]) + 1 redis.call('set', KEYS[1], v) end "
+        "return v";
+
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "EVAL %s 1 chat:gseq:%d %lld", script, groupid, floor);
+    if (nullptr == reply)
+    {
+        cerr << "eval command failed!" << endl;
+        return -1;
+    }
+    long long seq = reply->type == REDIS_REPLY_INTEGER ? reply->integer : -1;
+    freeReplyObject(reply);
+    return seq;
+}
+
+// 查询groupid群组最后分配的序号
+long long Redis::currentSequence(int groupid)
+{
+    lock_guard<mutex> lock(_publish_mutex);
+    redisReply *reply = (redisReply *)redisCommand(_publish_context, "GET chat:gseq:%d", groupid);
+    if (nullptr == reply)
+    {
+        cerr << "get command failed!" << endl;
+        return -1;
+    }
+    long long seq = reply->type == REDIS_REPLY_STRING ? atoll(reply->str) : (reply->type == REDIS_REPLY_NIL ? 0 : -1);
+    freeReplyObject(reply);
+    return seq;
 }
 
 // 在独立线程中接收订阅通道中的消息
 void Redis::observer_channel_message()
 {
+    size_t prefixLen = strlen(NODE_CHANNEL_PREFIX);
     redisReply *reply = nullptr;
     while (REDIS_OK == redisGetReply(this->_subscribe_context, (void **)&reply))
     {
         // 订阅收到的消息是一个带三元素的数组
-        if (reply != nullptr && reply->element[2] != nullptr && reply->element[2]->str != nullptr)
+        if (reply != nullptr && reply->elements == 3 && reply->element[2] != nullptr && reply->element[2]->str != nullptr)
         {
-            // 给业务层上报通道上发生的消息
-            _notify_message_handler(atoi(reply->element[1]->str) , reply->element[2]->str);
+            const char *channel = reply->element[1]->str;
+            string msg(reply->element[2]->str, reply->element[2]->len);
+            // 给业务层上报通道上发生的消息，节点通道和用户通道分别上报
+            if (strncmp(channel, NODE_CHANNEL_PREFIX, prefixLen) == 0)
+            {
+                if (_notify_node_handler)
+                {
+                    _notify_node_handler(atoi(channel + prefixLen), msg);
+                }
+            }
+            else
+            {
+                _notify_message_handler(atoi(channel), msg);
+            }
         }
 
         freeReplyObject(reply);
@@ -132,4 +306,9 @@ void Redis::observer_channel_message()
 void Redis::init_notify_handler(function<void(int,string)> fn)
 {
     this->_notify_message_handler = fn;
-}
\ No newline at end of file
+}
+
+void Redis::init_node_handler(function<void(int, string)> fn)
+{
+    this->_notify_node_handler = fn;
+}
@@ -0,0 +1,118 @@
+#include "historysearch.hpp"
+#include "idgenerator.hpp"
+#include "config.hpp"
+#include "json.hpp"
+#include <muduo/base/Logging.h>
+#include <algorithm>
+#include <chrono>
+using json = nlohmann::json;
+
+// 每次从history表读取的消息条数
+static const int SCAN_PAGE = 1000;
+
+HistorySearch::HistorySearch()
+    : _pollMs(max(Config::instance().getInt("search_poll_ms", 1000), 10)),
+      _retainMillis((int64_t)max(Config::instance().getInt("search_rebuild_hours", 168), 1) * 3600 * 1000),
+      _expireMillis((int64_t)max(Config::instance().getInt("search_expire_minutes", 60), 1) * 60 * 1000),
+      _lagIds(IdGenerator::fromMillis(Config::instance().getInt("search_lag_ms", 5000)) - IdGenerator::fromMillis(0)),
+      _quit(false)
+{
+    _watermark = cutoffId();
+    _thread = thread(&HistorySearch::run, this);
+}
+
+HistorySearch::~HistorySearch()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+}
+
+// 查询userid用户可以访问的消息
+vector<InvertedIndex::Hit> HistorySearch::search(int userid, const vector<int> &groups, const string &query, size_t limit)
+{
+    // 一对一聊天的会话号由双方的userid拼成，群聊的会话号为 -groupid
+    return _index.search(query, [&](int64_t convid) {
+        if (convid < 0)
+        {
+            return find(groups.begin(), groups.end(), static_cast<int>(-convid)) != groups.end();
+        }
+        return (convid >> 32) == userid || (convid & 0xFFFFFFFF) == userid;
+    }, limit);
+}
+
+// 当前时间往前search_rebuild_hours小时对应的消息id
+int64_t HistorySearch::cutoffId()
+{
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    return IdGenerator::fromMillis(now - _retainMillis);
+}
+
+// 后台线程，定时读取新消息，定期删除过期的消息
+void HistorySearch::run()
+{
+    auto lastExpire = chrono::steady_clock::now();
+    unique_lock<mutex> lock(_mutex);
+    while (!_quit)
+    {
+        lock.unlock();
+        size_t added = poll();
+        size_t removed = 0;
+        auto now = chrono::steady_clock::now();
+        if (now - lastExpire >= chrono::milliseconds(_expireMillis))
+        {
+            removed = _index.expire(cutoffId());
+            lastExpire = now;
+        }
+        lock.lock();
+
+        if (added > 0 || removed > 0)
+        {
+            LOG_DEBUG << "search index: " << _index.docCount() << " messages, " << added << " added, "
+                      << removed << " expired";
+        }
+        _cond.wait_for(lock, chrono::milliseconds(_pollMs), [this]() { return _quit; });
+    }
+}
+
+// 读取一次新消息
+size_t HistorySearch::poll()
+{
+    size_t added = 0;
+    int64_t after = max<int64_t>(_watermark - _lagIds, 0);
+    for (;;)
+    {
+        vector<HistoryMessage> page = _historyModel.scan(after, SCAN_PAGE);
+        for (HistoryMessage &msg : page)
+        {
+            if (!_recent.insert(msg.id).second)
+            {
+                continue;
+            }
+
+            // 只索引消息正文
+            json js = json::parse(msg.msg, nullptr, false);
+            if (js.is_object() && js.contains("msg") && js["msg"].is_string())
+            {
+                _index.add(msg.id, msg.convid, js["msg"].get<string>());
+                ++added;
+            }
+        }
+        if (!page.empty())
+        {
+            after = page.back().id;
+            _watermark = max(_watermark, after);
+        }
+        if ((int)page.size() < SCAN_PAGE)
+        {
+            break;
+        }
+    }
+
+    // 回退窗口之前的消息不会再被扫描到，不再需要去重
+    _recent.erase(_recent.begin(), _recent.lower_bound(_watermark - _lagIds));
+    return added;
+}
@@ -0,0 +1,384 @@
+#include "invertedindex.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+
+namespace
+{
+const size_t MAX_WORD_BYTES = 32;   // 过长的单词截断
+
+void putVarint(string &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint32_t getVarint(const char *&p)
+{
+    uint32_t value = 0;
+    int shift = 0;
+    while (static_cast<uint8_t>(*p) & 0x80)
+    {
+        value |= (static_cast<uint32_t>(*p) & 0x7F) << shift;
+        shift += 7;
+        ++p;
+    }
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(*p)) << shift;
+    ++p;
+    return value;
+}
+
+// 解码一个UTF-8字符，返回码点，非法字节返回0xFFFD并前进一个字节
+uint32_t nextCodepoint(const string &text, size_t &pos, size_t &len)
+{
+    uint8_t c = text[pos];
+    uint32_t cp;
+    size_t n;
+    if (c < 0x80)
+    {
+        cp = c;
+        n = 1;
+    }
+    else if ((c & 0xE0) == 0xC0)
+    {
+        cp = c & 0x1F;
+        n = 2;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        cp = c & 0x0F;
+        n = 3;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        cp = c & 0x07;
+        n = 4;
+    }
+    else
+    {
+        len = 1;
+        ++pos;
+        return 0xFFFD;
+    }
+
+    if (pos + n > text.size())
+    {
+        len = 1;
+        ++pos;
+        return 0xFFFD;
+    }
+    for (size_t i = 1; i < n; ++i)
+    {
+        uint8_t cc = text[pos + i];
+        if ((cc & 0xC0) != 0x80)
+        {
+            len = 1;
+            ++pos;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    len = n;
+    pos += n;
+    return cp;
+}
+
+// 中日韩文字，按二元组切分
+bool isCjk(uint32_t cp)
+{
+    return (cp >= 0x4E00 && cp <= 0x9FFF)       // 中日韩统一表意文字
+        || (cp >= 0x3400 && cp <= 0x4DBF)       // 扩展A
+        || (cp >= 0xF900 && cp <= 0xFAFF)       // 兼容表意文字
+        || (cp >= 0x3040 && cp <= 0x30FF)       // 平假名、片假名
+        || (cp >= 0xAC00 && cp <= 0xD7AF)       // 韩文音节
+        || (cp >= 0x20000 && cp <= 0x2FFFF);    // 扩展B及以后
+}
+}
+
+// 把text切分成词
+vector<string> InvertedIndex::tokenize(const string &text)
+{
+    vector<string> terms;
+    string word;
+    vector<string> run;     // 连续的中日韩文字
+
+    auto flushWord = [&]() {
+        if (!word.empty())
+        {
+            terms.push_back(word);
+            word.clear();
+        }
+    };
+    auto flushRun = [&]() {
+        for (size_t i = 0; i < run.size(); ++i)
+        {
+            terms.push_back(run[i]);
+            if (i + 1 < run.size())
+            {
+                terms.push_back(run[i] + run[i + 1]);
+            }
+        }
+        run.clear();
+    };
+
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t start = pos, len;
+        uint32_t cp = nextCodepoint(text, pos, len);
+        if (cp < 0x80 && isalnum(cp))
+        {
+            flushRun();
+            if (word.size() < MAX_WORD_BYTES)
+            {
+                word.push_back(static_cast<char>(tolower(cp)));
+            }
+        }
+        else if (isCjk(cp))
+        {
+            flushWord();
+            run.push_back(text.substr(start, len));
+        }
+        else
+        {
+            flushWord();
+            flushRun();
+        }
+    }
+    flushWord();
+    flushRun();
+    return terms;
+}
+
+// 加入一条消息
+void InvertedIndex::add(int64_t mid, int64_t convid, const string &text)
+{
+    vector<string> terms = tokenize(text);
+    if (terms.empty())
+    {
+        return;
+    }
+
+    // 统计词频
+    sort(terms.begin(), terms.end());
+    lock_guard<mutex> lock(_mutex);
+    uint32_t doc = _docs.size();
+    _docs.push_back({mid, convid, static_cast<uint32_t>(terms.size())});
+    _totalLength += terms.size();
+
+    for (size_t i = 0; i < terms.size();)
+    {
+        size_t j = i + 1;
+        while (j < terms.size() && terms[j] == terms[i])
+        {
+            ++j;
+        }
+
+        auto it = _postings.find(terms[i]);
+        if (it == _postings.end())
+        {
+            it = _postings.emplace(terms[i], Posting{string(), 0, 0}).first;
+            putVarint(it->second.bytes, doc);
+        }
+        else
+        {
+            putVarint(it->second.bytes, doc - it->second.lastDoc);
+        }
+        putVarint(it->second.bytes, j - i);
+        it->second.lastDoc = doc;
+        it->second.df++;
+        i = j;
+    }
+}
+
+// 删除消息id小于minMid的消息
+size_t InvertedIndex::expire(int64_t minMid)
+{
+    lock_guard<mutex> lock(_mutex);
+
+    // 保留的文档按原来的顺序重新编号，倒排表中的文档号仍然递增
+    const uint32_t REMOVED = UINT32_MAX;
+    vector<uint32_t> renumber(_docs.size(), REMOVED);
+    vector<Doc> docs;
+    uint64_t totalLength = 0;
+    for (size_t i = 0; i < _docs.size(); ++i)
+    {
+        if (_docs[i].mid >= minMid)
+        {
+            renumber[i] = docs.size();
+            docs.push_back(_docs[i]);
+            totalLength += _docs[i].length;
+        }
+    }
+    size_t removed = _docs.size() - docs.size();
+    if (removed == 0)
+    {
+        return 0;
+    }
+
+    for (auto it = _postings.begin(); it != _postings.end();)
+    {
+        Posting &posting = it->second;
+        const char *p = posting.bytes.data();
+        const char *end = p + posting.bytes.size();
+        string bytes;
+        uint32_t doc = 0, lastDoc = 0, df = 0;
+        while (p < end)
+        {
+            doc += getVarint(p);
+            uint32_t tf = getVarint(p);
+            if (renumber[doc] == REMOVED)
+            {
+                continue;
+            }
+            putVarint(bytes, df == 0 ? renumber[doc] : renumber[doc] - lastDoc);
+            putVarint(bytes, tf);
+            lastDoc = renumber[doc];
+            ++df;
+        }
+
+        if (df == 0)
+        {
+            it = _postings.erase(it);
+            continue;
+        }
+        posting.bytes.swap(bytes);
+        posting.lastDoc = lastDoc;
+        posting.df = df;
+        ++it;
+    }
+
+    _docs.swap(docs);
+    _totalLength = totalLength;
+    return removed;
+}
+
+// 查询包含query中所有词的消息
+vector<InvertedIndex::Hit> InvertedIndex::search(const string &query, const function<bool(int64_t)> &allow, size_t limit)
+{
+    vector<Hit> hits;
+    vector<string> terms = tokenize(query);
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+    if (terms.empty() || limit == 0)
+    {
+        return hits;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    vector<const Posting *> postings;
+    for (const string &term : terms)
+    {
+        auto it = _postings.find(term);
+        if (it == _postings.end())
+        {
+            return hits;
+        }
+        postings.push_back(&it->second);
+    }
+    // 从最短的倒排表开始求交集，候选集合只会越来越小
+    sort(postings.begin(), postings.end(), [](const Posting *a, const Posting *b) { return a->df < b->df; });
+
+    const double k1 = 1.2, b = 0.75;
+    double n = _docs.size();
+    double avgLength = static_cast<double>(_totalLength) / _docs.size();
+    auto bm25 = [&](const Posting *posting, uint32_t doc, uint32_t tf) {
+        double idf = log(1 + (n - posting->df + 0.5) / (posting->df + 0.5));
+        double norm = k1 * (1 - b + b * _docs[doc].length / avgLength);
+        return idf * tf * (k1 + 1) / (tf + norm);
+    };
+
+    // 候选文档和得分，按文档号有序；解码最短的倒排表时先做访问过滤，无权访问的消息不参与求交集和打分
+    vector<pair<uint32_t, double>> candidates;
+    for (size_t k = 0; k < postings.size(); ++k)
+    {
+        const Posting *posting = postings[k];
+        const char *p = posting->bytes.data();
+        const char *end = p + posting->bytes.size();
+        uint32_t doc = 0;
+        if (k == 0)
+        {
+            candidates.reserve(posting->df);
+            while (p < end)
+            {
+                doc += getVarint(p);
+                uint32_t tf = getVarint(p);
+                if (allow(_docs[doc].convid))
+                {
+                    candidates.push_back({doc, bm25(posting, doc, tf)});
+                }
+            }
+            if (candidates.empty())
+            {
+                return hits;
+            }
+            continue;
+        }
+
+        size_t keep = 0, c = 0;
+        while (p < end && c < candidates.size())
+        {
+            doc += getVarint(p);
+            uint32_t tf = getVarint(p);
+            while (c < candidates.size() && candidates[c].first < doc)
+            {
+                ++c;
+            }
+            if (c < candidates.size() && candidates[c].first == doc)
+            {
+                candidates[keep].first = doc;
+                candidates[keep].second = candidates[c].second + bm25(posting, doc, tf);
+                ++keep;
+                ++c;
+            }
+        }
+        candidates.resize(keep);
+        if (candidates.empty())
+        {
+            return hits;
+        }
+    }
+
+    hits.reserve(candidates.size());
+    for (auto &candidate : candidates)
+    {
+        const Doc &doc = _docs[candidate.first];
+        hits.push_back({doc.mid, doc.convid, candidate.second});
+    }
+
+    // 得分相同时较新的消息在前
+    auto better = [](const Hit &a, const Hit &b) { return a.score != b.score ? a.score > b.score : a.mid > b.mid; };
+    if (hits.size() > limit)
+    {
+        partial_sort(hits.begin(), hits.begin() + limit, hits.end(), better);
+        hits.resize(limit);
+    }
+    else
+    {
+        sort(hits.begin(), hits.end(), better);
+    }
+    return hits;
+}
+
+// 已索引的消息数
+size_t InvertedIndex::docCount()
+{
+    lock_guard<mutex> lock(_mutex);
+    return _docs.size();
+}
+
+// 倒排表占用的字节数
+size_t InvertedIndex::postingBytes()
+{
+    lock_guard<mutex> lock(_mutex);
+    size_t bytes = 0;
+    for (auto &posting : _postings)
+    {
+        bytes += posting.second.bytes.size();
+    }
+    return bytes;
+}
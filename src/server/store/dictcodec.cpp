@@ -0,0 +1,315 @@
+#include "dictcodec.hpp"
+#include <algorithm>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <cstring>
+
+namespace
+{
+const size_t MIN_ENTRY = 3;     // 字典项的最短长度，更短的片段替换后节省不了字节
+const size_t MAX_ENTRY = 48;    // 字典项的最长长度
+const size_t MAX_CANDIDATES = 8192;
+const char MASK = '\x01';       // 训练时标记已被字典项覆盖的字节
+
+uint16_t prefixOf(const char *p)
+{
+    return static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8);
+}
+
+bool hasControl(const string &text)
+{
+    for (unsigned char c : text)
+    {
+        if (c < 0x20)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// json的结构字符，片段从它们或紧跟它们的位置开始
+bool isBoundary(char c)
+{
+    return c == '{' || c == ',' || c == '"' || c == ':' || c == '[';
+}
+
+// 统计pattern在样本中不重叠出现的次数，已被覆盖的字节不会被匹配
+size_t countIn(const vector<string> &samples, const string &pattern)
+{
+    size_t count = 0;
+    for (const string &sample : samples)
+    {
+        for (size_t pos = sample.find(pattern); pos != string::npos; pos = sample.find(pattern, pos + pattern.size()))
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// 把pattern在样本中的出现标记为已覆盖
+void maskIn(vector<string> &samples, const string &pattern)
+{
+    for (string &sample : samples)
+    {
+        for (size_t pos = sample.find(pattern); pos != string::npos; pos = sample.find(pattern, pos + pattern.size()))
+        {
+            memset(&sample[pos], MASK, pattern.size());
+        }
+    }
+}
+}
+
+DictCodec::DictCodec(vector<string> entries)
+    : _entries(std::move(entries)), _start(65537, 0)
+{
+    if (_entries.size() > MAX_ENTRIES)
+    {
+        _entries.resize(MAX_ENTRIES);
+    }
+    for (size_t i = 0; i < _entries.size(); ++i)
+    {
+        if (_entries[i].size() >= 2)
+        {
+            _order.push_back(i);
+        }
+    }
+    sort(_order.begin(), _order.end(), [this](uint8_t a, uint8_t b) {
+        uint16_t pa = prefixOf(_entries[a].data()), pb = prefixOf(_entries[b].data());
+        return pa != pb ? pa < pb : _entries[a].size() > _entries[b].size();
+    });
+    for (uint8_t index : _order)
+    {
+        _start[prefixOf(_entries[index].data()) + 1]++;
+    }
+    for (size_t k = 1; k < _start.size(); ++k)
+    {
+        _start[k] += _start[k - 1];
+    }
+}
+
+// 从样本中训练字典
+// 候选片段从json结构字符处或紧跟它们的位置开始，至少出现在1%的样本中，
+// 按 出现次数 * (长度 - 2) 估算节省的字节数，贪心选取：
+// 选中一项后把它在样本中的出现标记为已覆盖，其他候选的实际收益只会变小，
+// 因此每次取出估算收益最大的候选重新计数，仍然不小于下一个候选的估算值时才选中
+vector<string> DictCodec::train(const vector<string> &samples, size_t maxEntries)
+{
+    vector<string> work;
+    for (const string &sample : samples)
+    {
+        if (!hasControl(sample))
+        {
+            work.push_back(sample);
+        }
+    }
+
+    // 逐层统计片段的出现次数：长度为len的片段出现次数不会超过它的前缀，
+    // 前缀不够常见的位置不再向后延长，唯一的内容（id、时间等）很快就被淘汰
+    size_t minCount = max<size_t>(2, work.size() / 100);
+    using Candidate = pair<size_t, string>;     // <估算节省的字节数, 片段>
+    vector<Candidate> pool;
+    vector<pair<uint32_t, uint32_t>> positions;    // <样本, 起始位置>
+    for (uint32_t s = 0; s < work.size(); ++s)
+    {
+        for (uint32_t i = 0; i + MIN_ENTRY <= work[s].size(); ++i)
+        {
+            if (isBoundary(work[s][i]) || (i > 0 && isBoundary(work[s][i - 1])))
+            {
+                positions.push_back({s, i});
+            }
+        }
+    }
+    for (size_t len = 2; len <= MAX_ENTRY && !positions.empty(); ++len)
+    {
+        unordered_map<string_view, size_t> counts;
+        for (auto &pos : positions)
+        {
+            counts[string_view(work[pos.first].data() + pos.second, len)]++;
+        }
+
+        size_t keep = 0;
+        for (auto &pos : positions)
+        {
+            if (counts[string_view(work[pos.first].data() + pos.second, len)] >= minCount &&
+                pos.second + len < work[pos.first].size())
+            {
+                positions[keep++] = pos;
+            }
+        }
+        positions.resize(keep);
+
+        if (len >= MIN_ENTRY)
+        {
+            for (auto &item : counts)
+            {
+                if (item.second >= minCount)
+                {
+                    pool.push_back({item.second * (len - 2), string(item.first)});
+                }
+            }
+        }
+    }
+
+    if (pool.size() > MAX_CANDIDATES)
+    {
+        nth_element(pool.begin(), pool.begin() + MAX_CANDIDATES, pool.end(),
+                    [](const Candidate &a, const Candidate &b) { return a.first > b.first; });
+        pool.resize(MAX_CANDIDATES);
+    }
+    priority_queue<Candidate> heap(pool.begin(), pool.end());
+    pool.clear();
+
+    vector<Candidate> chosen;
+    while (!heap.empty() && chosen.size() < min(maxEntries, MAX_ENTRIES))
+    {
+        Candidate top = heap.top();
+        heap.pop();
+        size_t count = countIn(work, top.second);
+        size_t saving = count < minCount ? 0 : count * (top.second.size() - 2);
+        if (saving == 0)
+        {
+            continue;
+        }
+        if (!heap.empty() && saving < heap.top().first)
+        {
+            heap.push({saving, std::move(top.second)});
+            continue;
+        }
+        maskIn(work, top.second);
+        chosen.push_back({saving, std::move(top.second)});
+    }
+
+    // 收益最大的项使用单字节编号
+    stable_sort(chosen.begin(), chosen.end(), [](const Candidate &a, const Candidate &b) { return a.first > b.first; });
+    vector<string> entries;
+    for (Candidate &c : chosen)
+    {
+        entries.push_back(std::move(c.second));
+    }
+    return entries;
+}
+
+// 编码，每个位置取最长的匹配项
+bool DictCodec::encode(const string &input, string &out) const
+{
+    const char *p = input.data();
+    const char *end = p + input.size();
+    out.reserve(out.size() + input.size());
+    while (p < end)
+    {
+        unsigned char c = *p;
+        if (c < 0x20)
+        {
+            return false;
+        }
+
+        int match = -1;
+        if (end - p >= 2)
+        {
+            uint16_t prefix = prefixOf(p);
+            for (uint16_t k = _start[prefix]; k < _start[prefix + 1]; ++k)
+            {
+                const string &entry = _entries[_order[k]];
+                if (static_cast<size_t>(end - p) >= entry.size() && memcmp(p, entry.data(), entry.size()) == 0)
+                {
+                    match = _order[k];
+                    break;
+                }
+            }
+        }
+
+        if (match < 0)
+        {
+            out.push_back(*p++);
+        }
+        else if (match < static_cast<int>(SHORT_CODES))
+        {
+            out.push_back(static_cast<char>(0x01 + match));
+            p += _entries[match].size();
+        }
+        else
+        {
+            out.push_back('\x1F');
+            out.push_back(static_cast<char>(0x20 + match - SHORT_CODES));
+            p += _entries[match].size();
+        }
+    }
+    return true;
+}
+
+// 解码
+bool DictCodec::decode(const char *data, size_t len, string &out) const
+{
+    const char *p = data;
+    const char *end = data + len;
+    out.reserve(out.size() + len * 2);
+    while (p < end)
+    {
+        unsigned char c = *p++;
+        size_t index;
+        if (c >= 0x20)
+        {
+            out.push_back(static_cast<char>(c));
+            continue;
+        }
+        else if (c >= 0x01 && c < 0x1F)
+        {
+            index = c - 0x01;
+        }
+        else if (c == 0x1F && p < end && static_cast<unsigned char>(*p) >= 0x20)
+        {
+            index = SHORT_CODES + static_cast<unsigned char>(*p++) - 0x20;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (index >= _entries.size())
+        {
+            return false;
+        }
+        out.append(_entries[index]);
+    }
+    return true;
+}
+
+// 字典的序列化形式
+string DictCodec::serialize() const
+{
+    string text;
+    for (size_t i = 0; i < _entries.size(); ++i)
+    {
+        if (i != 0)
+        {
+            text.push_back('\n');
+        }
+        text.append(_entries[i]);
+    }
+    return text;
+}
+
+vector<string> DictCodec::deserialize(const string &text)
+{
+    vector<string> entries;
+    if (text.empty())
+    {
+        return entries;
+    }
+    size_t pos = 0;
+    for (;;)
+    {
+        size_t end = text.find('\n', pos);
+        if (end == string::npos)
+        {
+            entries.push_back(text.substr(pos));
+            break;
+        }
+        entries.push_back(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return entries;
+}
@@ -0,0 +1,906 @@
+#include "logstore.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+const size_t HEADER_BYTES = 8;          // 长度 + crc32
+const size_t BODY_HEADER_BYTES = 16;    // 类型 + 填充 + userid + 序号
+
+uint32_t crc32(const char *data, size_t len)
+{
+    static const vector<uint32_t> table = []() {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+// 编码一条完整的记录
+string encodeRecord(int type, int userid, uint64_t seq, const string &msg)
+{
+    uint32_t len = BODY_HEADER_BYTES + msg.size();
+    string data(HEADER_BYTES + len, '\0');
+    char *body = &data[HEADER_BYTES];
+    body[0] = static_cast<char>(type);
+    memcpy(body + 4, &userid, sizeof(userid));
+    memcpy(body + 8, &seq, sizeof(seq));
+    memcpy(body + BODY_HEADER_BYTES, msg.data(), msg.size());
+
+    uint32_t crc = crc32(body, len);
+    memcpy(&data[0], &len, sizeof(len));
+    memcpy(&data[4], &crc, sizeof(crc));
+    return data;
+}
+
+// 写满len个字节
+bool pwriteAll(int fd, const char *data, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::pwrite(fd, data, len, offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+}
+
+LogStore::LogStore(const string &dir, size_t segmentBytes)
+    : _dir(dir), _segmentBytes(segmentBytes), _activeSegment(1), _activeSize(0), _nextSeq(1),
+      _appendLsn(0), _durableLsn(0), _quit(false), _sealedBelow(0), _compactQuit(false)
+{
+    _sync = Config::instance().getInt("offline_log_fsync", 1) != 0;
+    _compactPercent = Config::instance().getInt("offline_log_compact_percent", 50);
+}
+
+LogStore::~LogStore()
+{
+    // 先停止压缩线程，它可能正在等待刷盘
+    {
+        lock_guard<mutex> lock(_compactMutex);
+        _compactQuit = true;
+    }
+    _compactCond.notify_all();
+    if (_compactThread.joinable())
+    {
+        _compactThread.join();
+    }
+
+    // 刷盘线程写完缓冲区中剩余的记录再退出
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        _quit = true;
+    }
+    _flushCond.notify_all();
+    if (_flushThread.joinable())
+    {
+        _flushThread.join();
+    }
+
+    for (auto &entry : _segments)
+    {
+        if (entry.second.map != nullptr)
+        {
+            munmap(entry.second.map, entry.second.mapped);
+        }
+        if (entry.second.fd >= 0)
+        {
+            ::close(entry.second.fd);
+        }
+    }
+}
+
+string LogStore::segmentPath(uint32_t id) const
+{
+    char name[64] = {0};
+    snprintf(name, sizeof(name), "/segment-%08u.log", id);
+    return _dir + name;
+}
+
+// 打开日志目录，恢复索引，启动后台线程
+bool LogStore::open()
+{
+    if (mkdir(_dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        LOG_ERROR << "create offline log dir " << _dir << " failed: " << strerror(errno);
+        return false;
+    }
+
+    DIR *dir = opendir(_dir.c_str());
+    if (dir == nullptr)
+    {
+        LOG_ERROR << "open offline log dir " << _dir << " failed: " << strerror(errno);
+        return false;
+    }
+    vector<uint32_t> ids;
+    while (struct dirent *entry = readdir(dir))
+    {
+        uint32_t id;
+        char tail;
+        if (sscanf(entry->d_name, "segment-%u.lo%c", &id, &tail) == 2 && tail == 'g')
+        {
+            ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    sort(ids.begin(), ids.end());
+
+    // 按段的顺序扫描所有记录，DEL记录删除该用户序号更小的消息，和它在哪个段中无关
+    lock_guard<mutex> lock(_indexMutex);
+    unordered_map<int, uint64_t> deleted;
+    vector<pair<int, Location>> puts;
+    uint64_t maxSeq = 0;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (!recoverSegment(ids[i], i + 1 == ids.size(), deleted, puts, maxSeq))
+        {
+            return false;
+        }
+    }
+    for (auto &put : puts)
+    {
+        auto it = deleted.find(put.first);
+        if (it != deleted.end() && put.second.seq < it->second)
+        {
+            continue;
+        }
+        _inbox[put.first].push_back(put.second);
+    }
+    // 压缩搬移过的消息在后面的段中，按序号恢复收件箱中的顺序
+    // 搬移后删除旧段前崩溃时同一个序号有两份，只保留搬移后的一份
+    for (auto &box : _inbox)
+    {
+        vector<Location> &locs = box.second;
+        sort(locs.begin(), locs.end(), [](const Location &a, const Location &b) {
+            return a.seq != b.seq ? a.seq < b.seq : a.segment > b.segment;
+        });
+        locs.erase(unique(locs.begin(), locs.end(),
+                          [](const Location &a, const Location &b) { return a.seq == b.seq; }),
+                   locs.end());
+        for (const Location &loc : locs)
+        {
+            _segments[loc.segment].live++;
+        }
+    }
+    LOG_INFO << "offline log recovered " << ids.size() << " segments, " << puts.size() << " records";
+
+    _nextSeq = maxSeq + 1;
+    if (ids.empty())
+    {
+        _activeSegment = 1;
+        _activeSize = 0;
+    }
+    else if (_segments[ids.back()].size >= _segmentBytes)
+    {
+        _activeSegment = ids.back() + 1;
+        _activeSize = 0;
+    }
+    else
+    {
+        _activeSegment = ids.back();
+        _activeSize = _segments[ids.back()].size;
+    }
+    _sealedBelow = _activeSegment;
+
+    _flushThread = thread(&LogStore::flushLoop, this);
+    _compactThread = thread(&LogStore::compactLoop, this);
+    return true;
+}
+
+// 扫描一个段文件恢复记录
+bool LogStore::recoverSegment(uint32_t id, bool last, unordered_map<int, uint64_t> &deleted,
+                              vector<pair<int, Location>> &puts, uint64_t &maxSeq)
+{
+    Segment *seg = openSegmentLocked(id);
+    if (seg == nullptr || !mapSegmentLocked(*seg, seg->size))
+    {
+        return false;
+    }
+
+    size_t offset = 0;
+    while (offset + HEADER_BYTES <= seg->size)
+    {
+        const char *record = seg->map + offset;
+        uint32_t len, crc;
+        memcpy(&len, record, sizeof(len));
+        memcpy(&crc, record + 4, sizeof(crc));
+        if (len < BODY_HEADER_BYTES || offset + HEADER_BYTES + len > seg->size ||
+            crc32(record + HEADER_BYTES, len) != crc)
+        {
+            break;
+        }
+
+        const char *body = record + HEADER_BYTES;
+        int userid;
+        uint64_t seq;
+        memcpy(&userid, body + 4, sizeof(userid));
+        memcpy(&seq, body + 8, sizeof(seq));
+        if (body[0] == RECORD_PUT)
+        {
+            Location loc = {id, static_cast<uint32_t>(offset + HEADER_BYTES + BODY_HEADER_BYTES),
+                            static_cast<uint32_t>(len - BODY_HEADER_BYTES), seq};
+            puts.push_back({userid, loc});
+            seg->records++;
+        }
+        else if (body[0] == RECORD_DEL)
+        {
+            uint64_t &del = deleted[userid];
+            del = max(del, seq);
+            seg->tombstones++;
+        }
+        maxSeq = max(maxSeq, seq);
+        offset += HEADER_BYTES + len;
+    }
+
+    if (offset < seg->size)
+    {
+        // 写到一半时崩溃，只有最后一个段的尾部会出现不完整的记录
+        LOG_ERROR << "offline log segment " << id << " corrupted at offset " << offset
+                  << (last ? ", truncated" : ", rest of the segment ignored");
+        if (last)
+        {
+            if (ftruncate(seg->fd, offset) != 0)
+            {
+                LOG_ERROR << "truncate offline log segment " << id << " failed: " << strerror(errno);
+                return false;
+            }
+            seg->size = offset;
+        }
+    }
+    return true;
+}
+
+// 打开（必要时创建）段文件
+LogStore::Segment *LogStore::openSegmentLocked(uint32_t id)
+{
+    auto it = _segments.find(id);
+    if (it != _segments.end() && it->second.fd >= 0)
+    {
+        return &it->second;
+    }
+
+    string path = segmentPath(id);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR << "open offline log segment " << path << " failed: " << strerror(errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    Segment &seg = _segments[id];
+    seg.fd = fd;
+    seg.size = st.st_size;
+    return &seg;
+}
+
+// 保证段的映射覆盖[0, end)
+// 一次映射整个段的最大长度，当前段写入新记录后不需要重新映射，只访问已经写入的部分
+bool LogStore::mapSegmentLocked(Segment &seg, size_t end)
+{
+    if (end <= seg.mapped)
+    {
+        return true;
+    }
+    if (seg.map != nullptr)
+    {
+        munmap(seg.map, seg.mapped);
+        seg.map = nullptr;
+        seg.mapped = 0;
+    }
+
+    size_t length = max(seg.size, _segmentBytes);
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, seg.fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        LOG_ERROR << "mmap offline log segment failed: " << strerror(errno);
+        return false;
+    }
+    seg.map = static_cast<char *>(addr);
+    seg.mapped = length;
+    return end <= seg.mapped;
+}
+
+// 关闭并删除段文件
+void LogStore::dropSegmentLocked(uint32_t id)
+{
+    auto it = _segments.find(id);
+    if (it == _segments.end())
+    {
+        return;
+    }
+    if (it->second.map != nullptr)
+    {
+        munmap(it->second.map, it->second.mapped);
+    }
+    if (it->second.fd >= 0)
+    {
+        ::close(it->second.fd);
+    }
+    ::unlink(segmentPath(id).c_str());
+    _segments.erase(it);
+}
+
+// 追加一条记录到缓冲区
+uint64_t LogStore::appendLocked(RecordType type, int userid, uint64_t seq, const string &msg, bool moved)
+{
+    string data = encodeRecord(type, userid, seq, msg);
+    if (_activeSize > 0 && _activeSize + data.size() > _segmentBytes)
+    {
+        // 当前段写满，换新段
+        ++_activeSegment;
+        _activeSize = 0;
+    }
+
+    Pending pending = {_activeSegment, static_cast<uint32_t>(_activeSize), type, userid, seq, moved, ++_appendLsn,
+                       std::move(data)};
+    _activeSize += pending.data.size();
+    _pending.push_back(std::move(pending));
+    return _appendLsn;
+}
+
+// 写入失败后换新段，缓冲区中的记录按顺序重新分配位置
+void LogStore::sealActiveLocked()
+{
+    ++_activeSegment;
+    _activeSize = 0;
+    for (Pending &pending : _pending)
+    {
+        if (_activeSize > 0 && _activeSize + pending.data.size() > _segmentBytes)
+        {
+            ++_activeSegment;
+            _activeSize = 0;
+        }
+        pending.segment = _activeSegment;
+        pending.offset = static_cast<uint32_t>(_activeSize);
+        _activeSize += pending.data.size();
+    }
+}
+
+// 等待编号last之前的记录全部落盘
+bool LogStore::waitDurable(uint64_t first, uint64_t last)
+{
+    unique_lock<mutex> lock(_writeMutex);
+    _durableCond.wait(lock, [this, last]() { return _durableLsn >= last; });
+    for (auto &range : _failed)
+    {
+        if (range.first <= last && first <= range.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 存储用户的离线消息
+bool LogStore::insert(int userid, string msg)
+{
+    uint64_t lsn;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        lsn = appendLocked(RECORD_PUT, userid, _nextSeq++, msg, false);
+    }
+    _flushCond.notify_one();
+    return waitDurable(lsn, lsn);
+}
+
+// 批量存储离线消息
+bool LogStore::insert(const vector<pair<int, string>> &msgs)
+{
+    if (msgs.empty())
+    {
+        return true;
+    }
+
+    uint64_t first = 0;
+    uint64_t lsn = 0;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        for (const auto &msg : msgs)
+        {
+            lsn = appendLocked(RECORD_PUT, msg.first, _nextSeq++, msg.second, false);
+            first = first == 0 ? lsn : first;
+        }
+    }
+    _flushCond.notify_one();
+    return waitDurable(first, lsn);
+}
+
+// 删除用户的离线消息
+bool LogStore::remove(int userid)
+{
+    uint64_t lsn;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        lsn = appendLocked(RECORD_DEL, userid, _nextSeq++, string(), false);
+    }
+    _flushCond.notify_one();
+    return waitDurable(lsn, lsn);
+}
+
+// 查询用户的离线消息
+vector<string> LogStore::query(int userid)
+{
+    vector<string> vec;
+    lock_guard<mutex> lock(_indexMutex);
+    auto it = _inbox.find(userid);
+    if (it == _inbox.end())
+    {
+        return vec;
+    }
+
+    vec.reserve(it->second.size());
+    for (const Location &loc : it->second)
+    {
+        Segment &seg = _segments[loc.segment];
+        if (mapSegmentLocked(seg, loc.offset + loc.length))
+        {
+            vec.emplace_back(seg.map + loc.offset, loc.length);
+        }
+    }
+    return vec;
+}
+
+// 读取并删除用户的离线消息
+// 删除记录的序号取读出的最大序号加1，只删除读出的消息，读取之后写入的消息保留到下次读取
+vector<string> LogStore::take(int userid)
+{
+    lock_guard<mutex> maintain(_maintainMutex);
+    vector<string> vec;
+    uint64_t last = 0;
+    {
+        lock_guard<mutex> lock(_indexMutex);
+        auto it = _inbox.find(userid);
+        if (it == _inbox.end())
+        {
+            return vec;
+        }
+        vec.reserve(it->second.size());
+        for (const Location &loc : it->second)
+        {
+            // 收件箱按序号排列，读取失败时只取走之前的消息
+            Segment &seg = _segments[loc.segment];
+            if (!mapSegmentLocked(seg, loc.offset + loc.length))
+            {
+                break;
+            }
+            vec.emplace_back(seg.map + loc.offset, loc.length);
+            last = loc.seq;
+        }
+    }
+    if (vec.empty())
+    {
+        return vec;
+    }
+
+    uint64_t lsn;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        lsn = appendLocked(RECORD_DEL, userid, last + 1, string(), false);
+    }
+    _flushCond.notify_one();
+    if (!waitDurable(lsn, lsn))
+    {
+        // 删除记录没有写入，消息仍在收件箱中，下次读取时再取走
+        LOG_ERROR << "remove offline messages of user " << userid << " failed";
+        vec.clear();
+    }
+    return vec;
+}
+
+// 刷盘线程，每次取走缓冲区中所有的记录，一次写入、一次fdatasync
+void LogStore::flushLoop()
+{
+    for (;;)
+    {
+        vector<Pending> batch;
+        uint64_t lsn;
+        {
+            unique_lock<mutex> lock(_writeMutex);
+            _flushCond.wait(lock, [this]() { return _quit || !_pending.empty(); });
+            if (_pending.empty())
+            {
+                break;
+            }
+            batch.swap(_pending);
+            lsn = _appendLsn;
+        }
+
+        bool ok = flushBatch(batch);
+
+        {
+            lock_guard<mutex> lock(_writeMutex);
+            if (!ok)
+            {
+                // 记录失败的范围供写入方查询，只保留最近的若干批，写入方在落盘进度推进后立即查询
+                _failed.push_back({batch.front().lsn, lsn});
+                if (_failed.size() > 1024)
+                {
+                    _failed.pop_front();
+                }
+                sealActiveLocked();
+            }
+            _durableLsn = lsn;
+        }
+        _durableCond.notify_all();
+    }
+}
+
+// 把一批记录写入段文件并落盘，然后更新索引
+bool LogStore::flushBatch(vector<Pending> &batch)
+{
+    // 同一个段中的记录是连续的，合并为一次写入
+    vector<pair<size_t, size_t>> runs;  // [begin, end)
+    vector<int> fds;
+    {
+        lock_guard<mutex> lock(_indexMutex);
+        for (size_t i = 0; i < batch.size();)
+        {
+            size_t j = i + 1;
+            while (j < batch.size() && batch[j].segment == batch[i].segment)
+            {
+                ++j;
+            }
+            Segment *seg = openSegmentLocked(batch[i].segment);
+            runs.push_back({i, j});
+            fds.push_back(seg == nullptr ? -1 : seg->fd);
+            i = j;
+        }
+    }
+
+    string buffer;
+    bool ok = true;
+    for (size_t r = 0; r < runs.size() && ok; ++r)
+    {
+        buffer.clear();
+        for (size_t i = runs[r].first; i < runs[r].second; ++i)
+        {
+            buffer += batch[i].data;
+        }
+        const Pending &first = batch[runs[r].first];
+        if (fds[r] < 0 || !pwriteAll(fds[r], buffer.data(), buffer.size(), first.offset))
+        {
+            LOG_ERROR << "write offline log segment " << first.segment << " failed: " << strerror(errno);
+            ok = false;
+        }
+        else if (_sync && fdatasync(fds[r]) != 0)
+        {
+            LOG_ERROR << "fdatasync offline log segment " << first.segment << " failed: " << strerror(errno);
+            ok = false;
+        }
+    }
+
+    if (!ok)
+    {
+        // 整批不进入索引，截断已经写入的部分，段文件中不留下没有索引的记录和空洞
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            const Pending &first = batch[runs[r].first];
+            if (fds[r] >= 0 && ftruncate(fds[r], first.offset) != 0)
+            {
+                LOG_ERROR << "truncate offline log segment " << first.segment << " failed: " << strerror(errno);
+            }
+        }
+        return false;
+    }
+
+    // 记录已经落盘，按写入顺序更新索引
+    vector<pair<int, uint64_t>> orphans;    // 搬移期间已被删除的消息
+    unique_lock<mutex> lock(_indexMutex);
+    for (Pending &pending : batch)
+    {
+        Segment &seg = _segments[pending.segment];
+        seg.size = max(seg.size, static_cast<size_t>(pending.offset) + pending.data.size());
+
+        if (pending.type == RECORD_DEL)
+        {
+            seg.tombstones++;
+            auto it = _inbox.find(pending.userid);
+            if (it == _inbox.end())
+            {
+                continue;
+            }
+            vector<Location> &box = it->second;
+            auto end = box.begin();
+            while (end != box.end() && end->seq < pending.seq)
+            {
+                _segments[end->segment].live--;
+                ++end;
+            }
+            box.erase(box.begin(), end);
+            if (box.empty())
+            {
+                _inbox.erase(it);
+            }
+            continue;
+        }
+
+        Location loc = {pending.segment, static_cast<uint32_t>(pending.offset + HEADER_BYTES + BODY_HEADER_BYTES),
+                        static_cast<uint32_t>(pending.data.size() - HEADER_BYTES - BODY_HEADER_BYTES), pending.seq};
+        seg.records++;
+        if (!pending.moved)
+        {
+            _inbox[pending.userid].push_back(loc);
+            seg.live++;
+            continue;
+        }
+
+        // 压缩搬移的消息，搬移期间可能已经被删除
+        bool found = false;
+        auto it = _inbox.find(pending.userid);
+        if (it != _inbox.end())
+        {
+            for (Location &old : it->second)
+            {
+                if (old.seq == pending.seq)
+                {
+                    _segments[old.segment].live--;
+                    old = loc;
+                    seg.live++;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found)
+        {
+            orphans.push_back({pending.userid, pending.seq});
+        }
+    }
+
+    // 缓冲区中尚未写入的记录都在本批最后一个段或之后的段中，之前的段不会再写入
+    _sealedBelow = batch.back().segment;
+    lock.unlock();
+
+    // 已被删除的消息搬移后落在删除记录之后的段中，删除记录所在的段被删除后它会在恢复时重新出现
+    // 在它之后补写一条只覆盖到它的删除记录，该用户序号更大的消息不受影响
+    if (!orphans.empty())
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        for (auto &orphan : orphans)
+        {
+            appendLocked(RECORD_DEL, orphan.first, orphan.second + 1, string(), false);
+        }
+    }
+    return true;
+}
+
+// 压缩一次最老的段
+bool LogStore::compact()
+{
+    struct Moved
+    {
+        int userid;
+        uint64_t seq;
+        string msg;
+    };
+
+    lock_guard<mutex> maintain(_maintainMutex);
+    uint32_t victim;
+    vector<Moved> moves;
+    uint64_t start;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        start = _appendLsn + 1;
+    }
+    {
+        lock_guard<mutex> lock(_indexMutex);
+
+        // 没有有效消息也没有删除记录的段可以直接删除
+        bool dropped = false;
+        for (auto it = _segments.begin(); it != _segments.end() && it->first < _sealedBelow;)
+        {
+            uint32_t id = it->first;
+            bool empty = it->second.live == 0 && it->second.tombstones == 0;
+            ++it;
+            if (empty)
+            {
+                dropSegmentLocked(id);
+                dropped = true;
+            }
+        }
+
+        // 删除记录可能作用于更老的段中的消息，所以只能从最老的段开始压缩
+        auto oldest = _segments.begin();
+        if (oldest == _segments.end() || oldest->first >= _sealedBelow)
+        {
+            return dropped;
+        }
+        Segment &seg = oldest->second;
+        if (seg.live > 0 && seg.live * 100 >= seg.records * _compactPercent)
+        {
+            return dropped;
+        }
+
+        victim = oldest->first;
+        if (seg.live > 0 && mapSegmentLocked(seg, seg.size))
+        {
+            for (auto &box : _inbox)
+            {
+                for (const Location &loc : box.second)
+                {
+                    if (loc.segment == victim)
+                    {
+                        moves.push_back({box.first, loc.seq, string(seg.map + loc.offset, loc.length)});
+                    }
+                }
+            }
+        }
+    }
+
+    // 有效消息保持原来的序号追加到当前段，落盘后索引指向新的位置
+    uint64_t lsn;
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        for (const Moved &moved : moves)
+        {
+            appendLocked(RECORD_PUT, moved.userid, moved.seq, moved.msg, true);
+        }
+        lsn = _appendLsn;
+    }
+    _flushCond.notify_one();
+    // 删除旧段之前，等待开始压缩以来追加的记录（包括搬移的消息和为它们补写的删除记录）全部落盘
+    // 补写的删除记录在搬移的消息落盘时追加，再等待一次覆盖它们
+    if (lsn >= start && !waitDurable(start, lsn))
+    {
+        return false;
+    }
+    {
+        lock_guard<mutex> lock(_writeMutex);
+        lsn = _appendLsn;
+    }
+    if (lsn >= start && !waitDurable(start, lsn))
+    {
+        return false;
+    }
+
+    lock_guard<mutex> lock(_indexMutex);
+    auto it = _segments.find(victim);
+    if (it == _segments.end() || it->second.live != 0)
+    {
+        return false;
+    }
+    LOG_INFO << "offline log segment " << victim << " compacted, " << moves.size() << " records moved";
+    dropSegmentLocked(victim);
+    return true;
+}
+
+// 删除最后一次写入早于cutoffMillis的段
+int LogStore::expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs)
+{
+    if (cutoffMillis <= 0)
+    {
+        return 0;
+    }
+
+    lock_guard<mutex> maintain(_maintainMutex);
+    lock_guard<mutex> lock(_indexMutex);
+    vector<uint32_t> expired;
+    for (auto &item : _segments)
+    {
+        struct stat st;
+        if (item.first >= _sealedBelow || ::fstat(item.second.fd, &st) != 0 ||
+            static_cast<int64_t>(st.st_mtime) * 1000 >= cutoffMillis)
+        {
+            break;
+        }
+        expired.push_back(item.first);
+    }
+    if (expired.empty())
+    {
+        return 0;
+    }
+
+    // 从收件箱中去掉这些段中的消息，并交回其中对共享内容的引用
+    size_t removed = 0;
+    for (auto it = _inbox.begin(); it != _inbox.end();)
+    {
+        vector<Location> &box = it->second;
+        size_t before = box.size();
+        box.erase(remove_if(box.begin(), box.end(),
+                            [&](const Location &loc)
+                            {
+                                if (loc.segment > expired.back())
+                                {
+                                    return false;
+                                }
+                                auto seg = _segments.find(loc.segment);
+                                if (loc.length == OFFLINE_REF_SIZE && seg != _segments.end() &&
+                                    mapSegmentLocked(seg->second, loc.offset + loc.length) &&
+                                    seg->second.map[loc.offset] == OFFLINE_PAYLOAD_REF)
+                                {
+                                    refs[string(seg->second.map + loc.offset + 1, OFFLINE_REF_SIZE - 1)]++;
+                                }
+                                return true;
+                            }),
+                  box.end());
+        removed += before - box.size();
+        if (box.empty())
+        {
+            it = _inbox.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (uint32_t id : expired)
+    {
+        dropSegmentLocked(id);
+    }
+    LOG_INFO << "offline log expired " << expired.size() << " segments, " << removed << " messages";
+    return expired.size();
+}
+
+// 各段保留的离线消息
+vector<PartitionInfo> LogStore::partitions()
+{
+    lock_guard<mutex> lock(_indexMutex);
+    vector<PartitionInfo> vec;
+    for (auto &item : _segments)
+    {
+        // 段中的消息都写入于最后修改时间之前
+        struct stat st;
+        int64_t bound = ::fstat(item.second.fd, &st) == 0 ? static_cast<int64_t>(st.st_mtime) * 1000 : 0;
+        vec.push_back({segmentPath(item.first).substr(_dir.size() + 1), bound, static_cast<int64_t>(item.second.live),
+                       static_cast<int64_t>(item.second.size)});
+    }
+    return vec;
+}
+
+// 压缩线程，每秒检查一次
+void LogStore::compactLoop()
+{
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(_compactMutex);
+            if (_compactCond.wait_for(lock, chrono::seconds(1), [this]() { return _compactQuit; }))
+            {
+                break;
+            }
+        }
+        while (compact())
+        {
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#include "mysqlofflinestore.hpp"
+#include "db.h"
+#include <muduo/base/Logging.h>
+#include <chrono>
+#include <climits>
+
+// 提前建立的日期分区数，写入总是落在已有的分区中，MAXVALUE分区保持为空
+static const int PARTITION_DAYS_AHEAD = 3;
+
+static int64_t nowMillis()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 存储用户的离线消息
+bool MySQLOfflineStore::insert(int userid, string msg)
+{
+    return insert({{userid, std::move(msg)}});
+}
+
+// 批量存储离线消息
+bool MySQLOfflineStore::insert(const vector<pair<int, string>> &msgs)
+{
+    if (msgs.empty())
+    {
+        return true;
+    }
+
+    MySQL mysql;
+    if (mysql.connect())
+    {
+        // 组装一条多行insert语句，消息内容需要转义，同一批消息使用同一个写入时间
+        string time = to_string(nowMillis());
+        string sql = "insert into offlinemessage values";
+        for (size_t i = 0; i < msgs.size(); ++i)
+        {
+            if (i != 0)
+            {
+                sql += ",";
+            }
+            sql += "(" + to_string(msgs[i].first) + ",'" + mysql.escape(msgs[i].second) + "'," + time + ")";
+        }
+        return mysql.update(sql);
+    }
+    return false;
+}
+
+// 删除用户的离线消息
+bool MySQLOfflineStore::remove(int userid)
+{
+    // 1. 组装sql语句
+    char sql[1024] = {0};
+    sprintf(sql, "delete from offlinemessage where userid = %d", userid);
+
+    MySQL mysql; // 定义一个mysql对象（这个MySQL类是我们自己定义的）
+    if (mysql.connect())
+    {
+        return mysql.update(sql);
+    }
+    return false;
+}
+
+// 查询用户的离线消息
+vector<string> MySQLOfflineStore::query(int userid)
+{
+    // 1. 组装sql语句
+    char sql[1024] = {0};
+    sprintf(sql, "select message from offlinemessage where userid = %d", userid);
+
+    vector<string> vec;
+    MySQL mysql; // 定义一个mysql对象（这个MySQL类是我们自己定义的）
+    if (mysql.connect())
+    {
+        MYSQL_RES *res = mysql.query(sql);
+        if (res != nullptr) {
+            // 把userid用户的所有消息放入vec中返回
+            MYSQL_ROW row;
+            while ((row = mysql_fetch_row(res)) != nullptr)
+            {   // 结果可能不止一行，所以一行一行地拿
+                // 每行就一个，就是message；压缩后的内容可能包含'\0'，按长度读取
+                vec.emplace_back(row[0], mysql_fetch_lengths(res)[0]);
+            }
+
+            mysql_free_result(res);     // 释放mysql资源
+            return vec;
+        }
+    }
+    return vec;
+}
+
+// 在一个事务中读取并删除用户的离线消息
+// select ... for update锁住该用户在userid索引上的范围，提交之前其他连接写入该用户的离线消息会等待，
+// 删除的正好是读出的消息；删除失败时回滚并返回空，消息留到下次上线再读取
+vector<string> MySQLOfflineStore::take(int userid)
+{
+    vector<string> vec;
+    MySQL mysql;
+    if (!mysql.connect() || !mysql.update("start transaction"))
+    {
+        return vec;
+    }
+
+    string where = " from offlinemessage where userid = " + to_string(userid);
+    MYSQL_RES *res = mysql.query("select message" + where + " for update");
+    if (res == nullptr)
+    {
+        mysql.update("rollback");
+        return vec;
+    }
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr)
+    {
+        unsigned long *lengths = mysql_fetch_lengths(res);
+        vec.emplace_back(row[0], lengths[0]);
+    }
+    mysql_free_result(res);
+    if (vec.empty())
+    {
+        mysql.update("rollback");
+        return vec;
+    }
+
+    if (!mysql.update("delete" + where) || !mysql.update("commit"))
+    {
+        LOG_ERROR << "remove offline messages of user " << userid << " failed";
+        mysql.update("rollback");
+        vec.clear();
+    }
+    return vec;
+}
+
+// 删除过期的日期分区
+int MySQLOfflineStore::expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs)
+{
+    // 分区的上界就是毫秒时间戳，与rotate删除的分区相同
+    string expired;
+    if (cutoffMillis > 0)
+    {
+        for (const PartitionInfo &partition : _partitionModel.query("offlinemessage"))
+        {
+            if (partition.bound != INT64_MAX && partition.bound <= cutoffMillis)
+            {
+                expired += (expired.empty() ? "" : ",") + partition.name;
+            }
+        }
+    }
+
+    // 删除分区之前，在一个事务中读出并删除其中对共享内容的引用，交回的引用不会再被take读到；
+    // 失败时不删除分区，引用留在表中，下次再处理
+    if (!expired.empty() && !takeRefs(expired, refs))
+    {
+        LOG_ERROR << "release offline payload references in partitions " << expired << " failed";
+        cutoffMillis = 0;
+    }
+    return _partitionModel.rotate("offlinemessage", PartitionModel::DAILY, [](int64_t millis) { return millis; },
+                                  nowMillis, cutoffMillis, PARTITION_DAYS_AHEAD);
+}
+
+// 读出并删除分区中对共享内容的引用
+bool MySQLOfflineStore::takeRefs(const string &partitions, unordered_map<string, int> &refs)
+{
+    MySQL mysql;
+    if (!mysql.connect() || !mysql.update("start transaction"))
+    {
+        return false;
+    }
+
+    string where = " from offlinemessage partition (" + partitions + ") where length(message) = " +
+                   to_string(OFFLINE_REF_SIZE) + " and left(message, 1) = " + to_string((int)OFFLINE_PAYLOAD_REF);
+    MYSQL_RES *res = mysql.query("select message" + where + " for update");
+    if (res == nullptr)
+    {
+        mysql.update("rollback");
+        return false;
+    }
+    unordered_map<string, int> taken;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr)
+    {
+        taken[string(row[0] + 1, OFFLINE_REF_SIZE - 1)]++;
+    }
+    mysql_free_result(res);
+
+    if (taken.empty())
+    {
+        mysql.update("rollback");
+        return true;
+    }
+    if (!mysql.update("delete" + where) || !mysql.update("commit"))
+    {
+        mysql.update("rollback");
+        return false;
+    }
+    for (auto &item : taken)
+    {
+        refs[item.first] += item.second;
+    }
+    return true;
+}
+
+// offlinemessage表的各分区
+vector<PartitionInfo> MySQLOfflineStore::partitions()
+{
+    return _partitionModel.query("offlinemessage");
+}
@@ -0,0 +1,47 @@
+#include "offlinestore.hpp"
+#include "mysqlofflinestore.hpp"
+#include "logstore.hpp"
+#include "redisofflinestore.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <memory>
+
+// 根据配置项offline_store创建离线消息存储
+static OfflineStore *createOfflineStore()
+{
+    string type = Config::instance().getString("offline_store", "mysql");
+    if (type == "log")
+    {
+        string dir = Config::instance().getString("offline_log_dir", "offline_log");
+        size_t segmentBytes = (size_t)Config::instance().getInt("offline_log_segment_mb", 64) << 20;
+        LogStore *store = new LogStore(dir, segmentBytes);
+        if (store->open())
+        {
+            return store;
+        }
+        LOG_ERROR << "open offline log " << dir << " failed, use mysql";
+        delete store;
+    }
+    else if (type == "redis")
+    {
+        RedisOfflineStore *store = new RedisOfflineStore();
+        if (store->connect())
+        {
+            return store;
+        }
+        LOG_ERROR << "connect offline redis failed, use mysql";
+        delete store;
+    }
+    else if (type != "mysql")
+    {
+        LOG_ERROR << "unknown offline store type: " << type << ", use mysql";
+    }
+    return new MySQLOfflineStore();
+}
+
+// 进程内唯一的离线消息存储
+OfflineStore *OfflineStore::instance()
+{
+    static unique_ptr<OfflineStore> store(createOfflineStore());
+    return store.get();
+}
@@ -0,0 +1,149 @@
+#include "payloadcodec.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <thread>
+
+static const char CODEC_BEGIN = '\x02';
+static const char CODEC_END = '\x03';
+
+PayloadCodec *PayloadCodec::instance()
+{
+    static PayloadCodec codec;
+    return &codec;
+}
+
+PayloadCodec::PayloadCodec()
+    : _enabled(Config::instance().getString("payload_codec", "dict") == "dict"),
+      _trainSamples(max(Config::instance().getInt("codec_train_samples", 2000), 100)),
+      _activeVersion(0), _collecting(false)
+{
+    lock_guard<mutex> lock(_mutex);
+    _activeVersion = loadLocked();
+    _collecting = _enabled && (_activeVersion == 0 || Config::instance().getInt("codec_retrain", 0) != 0);
+}
+
+// 读取字典表
+int PayloadCodec::loadLocked()
+{
+    int latest = 0;
+    for (auto &item : _dictModel.query())
+    {
+        if (_dicts.find(item.first) == _dicts.end())
+        {
+            _dicts[item.first] = make_shared<const DictCodec>(DictCodec::deserialize(item.second));
+        }
+        latest = max(latest, item.first);
+    }
+    return latest;
+}
+
+// 编码一条要存储的消息
+string PayloadCodec::encode(const string &payload)
+{
+    if (!_enabled)
+    {
+        return payload;
+    }
+
+    int version;
+    shared_ptr<const DictCodec> dict;
+    vector<string> samples;
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_collecting)
+        {
+            _samples.push_back(payload);
+            if (_samples.size() >= _trainSamples)
+            {
+                _collecting = false;
+                samples.swap(_samples);
+            }
+        }
+        version = _activeVersion;
+        if (version != 0)
+        {
+            dict = _dicts[version];
+        }
+    }
+    if (!samples.empty())
+    {
+        // 训练耗时几百毫秒，放到单独的线程中，期间的消息仍用原来的字典编码
+        thread(&PayloadCodec::train, this, std::move(samples)).detach();
+    }
+    if (!dict)
+    {
+        return payload;
+    }
+
+    string stored;
+    stored.push_back(CODEC_BEGIN);
+    stored += to_string(version);
+    stored.push_back(CODEC_END);
+    if (!dict->encode(payload, stored) || stored.size() >= payload.size())
+    {
+        return payload;
+    }
+    return stored;
+}
+
+// 解码一条存储的消息
+string PayloadCodec::decode(const string &stored)
+{
+    if (stored.empty() || stored[0] != CODEC_BEGIN)
+    {
+        return stored;
+    }
+
+    size_t end = stored.find(CODEC_END, 1);
+    if (end == string::npos)
+    {
+        LOG_ERROR << "invalid encoded payload";
+        return stored;
+    }
+    int version = atoi(stored.substr(1, end - 1).c_str());
+
+    shared_ptr<const DictCodec> dict;
+    {
+        lock_guard<mutex> lock(_mutex);
+        auto it = _dicts.find(version);
+        if (it == _dicts.end())
+        {
+            // 其他节点训练的新版本
+            loadLocked();
+            it = _dicts.find(version);
+        }
+        if (it != _dicts.end())
+        {
+            dict = it->second;
+        }
+    }
+
+    string payload;
+    if (!dict || !dict->decode(stored.data() + end + 1, stored.size() - end - 1, payload))
+    {
+        LOG_ERROR << "can not decode payload with dictionary version " << version;
+        return stored;
+    }
+    return payload;
+}
+
+// 用样本训练下一个版本的字典
+void PayloadCodec::train(vector<string> samples)
+{
+    DictCodec dict(DictCodec::train(samples));
+    if (dict.entries().empty())
+    {
+        LOG_INFO << "payload dictionary training found nothing to compress";
+        return;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    int version = loadLocked() + 1;
+    if (!_dictModel.insert(version, dict.serialize()))
+    {
+        LOG_INFO << "payload dictionary version " << version << " written by another server";
+    }
+    // 写入失败时使用字典表中该版本的字典，保证集群中同一版本的字典相同
+    _activeVersion = loadLocked();
+    LOG_INFO << "payload dictionary version " << _activeVersion << " active, " << dict.entries().size() << " entries";
+}
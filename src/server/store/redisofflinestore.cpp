@@ -0,0 +1,243 @@
+#include "redisofflinestore.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <unordered_map>
+
+// 离线消息列表的键名前缀
+static const string OFFLINE_KEY_PREFIX = "chat:offline:";
+
+static string offlineKey(int userid)
+{
+    return OFFLINE_KEY_PREFIX + to_string(userid);
+}
+
+RedisOfflineStore::RedisOfflineStore()
+    : _context(nullptr),
+      _maxPerUser(max(Config::instance().getInt("offline_redis_max", 1000), 1)),
+      _ttlSeconds((long long)max(Config::instance().getInt("offline_ttl_days", 30), 0) * 86400)
+{
+}
+
+RedisOfflineStore::~RedisOfflineStore()
+{
+    if (_context != nullptr)
+    {
+        redisFree(_context);
+    }
+}
+
+// 连接redis服务器
+bool RedisOfflineStore::connect()
+{
+    lock_guard<mutex> lock(_mutex);
+    return readyLocked();
+}
+
+// 保证连接可用
+bool RedisOfflineStore::readyLocked()
+{
+    if (_context != nullptr && _context->err == 0)
+    {
+        return true;
+    }
+    if (_context != nullptr)
+    {
+        LOG_ERROR << "offline redis connection error: " << _context->errstr << ", reconnect";
+        redisFree(_context);
+    }
+    _context = redisConnect("127.0.0.1", 6379);
+    if (_context == nullptr || _context->err != 0)
+    {
+        LOG_ERROR << "connect offline redis failed!";
+        return false;
+    }
+    return true;
+}
+
+// 读取管道中的count个响应
+bool RedisOfflineStore::drainLocked(size_t count)
+{
+    bool ok = true;
+    for (size_t i = 0; i < count; ++i)
+    {
+        redisReply *reply = nullptr;
+        if (REDIS_OK != redisGetReply(_context, (void **)&reply))
+        {
+            return false;
+        }
+        if (reply != nullptr)
+        {
+            ok = ok && reply->type != REDIS_REPLY_ERROR;
+            freeReplyObject(reply);
+        }
+    }
+    return ok;
+}
+
+// 存储用户的离线消息
+bool RedisOfflineStore::insert(int userid, string msg)
+{
+    return insert(vector<pair<int, string>>{{userid, std::move(msg)}});
+}
+
+// 批量存储离线消息
+bool RedisOfflineStore::insert(const vector<pair<int, string>> &msgs)
+{
+    if (msgs.empty())
+    {
+        return true;
+    }
+
+    // 按用户分组，保持每个用户的消息顺序
+    vector<int> userids;
+    unordered_map<int, vector<const string *>> inbox;
+    for (auto &msg : msgs)
+    {
+        auto &vec = inbox[msg.first];
+        if (vec.empty())
+        {
+            userids.push_back(msg.first);
+        }
+        vec.push_back(&msg.second);
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    if (!readyLocked())
+    {
+        LOG_ERROR << "drop " << msgs.size() << " offline messages, redis unavailable";
+        return false;
+    }
+
+    string trimStart = to_string(-_maxPerUser);
+    string ttl = to_string(_ttlSeconds);
+    for (int userid : userids)
+    {
+        string key = offlineKey(userid);
+        auto &vec = inbox[userid];
+        vector<const char *> argv;
+        vector<size_t> argvlen;
+        argv.reserve(vec.size() + 2);
+        argvlen.reserve(vec.size() + 2);
+        argv.push_back("RPUSH");
+        argvlen.push_back(5);
+        argv.push_back(key.data());
+        argvlen.push_back(key.size());
+        for (const string *msg : vec)
+        {
+            argv.push_back(msg->data());
+            argvlen.push_back(msg->size());
+        }
+        redisAppendCommandArgv(_context, argv.size(), argv.data(), argvlen.data());
+        redisAppendCommand(_context, "LTRIM %b %s -1", key.data(), key.size(), trimStart.c_str());
+        if (_ttlSeconds > 0)
+        {
+            redisAppendCommand(_context, "EXPIRE %b %s", key.data(), key.size(), ttl.c_str());
+        }
+    }
+
+    if (!drainLocked(userids.size() * (_ttlSeconds > 0 ? 3 : 2)))
+    {
+        LOG_ERROR << "store " << msgs.size() << " offline messages to redis failed";
+        return false;
+    }
+    return true;
+}
+
+// 删除用户的离线消息
+bool RedisOfflineStore::remove(int userid)
+{
+    string key = offlineKey(userid);
+    lock_guard<mutex> lock(_mutex);
+    if (!readyLocked())
+    {
+        return false;
+    }
+    redisReply *reply = (redisReply *)redisCommand(_context, "DEL %b", key.data(), key.size());
+    if (reply == nullptr)
+    {
+        return false;
+    }
+    bool ok = reply->type != REDIS_REPLY_ERROR;
+    freeReplyObject(reply);
+    return ok;
+}
+
+// 查询用户的离线消息
+vector<string> RedisOfflineStore::query(int userid)
+{
+    vector<string> vec;
+    string key = offlineKey(userid);
+    lock_guard<mutex> lock(_mutex);
+    if (!readyLocked())
+    {
+        return vec;
+    }
+    redisReply *reply = (redisReply *)redisCommand(_context, "LRANGE %b 0 -1", key.data(), key.size());
+    if (reply == nullptr)
+    {
+        return vec;
+    }
+    if (reply->type == REDIS_REPLY_ARRAY)
+    {
+        for (size_t i = 0; i < reply->elements; ++i)
+        {
+            vec.emplace_back(reply->element[i]->str, reply->element[i]->len);
+        }
+    }
+    freeReplyObject(reply);
+    return vec;
+}
+
+// 原子地读取并删除用户的离线消息，四条命令通过管道一次写出
+vector<string> RedisOfflineStore::take(int userid)
+{
+    vector<string> vec;
+    string key = offlineKey(userid);
+    lock_guard<mutex> lock(_mutex);
+    if (!readyLocked())
+    {
+        return vec;
+    }
+    redisAppendCommand(_context, "MULTI");
+    redisAppendCommand(_context, "LRANGE %b 0 -1", key.data(), key.size());
+    redisAppendCommand(_context, "DEL %b", key.data(), key.size());
+    redisAppendCommand(_context, "EXEC");
+
+    // MULTI和两条排队命令的响应，排队出错时EXEC也会失败，仍需读出EXEC的响应
+    bool queued = drainLocked(3);
+    redisReply *reply = nullptr;
+    if (REDIS_OK != redisGetReply(_context, (void **)&reply) || reply == nullptr)
+    {
+        LOG_ERROR << "take offline messages of user " << userid << " from redis failed";
+        return vec;
+    }
+    if (!queued)
+    {
+        LOG_ERROR << "take offline messages of user " << userid << " from redis failed";
+        freeReplyObject(reply);
+        return vec;
+    }
+    // EXEC的响应是 [LRANGE的结果, DEL的结果]
+    if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2 && reply->element[0]->type == REDIS_REPLY_ARRAY)
+    {
+        redisReply *range = reply->element[0];
+        for (size_t i = 0; i < range->elements; ++i)
+        {
+            vec.emplace_back(range->element[i]->str, range->element[i]->len);
+        }
+    }
+    freeReplyObject(reply);
+    return vec;
+}
+
+// 过期由redis的键过期完成
+int RedisOfflineStore::expire(int64_t nowMillis, int64_t cutoffMillis, unordered_map<string, int> &refs)
+{
+    return 0;
+}
+
+// redis中没有分区
+vector<PartitionInfo> RedisOfflineStore::partitions()
+{
+    return vector<PartitionInfo>();
+}
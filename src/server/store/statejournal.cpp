@@ -0,0 +1,612 @@
+#include "statejournal.hpp"
+#include "config.hpp"
+#include <muduo/base/Logging.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace
+{
+const size_t RECORD_BYTES = 24;         // crc32 + 类型 + 填充 + key + value
+const char SNAPSHOT_MAGIC[8] = {'C', 'H', 'A', 'T', 'S', 'N', 'P', '1'};
+const size_t SNAPSHOT_HEADER_BYTES = 16;    // 魔数 + 条目数
+
+uint32_t crc32(const char *data, size_t len)
+{
+    static const vector<uint32_t> table = []() {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+// 写满len个字节
+bool writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 读取整个文件
+bool readFile(const string &path, string &data)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    data.resize(st.st_size);
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t n = ::read(fd, &data[done], data.size() - done);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += n;
+    }
+    ::close(fd);
+    data.resize(done);
+    return true;
+}
+
+// 目录项落盘，保证rename和新建的文件在崩溃后可见
+void syncDir(const string &dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// 列出目录中形如 <prefix><代号><suffix> 的文件的代号
+vector<uint32_t> listGenerations(const string &dir, const char *pattern, char tail)
+{
+    vector<uint32_t> gens;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return gens;
+    }
+    while (struct dirent *entry = readdir(d))
+    {
+        uint32_t gen;
+        char c;
+        if (sscanf(entry->d_name, pattern, &gen, &c) == 2 && c == tail)
+        {
+            gens.push_back(gen);
+        }
+    }
+    closedir(d);
+    sort(gens.begin(), gens.end());
+    return gens;
+}
+}
+
+StateJournal::StateJournal(const string &dir, size_t snapshotBytes)
+    : _dir(dir), _snapshotBytes(snapshotBytes), _gen(1), _appendLsn(0), _durableLsn(0), _journalBytes(0),
+      _quit(false), _snapshotWanted(false), _fd(-1), _fdGen(0), _fdBytes(0)
+{
+    _sync = Config::instance().getInt("state_journal_fsync", 1) != 0;
+}
+
+StateJournal::~StateJournal()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _quit = true;
+    }
+    _snapshotCond.notify_all();
+    _flushCond.notify_all();
+    if (_snapshotThread.joinable())
+    {
+        _snapshotThread.join();
+    }
+    // 刷盘线程写完缓冲区中剩余的记录再退出
+    if (_flushThread.joinable())
+    {
+        _flushThread.join();
+    }
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+}
+
+string StateJournal::journalPath(uint32_t gen) const
+{
+    char name[64] = {0};
+    snprintf(name, sizeof(name), "/journal-%08u.log", gen);
+    return _dir + name;
+}
+
+string StateJournal::snapshotPath(uint32_t gen) const
+{
+    char name[64] = {0};
+    snprintf(name, sizeof(name), "/snapshot-%08u.snap", gen);
+    return _dir + name;
+}
+
+// 打开日志目录，载入快照并重放日志
+bool StateJournal::open()
+{
+    if (mkdir(_dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        LOG_ERROR << "create state journal dir " << _dir << " failed: " << strerror(errno);
+        return false;
+    }
+
+    // 从最新的快照开始尝试，写到一半的快照校验失败，退回到上一个
+    lock_guard<mutex> lock(_mutex);
+    vector<uint32_t> snapshots = listGenerations(_dir, "snapshot-%u.sna%c", 'p');
+    uint32_t snapGen = 0;
+    for (auto it = snapshots.rbegin(); it != snapshots.rend(); ++it)
+    {
+        if (loadSnapshot(*it))
+        {
+            snapGen = *it;
+            break;
+        }
+        LOG_ERROR << "state snapshot " << snapshotPath(*it) << " is corrupt, skip";
+    }
+
+    vector<uint32_t> journals = listGenerations(_dir, "journal-%u.lo%c", 'g');
+    journals.erase(remove_if(journals.begin(), journals.end(), [snapGen](uint32_t gen) { return gen < snapGen; }),
+                   journals.end());
+    for (size_t i = 0; i < journals.size(); ++i)
+    {
+        if (!replayJournal(journals[i], i + 1 == journals.size()))
+        {
+            return false;
+        }
+    }
+    LOG_INFO << "state journal recovered " << _state.size() << " entries from snapshot " << snapGen
+             << " and " << journals.size() << " journals";
+
+    _gen = max<uint32_t>({snapGen, journals.empty() ? 0 : journals.back(), 1});
+    _fd = ::open(journalPath(_gen).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (_fd < 0)
+    {
+        LOG_ERROR << "open state journal " << journalPath(_gen) << " failed: " << strerror(errno);
+        return false;
+    }
+    _fdGen = _gen;
+    _fdBytes = ::lseek(_fd, 0, SEEK_END);
+    ::unlink((_dir + "/snapshot.tmp").c_str());
+    syncDir(_dir);
+
+    // 已经被快照覆盖的日志和更早的快照不再需要
+    for (uint32_t gen : listGenerations(_dir, "journal-%u.lo%c", 'g'))
+    {
+        if (gen < snapGen)
+        {
+            ::unlink(journalPath(gen).c_str());
+        }
+    }
+    for (uint32_t gen : snapshots)
+    {
+        if (gen != snapGen)
+        {
+            ::unlink(snapshotPath(gen).c_str());
+        }
+    }
+    if (_journalBytes >= _snapshotBytes)
+    {
+        _snapshotWanted = true;
+    }
+
+    _flushThread = thread(&StateJournal::flushLoop, this);
+    _snapshotThread = thread(&StateJournal::snapshotLoop, this);
+    return true;
+}
+
+// 载入快照：魔数(8) + 条目数(8) + 条目(key, value) + crc32
+bool StateJournal::loadSnapshot(uint32_t gen)
+{
+    string data;
+    if (!readFile(snapshotPath(gen), data) || data.size() < SNAPSHOT_HEADER_BYTES + 4 ||
+        memcmp(data.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        return false;
+    }
+    uint64_t count;
+    memcpy(&count, data.data() + 8, sizeof(count));
+    if (data.size() != SNAPSHOT_HEADER_BYTES + count * 16 + 4)
+    {
+        return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, data.data() + data.size() - 4, sizeof(crc));
+    if (crc32(data.data() + 8, data.size() - 12) != crc)
+    {
+        return false;
+    }
+
+    _state.clear();
+    _state.reserve(count);
+    const char *p = data.data() + SNAPSHOT_HEADER_BYTES;
+    for (uint64_t i = 0; i < count; ++i, p += 16)
+    {
+        uint64_t key;
+        int64_t value;
+        memcpy(&key, p, sizeof(key));
+        memcpy(&value, p + 8, sizeof(value));
+        _state.emplace(key, value);
+    }
+    return true;
+}
+
+// 重放一代日志
+bool StateJournal::replayJournal(uint32_t gen, bool last)
+{
+    string path = journalPath(gen);
+    string data;
+    if (!readFile(path, data))
+    {
+        LOG_ERROR << "read state journal " << path << " failed: " << strerror(errno);
+        return false;
+    }
+
+    size_t offset = 0;
+    for (; offset + RECORD_BYTES <= data.size(); offset += RECORD_BYTES)
+    {
+        const char *record = data.data() + offset;
+        uint32_t crc;
+        memcpy(&crc, record, sizeof(crc));
+        if (crc32(record + 4, RECORD_BYTES - 4) != crc)
+        {
+            break;
+        }
+        uint64_t key;
+        int64_t value;
+        memcpy(&key, record + 8, sizeof(key));
+        memcpy(&value, record + 16, sizeof(value));
+        if (record[4] == RECORD_SET)
+        {
+            _state[key] = value;
+        }
+        else if (record[4] == RECORD_DEL)
+        {
+            _state.erase(key);
+        }
+    }
+    _journalBytes += offset;
+
+    if (offset != data.size())
+    {
+        if (!last)
+        {
+            // 只有最后一代日志可能因为崩溃写到一半，更早的日志损坏时停止恢复，避免丢失之后的更新
+            LOG_ERROR << "state journal " << path << " is corrupt at offset " << offset;
+            return false;
+        }
+        LOG_WARN << "truncate state journal " << path << " at offset " << offset;
+        if (::truncate(path.c_str(), offset) != 0)
+        {
+            LOG_ERROR << "truncate state journal " << path << " failed: " << strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 查询key的值
+bool StateJournal::get(uint64_t key, int64_t &value)
+{
+    lock_guard<mutex> lock(_mutex);
+    auto it = _state.find(key);
+    if (it == _state.end())
+    {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+// 状态的条目数
+size_t StateJournal::size()
+{
+    lock_guard<mutex> lock(_mutex);
+    return _state.size();
+}
+
+// 追加一条记录到缓冲区
+uint64_t StateJournal::appendLocked(RecordType type, uint64_t key, int64_t value)
+{
+    if (_pending.empty() || _pending.back().gen != _gen)
+    {
+        _pending.push_back({_gen, string()});
+    }
+    string &bytes = _pending.back().bytes;
+    size_t pos = bytes.size();
+    bytes.resize(pos + RECORD_BYTES, '\0');
+    char *record = &bytes[pos];
+    record[4] = static_cast<char>(type);
+    memcpy(record + 8, &key, sizeof(key));
+    memcpy(record + 16, &value, sizeof(value));
+    uint32_t crc = crc32(record + 4, RECORD_BYTES - 4);
+    memcpy(record, &crc, sizeof(crc));
+
+    _flushCond.notify_one();
+    return ++_appendLsn;
+}
+
+// 设置key的值
+uint64_t StateJournal::set(uint64_t key, int64_t value)
+{
+    lock_guard<mutex> lock(_mutex);
+    _state[key] = value;
+    return appendLocked(RECORD_SET, key, value);
+}
+
+// 原子地用fn(旧值)更新key的值
+int64_t StateJournal::update(uint64_t key, const function<int64_t(int64_t)> &fn, uint64_t &lsn)
+{
+    lock_guard<mutex> lock(_mutex);
+    int64_t &value = _state[key];
+    value = fn(value);
+    lsn = appendLocked(RECORD_SET, key, value);
+    return value;
+}
+
+// 删除key
+uint64_t StateJournal::erase(uint64_t key)
+{
+    lock_guard<mutex> lock(_mutex);
+    _state.erase(key);
+    return appendLocked(RECORD_DEL, key, 0);
+}
+
+// 等待编号lsn之前的记录全部落盘，lsn所在的批次写入失败时返回false
+bool StateJournal::waitDurable(uint64_t lsn)
+{
+    unique_lock<mutex> lock(_mutex);
+    _durableCond.wait(lock, [this, lsn]() { return _durableLsn >= lsn; });
+    for (auto &range : _failed)
+    {
+        if (range.first <= lsn && lsn <= range.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 放弃正在写入的日志文件，之后这一代的记录都写入失败，由快照保存内存中的状态并切换到新一代日志
+void StateJournal::abandonFile()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+// 刷盘线程，每次取走缓冲区中所有的记录，一次写入、一次fdatasync
+// 写入失败时把文件截断回这一批之前的长度，之后的记录不会接在不完整的记录后面；
+// 截断或fdatasync失败时文件的内容不再可信，放弃这个文件并请求快照
+void StateJournal::flushLoop()
+{
+    for (;;)
+    {
+        vector<Chunk> batch;
+        uint64_t first, lsn;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _flushCond.wait(lock, [this]() { return _quit || !_pending.empty(); });
+            if (_pending.empty())
+            {
+                break;
+            }
+            batch.swap(_pending);
+            first = _durableLsn + 1;
+            lsn = _appendLsn;
+        }
+
+        bool ok = true;
+        size_t bytes = 0;
+        for (Chunk &chunk : batch)
+        {
+            if (chunk.gen != _fdGen)
+            {
+                // 快照之后的记录写入新一代日志，旧日志先落盘再关闭
+                if (_fd >= 0)
+                {
+                    if (_sync && ::fdatasync(_fd) != 0)
+                    {
+                        LOG_ERROR << "fdatasync state journal " << journalPath(_fdGen) << " failed: " << strerror(errno);
+                        ok = false;
+                    }
+                    ::close(_fd);
+                }
+                _fd = ::open(journalPath(chunk.gen).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+                _fdGen = chunk.gen;
+                if (_fd < 0)
+                {
+                    LOG_ERROR << "open state journal " << journalPath(chunk.gen) << " failed: " << strerror(errno);
+                }
+                else
+                {
+                    _fdBytes = ::lseek(_fd, 0, SEEK_END);
+                }
+                syncDir(_dir);
+            }
+            if (_fd < 0)
+            {
+                ok = false;
+                continue;
+            }
+            if (!writeAll(_fd, chunk.bytes.data(), chunk.bytes.size()))
+            {
+                LOG_ERROR << "write state journal " << journalPath(chunk.gen) << " failed: " << strerror(errno);
+                ok = false;
+                if (::ftruncate(_fd, _fdBytes) != 0)
+                {
+                    LOG_ERROR << "truncate state journal " << journalPath(chunk.gen) << " failed: " << strerror(errno);
+                    abandonFile();
+                }
+                continue;
+            }
+            _fdBytes += chunk.bytes.size();
+            bytes += chunk.bytes.size();
+        }
+        if (_sync && _fd >= 0 && ::fdatasync(_fd) != 0)
+        {
+            LOG_ERROR << "fdatasync state journal failed: " << strerror(errno);
+            ok = false;
+            abandonFile();
+        }
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (!ok)
+            {
+                // 记录失败的范围供写入方查询，只保留最近的若干批，写入方在落盘进度推进后立即查询
+                _failed.push_back({first, lsn});
+                if (_failed.size() > 1024)
+                {
+                    _failed.pop_front();
+                }
+            }
+            _durableLsn = lsn;
+            _journalBytes += bytes;
+            // 放弃了日志文件时，快照把内存中的状态完整写出并切换到新一代日志
+            if ((_journalBytes >= _snapshotBytes || (_fd < 0 && _fdGen == _gen)) && !_snapshotWanted)
+            {
+                _snapshotWanted = true;
+                _snapshotCond.notify_one();
+            }
+        }
+        _durableCond.notify_all();
+    }
+}
+
+// 快照线程
+void StateJournal::snapshotLoop()
+{
+    for (;;)
+    {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _snapshotCond.wait(lock, [this]() { return _quit || _snapshotWanted; });
+            if (_quit)
+            {
+                break;
+            }
+        }
+        snapshot();
+        lock_guard<mutex> lock(_mutex);
+        _snapshotWanted = false;
+    }
+}
+
+// 写一次快照并删除旧的日志
+// 复制状态和切换日志代号在同一次加锁中完成：快照包含新一代日志之前的所有更新，恢复时从新一代日志开始重放
+bool StateJournal::snapshot()
+{
+    lock_guard<mutex> snapshotLock(_snapshotMutex);
+    vector<pair<uint64_t, int64_t>> entries;
+    uint32_t gen;
+    {
+        lock_guard<mutex> lock(_mutex);
+        entries.assign(_state.begin(), _state.end());
+        gen = ++_gen;
+        _journalBytes = 0;
+    }
+
+    string data(SNAPSHOT_HEADER_BYTES + entries.size() * 16 + 4, '\0');
+    memcpy(&data[0], SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    uint64_t count = entries.size();
+    memcpy(&data[8], &count, sizeof(count));
+    char *p = &data[SNAPSHOT_HEADER_BYTES];
+    for (auto &entry : entries)
+    {
+        memcpy(p, &entry.first, sizeof(entry.first));
+        memcpy(p + 8, &entry.second, sizeof(entry.second));
+        p += 16;
+    }
+    uint32_t crc = crc32(data.data() + 8, data.size() - 12);
+    memcpy(&data[data.size() - 4], &crc, sizeof(crc));
+
+    // 先写临时文件，落盘后再改名，崩溃时不会留下不完整的快照
+    string path = snapshotPath(gen);
+    string tmp = _dir + "/snapshot.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR << "create state snapshot " << tmp << " failed: " << strerror(errno);
+        return false;
+    }
+    bool ok = writeAll(fd, data.data(), data.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        LOG_ERROR << "write state snapshot " << path << " failed: " << strerror(errno);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    syncDir(_dir);
+
+    for (uint32_t old : listGenerations(_dir, "journal-%u.lo%c", 'g'))
+    {
+        if (old < gen)
+        {
+            ::unlink(journalPath(old).c_str());
+        }
+    }
+    for (uint32_t old : listGenerations(_dir, "snapshot-%u.sna%c", 'p'))
+    {
+        if (old < gen)
+        {
+            ::unlink(snapshotPath(old).c_str());
+        }
+    }
+    LOG_INFO << "state snapshot " << gen << " written, " << entries.size() << " entries";
+    return true;
+}
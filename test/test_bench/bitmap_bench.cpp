@@ -0,0 +1,90 @@
+/*
+群组在线成员筛选性能测试
+- 对比原来的做法：持有锁逐个成员在在线用户表中查找
+- 和UserBitmap：群组成员位图和在线用户位图求交集
+用法：./bitmap_bench [群成员数=100000] [在线用户数=200000] [用户总数=1000000] [轮数=100]
+*/
+#include "userbitmap.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+using namespace std;
+using namespace std::chrono;
+
+static double usSince(steady_clock::time_point start)
+{
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    int members = argc > 1 ? atoi(argv[1]) : 100000;
+    int online = argc > 2 ? atoi(argv[2]) : 200000;
+    int total = argc > 3 ? atoi(argv[3]) : 1000000;
+    int rounds = argc > 4 ? atoi(argv[4]) : 100;
+
+    // userid是自增主键，在[1, total]中随机选出在线用户和群成员
+    mt19937 rng(2024);
+    vector<int> all(total);
+    for (int i = 0; i < total; ++i)
+    {
+        all[i] = i + 1;
+    }
+
+    shuffle(all.begin(), all.end(), rng);
+    unordered_map<int, int> onlineMap;
+    UserBitmap onlineBitmap;
+    for (int i = 0; i < online; ++i)
+    {
+        onlineMap[all[i]] = i;
+        onlineBitmap.add(all[i]);
+    }
+
+    shuffle(all.begin(), all.end(), rng);
+    vector<int> memberVec(all.begin(), all.begin() + members);
+    UserBitmap memberBitmap;
+    for (int id : memberVec)
+    {
+        memberBitmap.add(id);
+    }
+
+    // 原来的做法：持有锁逐个成员查表
+    mutex mtx;
+    size_t expected = 0;
+    auto start = steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        vector<int> result;
+        lock_guard<mutex> lock(mtx);
+        for (int id : memberVec)
+        {
+            if (onlineMap.find(id) != onlineMap.end())
+            {
+                result.push_back(id);
+            }
+        }
+        expected = result.size();
+    }
+    double lookup = usSince(start) / rounds;
+
+    // 位图交集
+    size_t got = 0;
+    start = steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        vector<int> result;
+        lock_guard<mutex> lock(mtx);
+        UserBitmap::intersect(memberBitmap, onlineBitmap).toVector(result);
+        got = result.size();
+    }
+    double bitmap = usSince(start) / rounds;
+
+    cout << "members: " << members << ", online: " << online << ", users: " << total
+         << ", online members: " << got << (got == expected ? "" : " (MISMATCH)") << endl;
+    cout << "hash lookup per member : " << lookup << " us/group" << endl;
+    cout << "bitmap intersection    : " << bitmap << " us/group" << endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+消息字典压缩性能测试
+- 按服务器实际存储的格式生成一对一和群聊消息（json.dump()输出，键按字母序），一部分用来训练字典
+- 统计其余消息的压缩率和编码、解码吞吐，并校验解码结果与原文一致
+用法：./codec_bench [训练样本数=2000] [测试消息数=200000]
+*/
+#include "dictcodec.hpp"
+#include "json.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+static double msSince(steady_clock::time_point start)
+{
+    return duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+static const char *TEXTS[] = {"好的", "收到", "明天上午十点开会", "ok", "hello, are you there?", "晚上一起吃饭吗",
+                              "deploy finished, please check", "这个bug我来看一下", "哈哈哈", "周末有空吗？",
+                              "已经合并到主干了", "thanks!", "文档链接发群里了", "稍等，我在路上"};
+
+int main(int argc, char **argv)
+{
+    int trainCount = argc > 1 ? atoi(argv[1]) : 2000;
+    int testCount = argc > 2 ? atoi(argv[2]) : 200000;
+
+    mt19937 rng(2024);
+    const int textCount = sizeof(TEXTS) / sizeof(TEXTS[0]);
+    long long mid = 904520112537600000LL;
+    auto makeMessage = [&]() {
+        json js;
+        int from = rng() % 100000 + 1;
+        js["id"] = from;
+        js["name"] = "user" + to_string(from);
+        js["msg"] = TEXTS[rng() % textCount];
+        char time[32];
+        snprintf(time, sizeof(time), "2026-10-19 %02d:%02d:%02d", (int)(rng() % 24), (int)(rng() % 60), (int)(rng() % 60));
+        js["time"] = time;
+        js["mid"] = mid += rng() % 100000;
+        if (rng() % 2 == 0)
+        {
+            js["msgid"] = 5;        // ONE_CHAT_MSG
+            js["toid"] = rng() % 100000 + 1;
+        }
+        else
+        {
+            js["msgid"] = 8;        // GROUP_CHAT_MSG
+            js["groupid"] = rng() % 5000 + 1;
+            js["seq"] = rng() % 1000000;
+        }
+        return js.dump();
+    };
+
+    vector<string> samples(trainCount), messages(testCount);
+    for (string &s : samples)
+    {
+        s = makeMessage();
+    }
+    for (string &s : messages)
+    {
+        s = makeMessage();
+    }
+
+    auto start = steady_clock::now();
+    DictCodec codec(DictCodec::train(samples));
+    double trainMs = msSince(start);
+    cout << "train: " << trainCount << " samples, " << codec.entries().size() << " entries, "
+         << codec.serialize().size() << " bytes, " << trainMs << " ms" << endl;
+
+    size_t rawBytes = 0, encodedBytes = 0;
+    vector<string> encoded(testCount);
+    start = steady_clock::now();
+    for (int i = 0; i < testCount; ++i)
+    {
+        codec.encode(messages[i], encoded[i]);
+        rawBytes += messages[i].size();
+        encodedBytes += encoded[i].size();
+    }
+    double encodeMs = msSince(start);
+
+    size_t mismatch = 0;
+    string decoded;
+    start = steady_clock::now();
+    for (int i = 0; i < testCount; ++i)
+    {
+        decoded.clear();
+        if (!codec.decode(encoded[i].data(), encoded[i].size(), decoded) || decoded != messages[i])
+        {
+            ++mismatch;
+        }
+    }
+    double decodeMs = msSince(start);
+
+    cout << "messages: " << testCount << ", raw " << rawBytes / testCount << " bytes/msg, encoded "
+         << encodedBytes / testCount << " bytes/msg, ratio " << (double)rawBytes / encodedBytes
+         << (mismatch == 0 ? "" : ", MISMATCH " + to_string(mismatch)) << endl;
+    cout << "encode: " << rawBytes / 1024.0 / 1024 / (encodeMs / 1000) << " MB/s" << endl;
+    cout << "decode: " << rawBytes / 1024.0 / 1024 / (decodeMs / 1000) << " MB/s" << endl;
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+入站消息解析性能测试
+- 用实际的消息形状（一对一聊天、群聊、批量送达确认、登录）比较JsonTape和nlohmann::json
+- 每次解析后读取处理器需要的字段，和服务器处理一条消息时的工作量相同
+- 两种解析读出的字段必须一致
+- 登录请求另外测量按消息结构一遍解码（proto::decode）的耗时
+- 响应生成比较JsonWriter和nlohmann::json，两种方式生成的响应解析后必须相同
+用法：./json_bench [每种消息的解析次数=1000000]
+*/
+#include "jsontape.hpp"
+#include "messages.hpp"
+#include "jsonwriter.hpp"
+#include "json.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+struct Sample
+{
+    const char *name;
+    string text;
+};
+
+static vector<Sample> samples()
+{
+    vector<Sample> result;
+    // 客户端发送的消息以'\0'结尾
+    result.push_back({"one chat",
+                      string("{\"msgid\":6,\"id\":10001,\"name\":\"zhang san\",\"to\":10002,"
+                             "\"msg\":\"今天下午三点开会，记得带上周的报表 \\\"Q3\\\"\",\"time\":\"2024-05-01 15:00:00\"}") + '\0'});
+    result.push_back({"group chat",
+                      string("{\"msgid\":10,\"id\":10001,\"name\":\"zhang san\",\"groupid\":2001,"
+                             "\"msg\":\"hello everyone, the release is tagged\",\"time\":\"2024-05-01 15:00:00\"}") + '\0'});
+    string ack = "{\"msgid\":21,\"mids\":[";
+    for (int i = 0; i < 32; ++i)
+    {
+        ack += (i ? "," : "") + to_string(7190000000000000000LL + i * 4099);
+    }
+    result.push_back({"ack x32", ack + "]}" + '\0'});
+    result.push_back({"login", string("{\"msgid\":1,\"id\":10001,\"password\":\"123456\",\"ack\":true}") + '\0'});
+    return result;
+}
+
+// 读取处理器需要的字段，返回校验和
+static int64_t readTape(JsonTape &tape, const string &text)
+{
+    if (!tape.parse(text))
+    {
+        return -1;
+    }
+    JsonTape::Value root = tape.root();
+    int64_t sum = root["msgid"].asInt() + root["id"].asInt() + root["to"].asInt() + root["groupid"].asInt();
+    sum += root["msg"].asString().size() + root["password"].asString().size();
+    for (JsonTape::Value mid = root["mids"].first(); mid.valid(); mid = mid.next())
+    {
+        sum += mid.asInt();
+    }
+    return sum;
+}
+
+static int64_t readJson(const string &text)
+{
+    json js = json::parse(text);
+    int64_t sum = js["msgid"].get<int64_t>() + js.value("id", 0) + js.value("to", 0) + js.value("groupid", 0);
+    sum += js.value("msg", string()).size() + js.value("password", string()).size();
+    if (js.contains("mids"))
+    {
+        for (auto &mid : js["mids"])
+        {
+            sum += mid.get<int64_t>();
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    JsonTape tape;
+    int bad = 0;
+    for (const Sample &sample : samples())
+    {
+        if (readTape(tape, sample.text) != readJson(sample.text))
+        {
+            cerr << sample.name << ": fields mismatch" << endl;
+            ++bad;
+            continue;
+        }
+
+        int64_t sink = 0;
+        auto start = steady_clock::now();
+        for (long i = 0; i < iterations; ++i)
+        {
+            sink += readTape(tape, sample.text);
+        }
+        double tapeNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)iterations;
+
+        start = steady_clock::now();
+        for (long i = 0; i < iterations; ++i)
+        {
+            sink -= readJson(sample.text);
+        }
+        double jsonNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)iterations;
+
+        cout << sample.name << " (" << sample.text.size() << " bytes): tape " << tapeNs << " ns, nlohmann "
+             << jsonNs << " ns, speedup " << jsonNs / tapeNs << "x" << (sink == 0 ? "" : " (checksum error)") << endl;
+        bad += sink != 0;
+    }
+
+    // 按消息结构解码登录请求
+    string login = proto::encode(proto::LoginReq{10001, "123456", true, true});
+    proto::LoginReq req;
+    if (!tape.parse(login) || !proto::decode(tape.root(), req) || req.id != 10001 || req.password != "123456")
+    {
+        cerr << "login: typed decode mismatch" << endl;
+        return 1;
+    }
+    auto start = steady_clock::now();
+    for (long i = 0; i < iterations; ++i)
+    {
+        proto::LoginReq req;
+        tape.parse(login);
+        proto::decode(tape.root(), req);
+    }
+    double typedNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)iterations;
+    cout << "login typed decode: " << typedNs << " ns" << endl;
+
+    // 生成群消息同步响应：20条消息
+    vector<string> msgs;
+    for (int i = 0; i < 20; ++i)
+    {
+        msgs.push_back("{\"msgid\":10,\"mid\":" + to_string(7190000000000000000LL + i) +
+                       ",\"id\":10001,\"groupid\":2001,\"msg\":\"hello \\\"everyone\\\"\"}");
+    }
+    auto writeJson = [&]() {
+        json response;
+        response["msgid"] = 17;
+        response["groupid"] = 2001;
+        response["errno"] = 0;
+        response["seq"] = 123456LL;
+        response["more"] = false;
+        response["msgs"] = msgs;
+        return response.dump();
+    };
+    static constexpr JsonKey KEY_MSGID("msgid");
+    static constexpr JsonKey KEY_GROUPID("groupid");
+    static constexpr JsonKey KEY_ERRNO("errno");
+    static constexpr JsonKey KEY_SEQ("seq");
+    static constexpr JsonKey KEY_MORE("more");
+    static constexpr JsonKey KEY_MSGS("msgs");
+    auto writeStream = [&]() -> const string & {
+        string &out = JsonWriter::buffer();
+        JsonWriter(out).beginObject()
+            .field(KEY_MSGID, 17)
+            .field(KEY_GROUPID, 2001)
+            .field(KEY_ERRNO, 0)
+            .field(KEY_SEQ, 123456LL)
+            .field(KEY_MORE, false)
+            .field(KEY_MSGS, msgs)
+            .endObject();
+        return out;
+    };
+    if (json::parse(writeStream()) != json::parse(writeJson()))
+    {
+        cerr << "sync response: writer mismatch" << endl;
+        return 1;
+    }
+    size_t sink = 0;
+    start = steady_clock::now();
+    for (long i = 0; i < iterations; ++i)
+    {
+        sink += writeStream().size();
+    }
+    double writerNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)iterations;
+    start = steady_clock::now();
+    for (long i = 0; i < iterations; ++i)
+    {
+        sink -= writeJson().size();
+    }
+    double dumpNs = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)iterations;
+    cout << "sync response (" << writeStream().size() << " bytes): writer " << writerNs << " ns, nlohmann "
+         << dumpNs << " ns, speedup " << dumpNs / writerNs << "x" << (sink == 0 ? "" : " (size error)") << endl;
+    return bad == 0 && sink == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+/*
+内嵌离线消息日志存储性能测试
+- 多个写入线程同时写入离线消息，组提交让一次fdatasync确认一批写入
+- 写入完成后逐个用户读取并删除离线消息（登录时的读取路径）
+用法：./offline_bench [日志目录=offline_bench_log] [写入线程数=8] [每线程消息数=10000] [用户数=10000]
+*/
+#include "logstore.hpp"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+using namespace std;
+using namespace std::chrono;
+
+static double msSince(steady_clock::time_point start)
+{
+    return duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    string dir = argc > 1 ? argv[1] : "offline_bench_log";
+    int threads = argc > 2 ? atoi(argv[2]) : 8;
+    int perThread = argc > 3 ? atoi(argv[3]) : 10000;
+    int users = argc > 4 ? atoi(argv[4]) : 10000;
+
+    system(("rm -rf " + dir).c_str());
+    LogStore store(dir, 64 << 20);
+    if (!store.open())
+    {
+        cerr << "open " << dir << " failed" << endl;
+        return 1;
+    }
+    string msg = string(R"({"msgid":6,"id":1,"name":"zhang san","to":2,"msg":")") + string(100, 'x') + "\"}";
+
+    auto start = steady_clock::now();
+    vector<thread> writers;
+    for (int t = 0; t < threads; ++t)
+    {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < perThread; ++i)
+            {
+                store.insert((t * perThread + i) % users + 1, msg);
+            }
+        });
+    }
+    for (thread &writer : writers)
+    {
+        writer.join();
+    }
+    double writeMs = msSince(start);
+    long total = (long)threads * perThread;
+
+    start = steady_clock::now();
+    long read = 0;
+    for (int id = 1; id <= users; ++id)
+    {
+        read += store.query(id).size();
+        store.remove(id);
+    }
+    double drainMs = msSince(start);
+
+    cout << "writers: " << threads << ", messages: " << total << ", users: " << users << endl;
+    cout << "durable insert : " << total / writeMs * 1000 << " msg/s (" << writeMs << " ms)" << endl;
+    cout << "query + remove : " << users / drainMs * 1000 << " users/s, " << read << " messages (" << drainMs << " ms)" << endl;
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+历史消息全文搜索性能测试
+- 建索引：逐条加入随机生成的中英文混合消息，统计吞吐和倒排表大小
+- 查询：单词、中文词和多词查询，只允许用户参与的会话，统计延迟分布
+用法：./search_bench [消息数=1000000] [会话数=10000] [用户参与的会话数=200] [查询次数=2000]
+*/
+#include "invertedindex.hpp"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
+using namespace std;
+using namespace std::chrono;
+
+static double usSince(steady_clock::time_point start)
+{
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+// 常用汉字和英文单词，按齐夫分布抽取
+static const char *HANZI[] = {"的", "我", "你", "是", "了", "不", "在", "有", "人", "这", "他", "们", "来", "到", "时",
+                              "大", "地", "为", "子", "中", "上", "说", "生", "国", "年", "着", "就", "那", "和", "要",
+                              "她", "出", "也", "得", "里", "后", "自", "以", "会", "家", "可", "下", "而", "过", "天",
+                              "去", "能", "对", "小", "多", "然", "于", "心", "学", "么", "之", "都", "好", "看", "起",
+                              "发", "当", "没", "成", "只", "如", "事", "把", "还", "用", "第", "样", "道", "想", "作",
+                              "种", "开", "美", "总", "从", "无", "情", "己", "面", "最", "女", "但", "现", "前", "些",
+                              "所", "同", "日", "手", "又", "行", "意", "动", "方", "期", "它", "头", "经", "长", "儿",
+                              "回", "位", "分", "爱", "老", "因", "很", "给", "名", "法", "间", "斯", "知", "世", "什"};
+static const char *WORDS[] = {"ok", "hello", "meeting", "today", "tomorrow", "release", "build", "server", "bug",
+                              "deploy", "lunch", "review", "merge", "test", "cache", "redis", "mysql", "latency",
+                              "thanks", "please", "link", "doc", "design", "plan", "weekend", "coffee", "call", "ticket"};
+
+int main(int argc, char **argv)
+{
+    int messages = argc > 1 ? atoi(argv[1]) : 1000000;
+    int convs = argc > 2 ? atoi(argv[2]) : 10000;
+    int userConvs = argc > 3 ? atoi(argv[3]) : 200;
+    int queries = argc > 4 ? atoi(argv[4]) : 2000;
+
+    mt19937 rng(2024);
+    const int hanziCount = sizeof(HANZI) / sizeof(HANZI[0]);
+    const int wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+    vector<double> weights(hanziCount);
+    for (int i = 0; i < hanziCount; ++i)
+    {
+        weights[i] = 1.0 / (i + 1);
+    }
+    discrete_distribution<int> hanzi(weights.begin(), weights.end());
+    uniform_int_distribution<int> word(0, wordCount - 1);
+    uniform_int_distribution<int> length(4, 30);
+    uniform_int_distribution<int> conv(1, convs);
+
+    auto makeText = [&]() {
+        string text;
+        int n = length(rng);
+        for (int i = 0; i < n; ++i)
+        {
+            if (rng() % 8 == 0)
+            {
+                text += " ";
+                text += WORDS[word(rng)];
+                text += " ";
+            }
+            else
+            {
+                text += HANZI[hanzi(rng)];
+            }
+        }
+        return text;
+    };
+
+    // 建索引，消息id递增
+    InvertedIndex index;
+    vector<string> texts(messages);
+    vector<int64_t> convids(messages);
+    for (int i = 0; i < messages; ++i)
+    {
+        texts[i] = makeText();
+        convids[i] = conv(rng);
+    }
+    size_t textBytes = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < messages; ++i)
+    {
+        index.add(i + 1, convids[i], texts[i]);
+        textBytes += texts[i].size();
+    }
+    double build = usSince(start);
+
+    cout << "messages: " << index.docCount() << ", text: " << textBytes / 1024 / 1024 << " MB"
+         << ", postings: " << index.postingBytes() / 1024 / 1024 << " MB ("
+         << (double)index.postingBytes() / index.docCount() << " bytes/msg)" << endl;
+    cout << "build: " << build / 1000 << " ms, " << messages / (build / 1e6) << " msgs/s" << endl;
+
+    // 用户参与的会话
+    unordered_set<int64_t> allowed;
+    while ((int)allowed.size() < min(userConvs, convs))
+    {
+        allowed.insert(conv(rng));
+    }
+    auto allow = [&](int64_t convid) { return allowed.count(convid) != 0; };
+
+    // 从生成的消息中截取查询词，保证有结果
+    struct Case
+    {
+        const char *name;
+        function<string()> make;
+    };
+    vector<Case> cases = {
+        {"english word", [&]() { return string(WORDS[word(rng)]); }},
+        {"chinese bigram", [&]() { return string(HANZI[hanzi(rng)]) + HANZI[hanzi(rng)]; }},
+        {"rare bigram", [&]() { return string(HANZI[hanziCount - 1 - rng() % 20]) + HANZI[hanziCount - 1 - rng() % 20]; }},
+        {"word + bigram", [&]() { return string(WORDS[word(rng)]) + " " + HANZI[hanzi(rng)] + HANZI[hanzi(rng)]; }},
+    };
+    for (Case &c : cases)
+    {
+        vector<double> latency;
+        size_t found = 0;
+        for (int q = 0; q < queries; ++q)
+        {
+            string query = c.make();
+            start = steady_clock::now();
+            found += index.search(query, allow, 20).size();
+            latency.push_back(usSince(start));
+        }
+        sort(latency.begin(), latency.end());
+        cout << c.name << ": avg hits " << (double)found / queries << ", p50 " << latency[queries / 2]
+             << " us, p99 " << latency[queries * 99 / 100] << " us" << endl;
+    }
+    return 0;
+}
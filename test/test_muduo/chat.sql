@@ -99,8 +99,12 @@ DROP TABLE IF EXISTS `offlinemessage`;
 /*!40101 SET character_set_client = utf8 */;
 CREATE TABLE `offlinemessage` (
   `userid` int(11) NOT NULL,
-  `message` varchar(500) NOT NULL
-) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+  `message` blob NOT NULL,
+  `time` bigint(20) NOT NULL,
+  KEY `userid` (`userid`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1
+/*!50100 PARTITION BY RANGE (`time`)
+(PARTITION pmax VALUES LESS THAN MAXVALUE ENGINE = InnoDB) */;
 /*!40101 SET character_set_client = @saved_cs_client */;
 
 --
@@ -109,7 +113,7 @@ CREATE TABLE `offlinemessage` (
 
 LOCK TABLES `offlinemessage` WRITE;
 /*!40000 ALTER TABLE `offlinemessage` DISABLE KEYS */;
-INSERT INTO `offlinemessage` VALUES (19,'{\"groupid\":1,\"id\":21,\"msg\":\"hello\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-22 00:43:59\"}'),(19,'{\"groupid\":1,\"id\":21,\"msg\":\"helo!!!\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-22 22:43:21\"}'),(19,'{\"groupid\":1,\"id\":13,\"msg\":\"hahahahaha\",\"msgid\":10,\"name\":\"zhang san\",\"time\":\"2020-02-22 22:59:56\"}'),(19,'{\"groupid\":1,\"id\":13,\"msg\":\"hahahahaha\",\"msgid\":10,\"name\":\"zhang san\",\"time\":\"2020-02-23 17:59:26\"}'),(19,'{\"groupid\":1,\"id\":21,\"msg\":\"wowowowowow\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-23 17:59:34\"}');
+INSERT INTO `offlinemessage` VALUES (19,'{\"groupid\":1,\"id\":21,\"msg\":\"hello\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-22 00:43:59\"}',1582332239000),(19,'{\"groupid\":1,\"id\":21,\"msg\":\"helo!!!\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-22 22:43:21\"}',1582411401000),(19,'{\"groupid\":1,\"id\":13,\"msg\":\"hahahahaha\",\"msgid\":10,\"name\":\"zhang san\",\"time\":\"2020-02-22 22:59:56\"}',1582412396000),(19,'{\"groupid\":1,\"id\":13,\"msg\":\"hahahahaha\",\"msgid\":10,\"name\":\"zhang san\",\"time\":\"2020-02-23 17:59:26\"}',1582480766000),(19,'{\"groupid\":1,\"id\":21,\"msg\":\"wowowowowow\",\"msgid\":10,\"name\":\"gao yang\",\"time\":\"2020-02-23 17:59:34\"}',1582480774000);
 /*!40000 ALTER TABLE `offlinemessage` ENABLE KEYS */;
 UNLOCK TABLES;
 
@@ -139,6 +143,123 @@ LOCK TABLES `user` WRITE;
 INSERT INTO `user` VALUES (13,'zhang san','123456','online'),(15,'li si','666666','offline'),(16,'liu shuo','123456','offline'),(18,'wu yang','123456','offline'),(19,'pi pi','123456','offline'),(21,'gao yang','123456','offline');
 /*!40000 ALTER TABLE `user` ENABLE KEYS */;
 UNLOCK TABLES;
+--
+-- Table structure for table `groupseq`
+--
+
+DROP TABLE IF EXISTS `groupseq`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `groupseq` (
+  `groupid` int(11) NOT NULL,
+  `seq` bigint(20) NOT NULL,
+  PRIMARY KEY (`groupid`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `grouptimeline`
+--
+
+DROP TABLE IF EXISTS `grouptimeline`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `grouptimeline` (
+  `groupid` int(11) NOT NULL,
+  `seq` bigint(20) NOT NULL,
+  `message` text NOT NULL,
+  PRIMARY KEY (`groupid`,`seq`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `groupcursor`
+--
+
+DROP TABLE IF EXISTS `groupcursor`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `groupcursor` (
+  `groupid` int(11) NOT NULL,
+  `userid` int(11) NOT NULL,
+  `seq` bigint(20) NOT NULL DEFAULT '0',
+  PRIMARY KEY (`groupid`,`userid`),
+  KEY `userid` (`userid`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `history`
+--
+
+DROP TABLE IF EXISTS `history`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `history` (
+  `id` bigint(20) NOT NULL,
+  `convid` bigint(20) NOT NULL,
+  `fromid` int(11) NOT NULL,
+  `message` blob NOT NULL,
+  PRIMARY KEY (`convid`,`id`),
+  KEY `id` (`id`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1
+/*!50100 PARTITION BY RANGE (`id`)
+(PARTITION p202609 VALUES LESS THAN (893286088704000000) ENGINE = InnoDB,
+ PARTITION p202610 VALUES LESS THAN (904520112537600000) ENGINE = InnoDB,
+ PARTITION p202611 VALUES LESS THAN (915391748505600000) ENGINE = InnoDB,
+ PARTITION p202612 VALUES LESS THAN (926625772339200000) ENGINE = InnoDB,
+ PARTITION p202701 VALUES LESS THAN (937859796172800000) ENGINE = InnoDB,
+ PARTITION p202702 VALUES LESS THAN (948006656409600000) ENGINE = InnoDB,
+ PARTITION pmax VALUES LESS THAN MAXVALUE ENGINE = InnoDB) */;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `payloaddict`
+--
+
+DROP TABLE IF EXISTS `payloaddict`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `payloaddict` (
+  `version` int(11) NOT NULL,
+  `dict` blob NOT NULL,
+  PRIMARY KEY (`version`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `offlinepayload`
+--
+
+DROP TABLE IF EXISTS `offlinepayload`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `offlinepayload` (
+  `hash` char(32) NOT NULL,
+  `refcount` int(11) NOT NULL,
+  `message` blob NOT NULL,
+  PRIMARY KEY (`hash`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
+--
+-- Table structure for table `conversation`
+--
+
+DROP TABLE IF EXISTS `conversation`;
+/*!40101 SET @saved_cs_client     = @@character_set_client */;
+/*!40101 SET character_set_client = utf8 */;
+CREATE TABLE `conversation` (
+  `userid` int(11) NOT NULL,
+  `convid` bigint(20) NOT NULL,
+  `unread` int(11) NOT NULL DEFAULT '0',
+  `lastmid` bigint(20) NOT NULL DEFAULT '0',
+  `readseq` bigint(20) NOT NULL DEFAULT '0',
+  PRIMARY KEY (`userid`,`convid`),
+  KEY `recent` (`userid`,`lastmid`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+/*!40101 SET character_set_client = @saved_cs_client */;
+
 /*!40103 SET TIME_ZONE=@OLD_TIME_ZONE */;
 
 /*!40101 SET SQL_MODE=@OLD_SQL_MODE */;